@@ -32,7 +32,7 @@
  *  Resolve o sistema Ax = b por substituição para frente.
  *  @return O vetor x.
  */
-static matrix_t *forwards_substitution(const matrix_t * restrict A, const matrix_t * restrict b)
+static matrix_t *forwards_substitution(const matrix_t * ALC_RESTRICT A, const matrix_t * ALC_RESTRICT b)
 {
     size_t i;
     matrix_t *x = matrix_new(b->rows, 1);
@@ -55,7 +55,7 @@ static matrix_t *forwards_substitution(const matrix_t * restrict A, const matrix
  *  Resolve o sistema Ax = b por substituição para trás
  *  @return O vetor x.
  */
-static matrix_t *backwards_substitution(const matrix_t * restrict A, const matrix_t * restrict b)
+static matrix_t *backwards_substitution(const matrix_t * ALC_RESTRICT A, const matrix_t * ALC_RESTRICT b)
 {
     size_t i;
     matrix_t *x = matrix_new(b->rows, 1);
@@ -0,0 +1,488 @@
+/**
+ *  @file
+ */
+/*
+ * Copyright (c) 2018 Victor Hermann "vitorhnn" Chiletto
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+**/
+
+#ifndef BATCHED_H
+#define BATCHED_H
+
+/*
+ * Batched kernels for many small matrices of the same order n.
+ *
+ * The batch is stored interleaved: element (i, j) of matrix b lives at
+ * a[(i * n + j) * count + b], and component i of vector b at x[i * count + b].
+ * Every kernel loops over the batch in its innermost loop, so the same
+ * operation is applied to consecutive matrices with unit stride and the
+ * compiler can vectorize across the batch. Nothing is allocated, except the
+ * pivot history of batch_inverse for orders above 16.
+ *
+ * Kernels that can fail report it per matrix through info: 0 on success,
+ * k + 1 when the k-th pivot was zero (or not positive, for Cholesky), and -1
+ * when batch_inverse could not allocate its pivot history.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/**
+ *  Quantidade de matrizes processadas juntas nas etapas que precisam de estado por matriz.
+ */
+#ifndef BATCH_CHUNK
+#define BATCH_CHUNK 64
+#endif
+
+/** Elemento (i, j) da matriz b de um lote de count matrizes de ordem n. **/
+#define BATCH_AT(a, n, count, i, j, b) ((a)[((i) * (n) + (j)) * (count) + (b)])
+
+/**
+ *  Inverte um lote de matrizes 2x2 pela fórmula fechada.
+ */
+static void batch_inverse2(size_t count, const double * ALC_RESTRICT a, double * ALC_RESTRICT inv, int * ALC_RESTRICT info)
+{
+    const double *a00 = a, *a01 = a + count, *a10 = a + 2 * count, *a11 = a + 3 * count;
+    double *i00 = inv, *i01 = inv + count, *i10 = inv + 2 * count, *i11 = inv + 3 * count;
+    size_t b;
+
+    for (b = 0; b < count; ++b) {
+        double det = a00[b] * a11[b] - a01[b] * a10[b];
+        double r = det != 0 ? 1 / det : 0;
+
+        info[b] = det != 0 ? 0 : 2;
+
+        i00[b] = a11[b] * r;
+        i01[b] = -a01[b] * r;
+        i10[b] = -a10[b] * r;
+        i11[b] = a00[b] * r;
+    }
+}
+
+/**
+ *  Inverte um lote de matrizes 3x3 pela adjunta.
+ */
+static void batch_inverse3(size_t count, const double * ALC_RESTRICT a, double * ALC_RESTRICT inv, int * ALC_RESTRICT info)
+{
+    size_t b;
+
+    for (b = 0; b < count; ++b) {
+        double m00 = a[0 * count + b], m01 = a[1 * count + b], m02 = a[2 * count + b];
+        double m10 = a[3 * count + b], m11 = a[4 * count + b], m12 = a[5 * count + b];
+        double m20 = a[6 * count + b], m21 = a[7 * count + b], m22 = a[8 * count + b];
+
+        double c00 = m11 * m22 - m12 * m21;
+        double c01 = m12 * m20 - m10 * m22;
+        double c02 = m10 * m21 - m11 * m20;
+
+        double det = m00 * c00 + m01 * c01 + m02 * c02;
+        double r = det != 0 ? 1 / det : 0;
+
+        info[b] = det != 0 ? 0 : 3;
+
+        inv[0 * count + b] = c00 * r;
+        inv[1 * count + b] = (m02 * m21 - m01 * m22) * r;
+        inv[2 * count + b] = (m01 * m12 - m02 * m11) * r;
+        inv[3 * count + b] = c01 * r;
+        inv[4 * count + b] = (m00 * m22 - m02 * m20) * r;
+        inv[5 * count + b] = (m02 * m10 - m00 * m12) * r;
+        inv[6 * count + b] = c02 * r;
+        inv[7 * count + b] = (m01 * m20 - m00 * m21) * r;
+        inv[8 * count + b] = (m00 * m11 - m01 * m10) * r;
+    }
+}
+
+/**
+ *  Inverte um lote de matrizes 4x4 pela adjunta, com os cofatores montados a partir dos menores 2x2.
+ */
+static void batch_inverse4(size_t count, const double * ALC_RESTRICT a, double * ALC_RESTRICT inv, int * ALC_RESTRICT info)
+{
+    size_t b;
+
+    for (b = 0; b < count; ++b) {
+        double m00 = a[0 * count + b], m01 = a[1 * count + b], m02 = a[2 * count + b], m03 = a[3 * count + b];
+        double m10 = a[4 * count + b], m11 = a[5 * count + b], m12 = a[6 * count + b], m13 = a[7 * count + b];
+        double m20 = a[8 * count + b], m21 = a[9 * count + b], m22 = a[10 * count + b], m23 = a[11 * count + b];
+        double m30 = a[12 * count + b], m31 = a[13 * count + b], m32 = a[14 * count + b], m33 = a[15 * count + b];
+
+        /* 2x2 minors of the top two rows and of the bottom two rows */
+        double s0 = m00 * m11 - m10 * m01;
+        double s1 = m00 * m12 - m10 * m02;
+        double s2 = m00 * m13 - m10 * m03;
+        double s3 = m01 * m12 - m11 * m02;
+        double s4 = m01 * m13 - m11 * m03;
+        double s5 = m02 * m13 - m12 * m03;
+
+        double c0 = m20 * m31 - m30 * m21;
+        double c1 = m20 * m32 - m30 * m22;
+        double c2 = m20 * m33 - m30 * m23;
+        double c3 = m21 * m32 - m31 * m22;
+        double c4 = m21 * m33 - m31 * m23;
+        double c5 = m22 * m33 - m32 * m23;
+
+        double det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+        double r = det != 0 ? 1 / det : 0;
+
+        info[b] = det != 0 ? 0 : 4;
+
+        inv[0 * count + b] = (m11 * c5 - m12 * c4 + m13 * c3) * r;
+        inv[1 * count + b] = (m02 * c4 - m01 * c5 - m03 * c3) * r;
+        inv[2 * count + b] = (m31 * s5 - m32 * s4 + m33 * s3) * r;
+        inv[3 * count + b] = (m22 * s4 - m21 * s5 - m23 * s3) * r;
+
+        inv[4 * count + b] = (m12 * c2 - m10 * c5 - m13 * c1) * r;
+        inv[5 * count + b] = (m00 * c5 - m02 * c2 + m03 * c1) * r;
+        inv[6 * count + b] = (m32 * s2 - m30 * s5 - m33 * s1) * r;
+        inv[7 * count + b] = (m20 * s5 - m22 * s2 + m23 * s1) * r;
+
+        inv[8 * count + b] = (m10 * c4 - m11 * c2 + m13 * c0) * r;
+        inv[9 * count + b] = (m01 * c2 - m00 * c4 - m03 * c0) * r;
+        inv[10 * count + b] = (m30 * s4 - m31 * s2 + m33 * s0) * r;
+        inv[11 * count + b] = (m21 * s2 - m20 * s4 - m23 * s0) * r;
+
+        inv[12 * count + b] = (m11 * c1 - m10 * c3 - m12 * c0) * r;
+        inv[13 * count + b] = (m00 * c3 - m01 * c1 + m02 * c0) * r;
+        inv[14 * count + b] = (m31 * s1 - m30 * s3 - m32 * s0) * r;
+        inv[15 * count + b] = (m20 * s3 - m21 * s1 + m22 * s0) * r;
+    }
+}
+
+/**
+ *  Procura, para cada matriz do bloco [first, last), o pivô parcial da coluna k e troca as linhas.
+ *  @param lanes Recebe a linha escolhida para cada matriz do bloco.
+ */
+static void batch_pivot(size_t n, size_t count, double * ALC_RESTRICT a, size_t k, size_t first, size_t last,
+                        size_t * ALC_RESTRICT lanes, int * ALC_RESTRICT info)
+{
+    double best[BATCH_CHUNK];
+    size_t i, j, b;
+
+    for (b = first; b < last; ++b) {
+        best[b - first] = fabs(BATCH_AT(a, n, count, k, k, b));
+        lanes[b - first] = k;
+    }
+
+    for (i = k + 1; i < n; ++i) {
+        for (b = first; b < last; ++b) {
+            double v = fabs(BATCH_AT(a, n, count, i, k, b));
+            if (v > best[b - first]) {
+                best[b - first] = v;
+                lanes[b - first] = i;
+            }
+        }
+    }
+
+    for (b = first; b < last; ++b) {
+        if (best[b - first] == 0 && info[b] == 0) {
+            info[b] = (int) k + 1;
+        }
+    }
+
+    for (j = 0; j < n; ++j) {
+        for (b = first; b < last; ++b) {
+            size_t p = lanes[b - first];
+            double swap = BATCH_AT(a, n, count, k, j, b);
+            BATCH_AT(a, n, count, k, j, b) = BATCH_AT(a, n, count, p, j, b);
+            BATCH_AT(a, n, count, p, j, b) = swap;
+        }
+    }
+}
+
+/**
+ *  Calcula, no próprio lugar, a fatoração PA = LU com pivoteamento parcial de um lote de matrizes. <br>
+ *  Cada matriz fica compactada como em lu_factor; pivots recebe n * count índices, no mesmo
+ *  entrelaçamento dos vetores.
+ */
+static void batch_lu_factor(size_t n, size_t count, double * ALC_RESTRICT a, size_t * ALC_RESTRICT pivots,
+                            int * ALC_RESTRICT info)
+{
+    size_t first;
+
+    for (first = 0; first < count; ++first) {
+        info[first] = 0;
+    }
+
+    for (first = 0; first < count; first += BATCH_CHUNK) {
+        size_t last = count - first < BATCH_CHUNK ? count : first + BATCH_CHUNK;
+        size_t lanes[BATCH_CHUNK];
+        size_t k;
+
+        for (k = 0; k < n; ++k) {
+            size_t i, j, b;
+
+            batch_pivot(n, count, a, k, first, last, lanes, info);
+
+            for (b = first; b < last; ++b) {
+                pivots[k * count + b] = lanes[b - first];
+            }
+
+            for (i = k + 1; i < n; ++i) {
+                for (b = first; b < last; ++b) {
+                    double pivot = BATCH_AT(a, n, count, k, k, b);
+                    /* a zero pivot is already in info; keep the lane finite and move on */
+                    BATCH_AT(a, n, count, i, k, b) /= pivot != 0 ? pivot : 1;
+                }
+
+                for (j = k + 1; j < n; ++j) {
+                    for (b = first; b < last; ++b) {
+                        BATCH_AT(a, n, count, i, j, b) -= BATCH_AT(a, n, count, i, k, b) * BATCH_AT(a, n, count, k, j, b);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ *  Resolve, no próprio lugar, os sistemas Ax = b de um lote a partir da fatoração de batch_lu_factor.
+ *  @param x Contém os vetores b na entrada e os vetores x na saída.
+ */
+static void batch_lu_solve(size_t n, size_t count, const double * ALC_RESTRICT lu, const size_t * ALC_RESTRICT pivots,
+                           double * ALC_RESTRICT x)
+{
+    size_t i, j, b;
+
+    for (i = 0; i < n; ++i) {
+        for (b = 0; b < count; ++b) {
+            size_t p = pivots[i * count + b];
+            double swap = x[i * count + b];
+            x[i * count + b] = x[p * count + b];
+            x[p * count + b] = swap;
+        }
+    }
+
+    for (i = 1; i < n; ++i) {
+        for (j = 0; j < i; ++j) {
+            for (b = 0; b < count; ++b) {
+                x[i * count + b] -= BATCH_AT(lu, n, count, i, j, b) * x[j * count + b];
+            }
+        }
+    }
+
+    for (i = n; i-- > 0;) {
+        for (j = i + 1; j < n; ++j) {
+            for (b = 0; b < count; ++b) {
+                x[i * count + b] -= BATCH_AT(lu, n, count, i, j, b) * x[j * count + b];
+            }
+        }
+
+        for (b = 0; b < count; ++b) {
+            double pivot = BATCH_AT(lu, n, count, i, i, b);
+            x[i * count + b] /= pivot != 0 ? pivot : 1;
+        }
+    }
+}
+
+/**
+ *  Calcula, no próprio lugar, o fator de Cholesky inferior (A = LL^T) de um lote de matrizes. <br>
+ *  Somente o triângulo inferior é lido e escrito; o superior fica como estava.
+ */
+static void batch_cholesky_factor(size_t n, size_t count, double * ALC_RESTRICT a, int * ALC_RESTRICT info)
+{
+    size_t i, j, k, b;
+
+    for (b = 0; b < count; ++b) {
+        info[b] = 0;
+    }
+
+    for (j = 0; j < n; ++j) {
+        for (k = 0; k < j; ++k) {
+            for (b = 0; b < count; ++b) {
+                BATCH_AT(a, n, count, j, j, b) -= BATCH_AT(a, n, count, j, k, b) * BATCH_AT(a, n, count, j, k, b);
+            }
+        }
+
+        for (b = 0; b < count; ++b) {
+            double d = BATCH_AT(a, n, count, j, j, b);
+            if (d <= 0 && info[b] == 0) {
+                info[b] = (int) j + 1;
+            }
+            BATCH_AT(a, n, count, j, j, b) = d > 0 ? sqrt(d) : 1;
+        }
+
+        for (i = j + 1; i < n; ++i) {
+            for (k = 0; k < j; ++k) {
+                for (b = 0; b < count; ++b) {
+                    BATCH_AT(a, n, count, i, j, b) -= BATCH_AT(a, n, count, i, k, b) * BATCH_AT(a, n, count, j, k, b);
+                }
+            }
+
+            for (b = 0; b < count; ++b) {
+                BATCH_AT(a, n, count, i, j, b) /= BATCH_AT(a, n, count, j, j, b);
+            }
+        }
+    }
+}
+
+/**
+ *  Resolve, no próprio lugar, os sistemas Ax = b de um lote a partir dos fatores de batch_cholesky_factor.
+ *  @param x Contém os vetores b na entrada e os vetores x na saída.
+ */
+static void batch_cholesky_solve(size_t n, size_t count, const double * ALC_RESTRICT l, double * ALC_RESTRICT x)
+{
+    size_t i, j, b;
+
+    for (i = 0; i < n; ++i) {
+        for (j = 0; j < i; ++j) {
+            for (b = 0; b < count; ++b) {
+                x[i * count + b] -= BATCH_AT(l, n, count, i, j, b) * x[j * count + b];
+            }
+        }
+
+        for (b = 0; b < count; ++b) {
+            x[i * count + b] /= BATCH_AT(l, n, count, i, i, b);
+        }
+    }
+
+    for (i = n; i-- > 0;) {
+        for (j = i + 1; j < n; ++j) {
+            for (b = 0; b < count; ++b) {
+                x[i * count + b] -= BATCH_AT(l, n, count, j, i, b) * x[j * count + b];
+            }
+        }
+
+        for (b = 0; b < count; ++b) {
+            x[i * count + b] /= BATCH_AT(l, n, count, i, i, b);
+        }
+    }
+}
+
+/**
+ *  Resolve os sistemas Ax = b de um lote por LU com pivoteamento parcial.
+ *  @param a As matrizes, que são sobrescritas pelas suas fatorações.
+ *  @param pivots Espaço para n * count índices.
+ *  @param x Contém os vetores b na entrada e os vetores x na saída.
+ */
+static void batch_solve(size_t n, size_t count, double * ALC_RESTRICT a, size_t * ALC_RESTRICT pivots, double * ALC_RESTRICT x,
+                        int * ALC_RESTRICT info)
+{
+    batch_lu_factor(n, count, a, pivots, info);
+    batch_lu_solve(n, count, a, pivots, x);
+}
+
+/**
+ *  Inverte um lote de matrizes de ordem n. <br>
+ *  Ordens 2, 3 e 4 usam fórmulas fechadas; as demais, Gauss-Jordan no próprio lugar com pivoteamento parcial.
+ *  @param inv Recebe as inversas; pode ser o próprio a somente para ordens maiores que 4.
+ */
+static void batch_inverse(size_t n, size_t count, const double *a, double *inv, int * ALC_RESTRICT info)
+{
+    size_t first;
+
+    if (n == 2) {
+        batch_inverse2(count, a, inv, info);
+        return;
+    }
+
+    if (n == 3) {
+        batch_inverse3(count, a, inv, info);
+        return;
+    }
+
+    if (n == 4) {
+        batch_inverse4(count, a, inv, info);
+        return;
+    }
+
+    if (inv != a) {
+        memcpy(inv, a, sizeof(double) * n * n * count);
+    }
+
+    for (first = 0; first < count; ++first) {
+        info[first] = 0;
+    }
+
+    for (first = 0; first < count; first += BATCH_CHUNK) {
+        size_t last = count - first < BATCH_CHUNK ? count : first + BATCH_CHUNK;
+        size_t lanes[BATCH_CHUNK];
+        size_t *history = NULL;
+        size_t k;
+
+        /* the pivots of every step are needed at the end; n is small, so keep them on the stack */
+        size_t steps[16 * BATCH_CHUNK];
+        history = n <= 16 ? steps : (size_t *) malloc(sizeof(size_t) * n * BATCH_CHUNK);
+
+        if (history == NULL) {
+            size_t b;
+            for (b = first; b < last; ++b) {
+                info[b] = -1;
+            }
+            continue;
+        }
+
+        for (k = 0; k < n; ++k) {
+            double scale[BATCH_CHUNK];
+            size_t i, j, b;
+
+            batch_pivot(n, count, inv, k, first, last, lanes, info);
+
+            for (b = first; b < last; ++b) {
+                double pivot = BATCH_AT(inv, n, count, k, k, b);
+                history[k * BATCH_CHUNK + b - first] = lanes[b - first];
+                scale[b - first] = pivot != 0 ? 1 / pivot : 0;
+                BATCH_AT(inv, n, count, k, k, b) = 1;
+            }
+
+            for (j = 0; j < n; ++j) {
+                for (b = first; b < last; ++b) {
+                    BATCH_AT(inv, n, count, k, j, b) *= scale[b - first];
+                }
+            }
+
+            for (i = 0; i < n; ++i) {
+                if (i == k) {
+                    continue;
+                }
+
+                for (b = first; b < last; ++b) {
+                    scale[b - first] = BATCH_AT(inv, n, count, i, k, b);
+                    BATCH_AT(inv, n, count, i, k, b) = 0;
+                }
+
+                for (j = 0; j < n; ++j) {
+                    for (b = first; b < last; ++b) {
+                        BATCH_AT(inv, n, count, i, j, b) -= scale[b - first] * BATCH_AT(inv, n, count, k, j, b);
+                    }
+                }
+            }
+        }
+
+        /* row interchanges become column interchanges of the inverse, undone in reverse */
+        for (k = n; k-- > 0;) {
+            size_t i, b;
+            for (i = 0; i < n; ++i) {
+                for (b = first; b < last; ++b) {
+                    size_t p = history[k * BATCH_CHUNK + b - first];
+                    double swap = BATCH_AT(inv, n, count, i, k, b);
+                    BATCH_AT(inv, n, count, i, k, b) = BATCH_AT(inv, n, count, i, p, b);
+                    BATCH_AT(inv, n, count, i, p, b) = swap;
+                }
+            }
+        }
+
+        if (history != steps) {
+            free(history);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,80 @@
+/**
+ *  @file
+ */
+/*
+ * Copyright (c) 2018 Victor Hermann "vitorhnn" Chiletto
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+**/
+
+#ifndef BLAS_H
+#define BLAS_H
+
+/*
+ * Dense kernels over raw row-major arrays, in the spirit of the BLAS.
+ * Every matrix is a pointer plus a leading dimension (the distance, in elements,
+ * between the starts of two consecutive rows), so that blocks of a larger
+ * matrix can be passed without copying.
+ *
+ * Each kernel is generated from blas_impl.h for double and, with an f suffix
+ * (gemmf, trsm_left_lower_unitf, ...), for float.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ *  Profundidade dos blocos de op(B) empacotados por gemm.
+ */
+#ifndef GEMM_KC
+#define GEMM_KC 256
+#endif
+
+/**
+ *  Largura dos blocos de op(B) empacotados por gemm.
+ */
+#ifndef GEMM_NC
+#define GEMM_NC 512
+#endif
+
+/**
+ *  Ordem abaixo da qual as rotinas triangulares recursivas usam laços diretos.
+ */
+#ifndef BLAS_TRIANGULAR_BASE
+#define BLAS_TRIANGULAR_BASE 32
+#endif
+
+/** Usa o operando como está. **/
+#define BLAS_NO_TRANS 0
+/** Usa a transposta do operando. **/
+#define BLAS_TRANS 1
+
+#define REAL double
+#define REAL_NAME(name) name
+#include "blas_impl.h"
+#undef REAL_NAME
+#undef REAL
+
+#define REAL float
+#define REAL_NAME(name) name##f
+#include "blas_impl.h"
+#undef REAL_NAME
+#undef REAL
+
+#endif
@@ -0,0 +1,362 @@
+/**
+ *  @file
+ */
+/*
+ * Copyright (c) 2018 Victor Hermann "vitorhnn" Chiletto
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+**/
+
+/*
+ * Precision-generic body of blas.h; no include guard on purpose.
+ * The includer defines REAL (the element type) and REAL_NAME(name) (the
+ * routine name for that type), includes this file and undefines both.
+ */
+
+/**
+ *  Calcula C = alpha * op(A) * op(B) + beta * C.
+ *  @param trans_a BLAS_TRANS para usar A^T, que então é guardada como k x m.
+ *  @param trans_b BLAS_TRANS para usar B^T, que então é guardada como n x k.
+ *  @param m Linhas de C e de op(A).
+ *  @param n Colunas de C e de op(B).
+ *  @param k Colunas de op(A) e linhas de op(B).
+ */
+static void REAL_NAME(gemm)(int trans_a, int trans_b, size_t m, size_t n, size_t k,
+                 REAL alpha, const REAL *A, size_t lda, const REAL *B, size_t ldb,
+                 REAL beta, REAL *C, size_t ldc)
+{
+    REAL *packed;
+    size_t jc, pc, i;
+
+    if (beta != 1) {
+        for (i = 0; i < m; ++i) {
+            REAL *c = C + i * ldc;
+            size_t j;
+            if (beta == 0) {
+                memset(c, 0, sizeof(REAL) * n);
+            } else {
+                for (j = 0; j < n; ++j) {
+                    c[j] *= beta;
+                }
+            }
+        }
+    }
+
+    if (alpha == 0 || m == 0 || n == 0 || k == 0) {
+        return;
+    }
+
+    packed = (REAL *) malloc(sizeof(REAL) * GEMM_KC * (n < GEMM_NC ? n : GEMM_NC));
+
+    if (packed == NULL) {
+        /* out of memory for the packing buffer: the same product, straight from A and B */
+        for (i = 0; i < m; ++i) {
+            REAL *c = C + i * ldc;
+            size_t p, j;
+
+            for (p = 0; p < k; ++p) {
+                REAL a = alpha * (trans_a ? A[p * lda + i] : A[i * lda + p]);
+
+                if (trans_b) {
+                    for (j = 0; j < n; ++j) {
+                        c[j] += a * B[j * ldb + p];
+                    }
+                } else {
+                    const REAL *b = B + p * ldb;
+                    for (j = 0; j < n; ++j) {
+                        c[j] += a * b[j];
+                    }
+                }
+            }
+        }
+        return;
+    }
+
+    for (jc = 0; jc < n; jc += GEMM_NC) {
+        size_t nc = n - jc < GEMM_NC ? n - jc : GEMM_NC;
+
+        for (pc = 0; pc < k; pc += GEMM_KC) {
+            size_t kc = k - pc < GEMM_KC ? k - pc : GEMM_KC;
+            size_t p;
+
+            /* pack alpha * op(B)[pc:pc+kc, jc:jc+nc] into contiguous rows */
+            for (p = 0; p < kc; ++p) {
+                REAL *dst = packed + p * nc;
+                size_t j;
+                if (trans_b) {
+                    for (j = 0; j < nc; ++j) {
+                        dst[j] = alpha * B[(jc + j) * ldb + pc + p];
+                    }
+                } else {
+                    const REAL *src = B + (pc + p) * ldb + jc;
+                    for (j = 0; j < nc; ++j) {
+                        dst[j] = alpha * src[j];
+                    }
+                }
+            }
+
+            /* four rows of C at a time, so each packed row of B is loaded once per four updates */
+            for (i = 0; i < m; i += 4) {
+                size_t rows = m - i < 4 ? m - i : 4;
+                REAL *c0 = C + i * ldc + jc;
+                REAL *c1 = rows > 1 ? c0 + ldc : c0;
+                REAL *c2 = rows > 2 ? c1 + ldc : c0;
+                REAL *c3 = rows > 3 ? c2 + ldc : c0;
+
+                for (p = 0; p < kc; ++p) {
+                    const REAL *b = packed + p * nc;
+                    REAL a[4] = {0, 0, 0, 0};
+                    size_t r, j;
+
+                    for (r = 0; r < rows; ++r) {
+                        a[r] = trans_a ? A[(pc + p) * lda + i + r] : A[(i + r) * lda + pc + p];
+                    }
+
+                    if (rows == 4) {
+                        for (j = 0; j < nc; ++j) {
+                            REAL bj = b[j];
+                            c0[j] += a[0] * bj;
+                            c1[j] += a[1] * bj;
+                            c2[j] += a[2] * bj;
+                            c3[j] += a[3] * bj;
+                        }
+                    } else {
+                        REAL *c[3];
+                        c[0] = c0;
+                        c[1] = c1;
+                        c[2] = c2;
+                        for (r = 0; r < rows; ++r) {
+                            REAL *cr = c[r];
+                            for (j = 0; j < nc; ++j) {
+                                cr[j] += a[r] * b[j];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    free(packed);
+}
+
+/**
+ *  Calcula y = alpha * op(A) * x + beta * y.
+ *  @param trans BLAS_TRANS para usar A^T, que então é guardada como n x m.
+ *  @param m Linhas de op(A) e componentes de y.
+ *  @param n Colunas de op(A) e componentes de x.
+ */
+static void REAL_NAME(gemv)(int trans, size_t m, size_t n, REAL alpha, const REAL *A, size_t lda,
+                            const REAL *x, REAL beta, REAL *y)
+{
+    size_t i, j;
+
+    for (i = 0; i < m; ++i) {
+        y[i] = beta == 0 ? 0 : beta * y[i];
+    }
+
+    if (alpha == 0) {
+        return;
+    }
+
+    if (trans) {
+        /* y += alpha * sum_j x_j * row j of A, so the rows are still read contiguously */
+        for (j = 0; j < n; ++j) {
+            const REAL *row = A + j * lda;
+            REAL xj = alpha * x[j];
+            for (i = 0; i < m; ++i) {
+                y[i] += xj * row[i];
+            }
+        }
+    } else {
+        for (i = 0; i < m; ++i) {
+            const REAL *row = A + i * lda;
+            REAL sum = 0;
+            for (j = 0; j < n; ++j) {
+                sum += row[j] * x[j];
+            }
+            y[i] += alpha * sum;
+        }
+    }
+}
+
+/**
+ *  Calcula B = L^-1 * B, com L (m x m) triangular inferior de diagonal unitária.
+ */
+static void REAL_NAME(trsm_left_lower_unit)(size_t m, size_t n, const REAL *L, size_t ldl, REAL *B, size_t ldb)
+{
+    size_t half;
+
+    if (m <= BLAS_TRIANGULAR_BASE) {
+        size_t i;
+        for (i = 1; i < m; ++i) {
+            REAL *bi = B + i * ldb;
+            size_t p;
+            for (p = 0; p < i; ++p) {
+                REAL l = L[i * ldl + p];
+                const REAL *bp = B + p * ldb;
+                size_t j;
+                for (j = 0; j < n; ++j) {
+                    bi[j] -= l * bp[j];
+                }
+            }
+        }
+        return;
+    }
+
+    half = m / 2;
+    REAL_NAME(trsm_left_lower_unit)(half, n, L, ldl, B, ldb);
+    REAL_NAME(gemm)(BLAS_NO_TRANS, BLAS_NO_TRANS, m - half, n, half, -1, L + half * ldl, ldl, B, ldb, 1, B + half * ldb, ldb);
+    REAL_NAME(trsm_left_lower_unit)(m - half, n, L + half * ldl + half, ldl, B + half * ldb, ldb);
+}
+
+/**
+ *  Calcula B = U * B, com U (m x m) triangular superior.
+ */
+static void REAL_NAME(trmm_left_upper)(size_t m, size_t n, const REAL *U, size_t ldu, REAL *B, size_t ldb)
+{
+    size_t half;
+
+    if (m <= BLAS_TRIANGULAR_BASE) {
+        size_t i;
+        /* top to bottom: row i only reads rows at or below it, which are still untouched */
+        for (i = 0; i < m; ++i) {
+            REAL *bi = B + i * ldb;
+            REAL u = U[i * ldu + i];
+            size_t p, j;
+
+            for (j = 0; j < n; ++j) {
+                bi[j] *= u;
+            }
+
+            for (p = i + 1; p < m; ++p) {
+                const REAL *bp = B + p * ldb;
+                u = U[i * ldu + p];
+                for (j = 0; j < n; ++j) {
+                    bi[j] += u * bp[j];
+                }
+            }
+        }
+        return;
+    }
+
+    half = m / 2;
+    REAL_NAME(trmm_left_upper)(half, n, U, ldu, B, ldb);
+    REAL_NAME(gemm)(BLAS_NO_TRANS, BLAS_NO_TRANS, half, n, m - half, 1, U + half, ldu, B + half * ldb, ldb, 1, B, ldb);
+    REAL_NAME(trmm_left_upper)(m - half, n, U + half * ldu + half, ldu, B + half * ldb, ldb);
+}
+
+/**
+ *  Calcula B = B * U^-1, com U (n x n) triangular superior.
+ */
+static void REAL_NAME(trsm_right_upper)(size_t m, size_t n, const REAL *U, size_t ldu, REAL *B, size_t ldb)
+{
+    size_t half;
+
+    if (n <= BLAS_TRIANGULAR_BASE) {
+        size_t i;
+        for (i = 0; i < m; ++i) {
+            REAL *bi = B + i * ldb;
+            size_t p;
+            for (p = 0; p < n; ++p) {
+                const REAL *up = U + p * ldu;
+                REAL x = bi[p] / up[p];
+                size_t j;
+
+                bi[p] = x;
+                for (j = p + 1; j < n; ++j) {
+                    bi[j] -= x * up[j];
+                }
+            }
+        }
+        return;
+    }
+
+    half = n / 2;
+    REAL_NAME(trsm_right_upper)(m, half, U, ldu, B, ldb);
+    REAL_NAME(gemm)(BLAS_NO_TRANS, BLAS_NO_TRANS, m, n - half, half, -1, B, ldb, U + half, ldu, 1, B + half, ldb);
+    REAL_NAME(trsm_right_upper)(m, n - half, U + half * ldu + half, ldu, B + half, ldb);
+}
+
+/**
+ *  Calcula B = B * L^-1, com L (n x n) triangular inferior de diagonal unitária.
+ */
+static void REAL_NAME(trsm_right_lower_unit)(size_t m, size_t n, const REAL *L, size_t ldl, REAL *B, size_t ldb)
+{
+    size_t half;
+
+    if (n <= BLAS_TRIANGULAR_BASE) {
+        size_t i;
+        for (i = 0; i < m; ++i) {
+            REAL *bi = B + i * ldb;
+            size_t p;
+            /* right to left: x_p is final once every x_j, j > p, has been subtracted */
+            for (p = n; p-- > 1;) {
+                const REAL *lp = L + p * ldl;
+                REAL x = bi[p];
+                size_t j;
+                for (j = 0; j < p; ++j) {
+                    bi[j] -= x * lp[j];
+                }
+            }
+        }
+        return;
+    }
+
+    half = n / 2;
+    REAL_NAME(trsm_right_lower_unit)(m, n - half, L + half * ldl + half, ldl, B + half, ldb);
+    REAL_NAME(gemm)(BLAS_NO_TRANS, BLAS_NO_TRANS, m, half, n - half, -1, B + half, ldb, L + half * ldl, ldl, 1, B, ldb);
+    REAL_NAME(trsm_right_lower_unit)(m, half, L, ldl, B, ldb);
+}
+
+/**
+ *  Calcula B = U^-T * B, com U (m x m) triangular superior.
+ */
+static void REAL_NAME(trsm_left_upper_trans)(size_t m, size_t n, const REAL *U, size_t ldu, REAL *B, size_t ldb)
+{
+    size_t half;
+
+    if (m <= BLAS_TRIANGULAR_BASE) {
+        size_t i;
+        /* U^T is lower triangular and its column i is row i of U, so this is forward elimination by rows */
+        for (i = 0; i < m; ++i) {
+            const REAL *ui = U + i * ldu;
+            REAL *bi = B + i * ldb;
+            size_t p, j;
+
+            for (j = 0; j < n; ++j) {
+                bi[j] /= ui[i];
+            }
+
+            for (p = i + 1; p < m; ++p) {
+                REAL u = ui[p];
+                REAL *bp = B + p * ldb;
+                for (j = 0; j < n; ++j) {
+                    bp[j] -= u * bi[j];
+                }
+            }
+        }
+        return;
+    }
+
+    half = m / 2;
+    REAL_NAME(trsm_left_upper_trans)(half, n, U, ldu, B, ldb);
+    REAL_NAME(gemm)(BLAS_TRANS, BLAS_NO_TRANS, m - half, n, half, -1, U + half, ldu, B, ldb, 1, B + half * ldb, ldb);
+    REAL_NAME(trsm_left_upper_trans)(m - half, n, U + half * ldu + half, ldu, B + half * ldb, ldb);
+}
@@ -28,6 +28,31 @@
 
 #include "matrix.h"
 #include "basic.h"
+#include "blas.h"
+#include "workspace.h"
+
+/**
+ *  Quantidade de linhas dos blocos da fatoração de Cholesky.
+ */
+#ifndef CHOLESKY_BLOCK
+#define CHOLESKY_BLOCK 64
+#endif
+
+#define REAL double
+#define REAL_NAME(name) name
+#define REAL_SQRT(x) sqrt(x)
+#include "cholesky_impl.h"
+#undef REAL_SQRT
+#undef REAL_NAME
+#undef REAL
+
+#define REAL float
+#define REAL_NAME(name) name##f
+#define REAL_SQRT(x) sqrtf(x)
+#include "cholesky_impl.h"
+#undef REAL_SQRT
+#undef REAL_NAME
+#undef REAL
 
 /**
  *  Calcula o fator de Cholesky da matriz mat
@@ -35,69 +60,67 @@
  */
 static matrix_t *cholesky_factor(const matrix_t *mat)
 {
-    matrix_t *factor = matrix_new(mat->rows, mat->columns);
-
+    matrix_t *factor = matrix_copy(mat);
+    size_t n = factor->rows;
     size_t i;
 
-    memset(factor->elements, 0, sizeof(double) * (factor->rows * factor->columns));
-
-    for (i = 0; i < mat->rows; ++i) {
-        size_t j, k;
-
-        double current = matrix_get_at(mat, i, i);
+    assert(factor->rows == factor->columns);
 
-        for (k = 0; k < i; ++k) {
-            current -= pow(matrix_get_at(factor, k, i), 2);
-        }
-
-        if (current <= 0) {
-            matrix_free(factor);
-            return NULL;
-        }
-
-        current = sqrt(current);
-
-        matrix_set_at(factor, i, i, current);
-
-        for (j = i + 1; j < mat->rows; ++j) {
-            double current = matrix_get_at(mat, i, j);
-
-            for (k = 0; k < i; ++k) {
-                current -= matrix_get_at(factor, k, i) * matrix_get_at(factor, k, j);
-            }
-
-            current /= matrix_get_at(factor, i, i);
+    if (cholesky_factor_array(n, factor->elements, n) != 0) {
+        matrix_free(factor);
+        return NULL;
+    }
 
-            matrix_set_at(factor, i, j, current);
-        }
+    for (i = 1; i < n; ++i) {
+        memset(factor->elements + i * n, 0, sizeof(double) * i);
     }
 
     return factor;
 }
 
 /**
- *  Resolve o sistema Ax = b por fatoração de Cholesky
+ *  Bytes de workspace com que cholesky_solve_ws não aloca temporários.
+ */
+static size_t cholesky_solve_workspace_size(size_t n)
+{
+    return workspace_bytes(sizeof(double) * n * n);
+}
+
+/**
+ *  Resolve o sistema Ax = b por fatoração de Cholesky, tirando o fator de ws.
+ *  @param ws Workspace de cholesky_solve_workspace_size(n) bytes, ou NULL.
  *  @return O vetor x caso seja possível aplicar fatoração de Cholesky, NULL caso contrário.
  */
-static matrix_t *cholesky_solve(const matrix_t * restrict A, const matrix_t * restrict b)
+static matrix_t *cholesky_solve_ws(const matrix_t * ALC_RESTRICT A, const matrix_t * ALC_RESTRICT b, workspace_t *ws)
 {
-    matrix_t *factor = cholesky_factor(A);
+    size_t n = A->rows;
+    size_t mark = workspace_mark(ws);
+    double *r = (double *) workspace_alloc(ws, sizeof(double) * n * n);
+    matrix_t *x = NULL;
 
-    if (factor == NULL) {
-        return NULL;
-    }
+    assert(A->rows == A->columns);
+    assert(b->rows == n && b->columns == 1);
 
-    matrix_t *trans_factor = matrix_transpose(factor);
+    matrix_pack(A, r, n);
 
-    matrix_t *y = forwards_substitution(trans_factor, b);
-    
-    matrix_t *x = backwards_substitution(factor, y);
+    if (cholesky_factor_array(n, r, n) == 0) {
+        x = matrix_copy(b);
+        cholesky_apply_array(n, r, n, x->elements);
+    }
 
-    matrix_free(factor);
-    matrix_free(trans_factor);
-    matrix_free(y);
+    workspace_dealloc(ws, r);
+    workspace_release(ws, mark);
 
     return x;
 }
 
+/**
+ *  Resolve o sistema Ax = b por fatoração de Cholesky
+ *  @return O vetor x caso seja possível aplicar fatoração de Cholesky, NULL caso contrário.
+ */
+static matrix_t *cholesky_solve(const matrix_t * ALC_RESTRICT A, const matrix_t * ALC_RESTRICT b)
+{
+    return cholesky_solve_ws(A, b, NULL);
+}
+
 #endif
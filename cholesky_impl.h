@@ -0,0 +1,135 @@
+/**
+ *  @file
+ */
+/*
+ * Copyright (c) 2018 Victor Hermann "vitorhnn" Chiletto
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+**/
+
+/*
+ * Precision-generic body of the Cholesky kernels in cholesky.h; no include
+ * guard on purpose. The includer defines REAL and REAL_NAME(name) as for
+ * blas_impl.h, and REAL_SQRT(x) as sqrt or sqrtf, so floats stay floats.
+ */
+
+/**
+ *  Fatora a[0:n, 0:n] = R^T R, no próprio vetor, com R triangular superior. <br>
+ *  Só o triângulo superior é lido e escrito. A fatoração é feita em blocos de CHOLESKY_BLOCK
+ *  linhas; o triângulo superior do restante da matriz é atualizado com um gemm por bloco de linhas.
+ *  @return 0 em caso de sucesso, k + 1 caso o k-ésimo pivô não seja positivo.
+ */
+static size_t REAL_NAME(cholesky_factor_array)(size_t n, REAL *a, size_t lda)
+{
+    size_t k;
+
+    for (k = 0; k < n; k += CHOLESKY_BLOCK) {
+        size_t end = k + CHOLESKY_BLOCK < n ? k + CHOLESKY_BLOCK : n;
+        size_t i;
+
+        /* R11, right-looking inside the diagonal block */
+        for (i = k; i < end; ++i) {
+            REAL *row_i = a + i * lda;
+            REAL d = row_i[i];
+            size_t p;
+
+            if (!(d > 0)) {
+                return i + 1;
+            }
+
+            d = REAL_SQRT(d);
+            row_i[i] = d;
+            for (p = i + 1; p < end; ++p) {
+                row_i[p] /= d;
+            }
+
+            for (p = i + 1; p < end; ++p) {
+                REAL *row_p = a + p * lda;
+                REAL r = row_i[p];
+                size_t j;
+                for (j = p; j < end; ++j) {
+                    row_p[j] -= r * row_i[j];
+                }
+            }
+        }
+
+        if (end < n) {
+            size_t r;
+
+            /* R12 = R11^-T A12 */
+            REAL_NAME(trsm_left_upper_trans)(end - k, n - end, a + k * lda + k, lda, a + k * lda + end, lda);
+
+            /* A22 -= R12^T R12 on the upper triangle only, one block row at a time */
+            for (r = end; r < n; r += CHOLESKY_BLOCK) {
+                size_t stop = r + CHOLESKY_BLOCK < n ? r + CHOLESKY_BLOCK : n;
+
+                for (i = r; i < stop; ++i) {
+                    REAL *row_i = a + i * lda;
+                    size_t p;
+                    for (p = k; p < end; ++p) {
+                        const REAL *row_p = a + p * lda;
+                        REAL s = row_p[i];
+                        size_t j;
+                        for (j = i; j < stop; ++j) {
+                            row_i[j] -= s * row_p[j];
+                        }
+                    }
+                }
+
+                if (stop < n) {
+                    REAL_NAME(gemm)(BLAS_TRANS, BLAS_NO_TRANS, stop - r, n - stop, end - k,
+                                    -1, a + k * lda + r, lda, a + k * lda + stop, lda, 1, a + r * lda + stop, lda);
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ *  Resolve R^T R x = b em O(n^2), no próprio vetor x, a partir da fatoração de cholesky_factor_array.
+ *  @param x Contém b na entrada e x na saída.
+ */
+static void REAL_NAME(cholesky_apply_array)(size_t n, const REAL *r, size_t lda, REAL *x)
+{
+    size_t i;
+
+    /* R^T y = b, walking R by rows so that the inner loop is contiguous */
+    for (i = 0; i < n; ++i) {
+        const REAL *row = r + i * lda;
+        REAL y = x[i] / row[i];
+        size_t j;
+
+        x[i] = y;
+        for (j = i + 1; j < n; ++j) {
+            x[j] -= row[j] * y;
+        }
+    }
+
+    for (i = n; i-- > 0;) {
+        const REAL *row = r + i * lda;
+        REAL sum = x[i];
+        size_t j;
+        for (j = i + 1; j < n; ++j) {
+            sum -= row[j] * x[j];
+        }
+        x[i] = sum / row[i];
+    }
+}
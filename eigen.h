@@ -0,0 +1,768 @@
+/**
+ *  @file
+ */
+/*
+ * Copyright (c) 2018 Victor Hermann "vitorhnn" Chiletto
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+**/
+
+#ifndef EIGEN_H
+#define EIGEN_H
+
+/*
+ * Eigenvalues and eigenvectors of symmetric matrices.
+ *
+ * A is first reduced to a tridiagonal T = Q^T A Q with Householder
+ * reflectors. As in LAPACK's DSYTRD, the reflectors are gathered in panels
+ * of EIGEN_BLOCK columns, and the rest of the matrix receives each panel at
+ * once with two gemm calls (A -= V W^T + W V^T).
+ *
+ * For the whole spectrum, T is diagonalized by implicit QL with Wilkinson
+ * shifts, accumulating the rotations when the eigenvectors are wanted. For
+ * only the k largest eigenpairs, the eigenvalues are found by bisection with
+ * Sturm counts, in O(nk), and their eigenvectors by inverse iteration on T,
+ * reorthogonalized inside clusters of close eigenvalues. Either way the
+ * eigenvectors of T are then taken back through Q with compact WY blocks
+ * (see qr.h).
+ */
+
+#include "matrix.h"
+#include "basic.h"
+#include "blas.h"
+#include "qr.h"
+
+/**
+ *  Largura dos painéis da tridiagonalização.
+ */
+#ifndef EIGEN_BLOCK
+#define EIGEN_BLOCK 32
+#endif
+
+/**
+ *  Máximo de iterações do QL implícito por autovalor.
+ */
+#ifndef EIGEN_MAX_ITERATIONS
+#define EIGEN_MAX_ITERATIONS 30
+#endif
+
+/**
+ *  Calcula y = A x para a simétrica A[0:m, 0:m], lendo só o triângulo superior, linha a linha.
+ */
+static void eigen_symv_upper(size_t m, const double *a, size_t lda, const double *x, double *y)
+{
+    size_t r, c;
+
+    memset(y, 0, sizeof(double) * m);
+
+    for (r = 0; r < m; ++r) {
+        const double *row = a + r * lda;
+        double xr = x[r];
+        double sum = row[r] * xr;
+
+        /* a[r, c] stands for a[c, r] too */
+        for (c = r + 1; c < m; ++c) {
+            sum += row[c] * x[c];
+            y[c] += row[c] * xr;
+        }
+        y[r] += sum;
+    }
+}
+
+/**
+ *  Reduz a matriz simétrica a[0:n, 0:n] a uma tridiagonal T = Q^T A Q, lendo e escrevendo só o triângulo superior. <br>
+ *  Q = H_0 ... H_{n-3}, onde H_j = I - tau_j v_j v_j^T atua nos índices j + 1 .. n - 1, com v_j[j + 1] = 1
+ *  implícito e o restante de v_j guardado em a[j, j + 2:n].
+ *  @param d Recebe a diagonal de T (n posições).
+ *  @param e Recebe a subdiagonal de T (n - 1 posições).
+ *  @param tau Recebe os fatores dos refletores (n - 1 posições).
+ *  @return 0, ou -1 caso falte memória.
+ */
+static int eigen_tridiagonalize_array(size_t n, double *a, size_t lda, double *d, double *e, double *tau)
+{
+    double *V = (double *) malloc(sizeof(double) * (n + 1) * EIGEN_BLOCK);
+    double *W = (double *) malloc(sizeof(double) * (n + 1) * EIGEN_BLOCK);
+    double *v = (double *) malloc(sizeof(double) * (n + 1));
+    double *p = (double *) malloc(sizeof(double) * (n + 1));
+    double *aux = (double *) malloc(sizeof(double) * EIGEN_BLOCK);
+    size_t i;
+
+    if (V == NULL || W == NULL || v == NULL || p == NULL || aux == NULL) {
+        free(V);
+        free(W);
+        free(v);
+        free(p);
+        free(aux);
+        return -1;
+    }
+
+    for (i = 0; i < n; i += EIGEN_BLOCK) {
+        size_t nb = n - i < EIGEN_BLOCK ? n - i : EIGEN_BLOCK;
+        size_t k, r;
+
+        /* V and W hold rows i .. n - 1 of the panel's reflectors and of their updates */
+        memset(V, 0, sizeof(double) * (n - i) * nb);
+        memset(W, 0, sizeof(double) * (n - i) * nb);
+
+        for (k = 0; k < nb; ++k) {
+            size_t j = i + k;
+            double *row = a + j * lda;
+            double alpha, dot;
+
+            /* row j (the same as column j) still misses the panel's earlier updates */
+            if (k > 0) {
+                gemv(BLAS_NO_TRANS, n - j, k, -1, V + (j - i) * nb, nb, W + (j - i) * nb, 1, row + j);
+                gemv(BLAS_NO_TRANS, n - j, k, -1, W + (j - i) * nb, nb, V + (j - i) * nb, 1, row + j);
+            }
+
+            d[j] = row[j];
+            if (j + 1 == n) {
+                break;
+            }
+
+            tau[j] = qr_householder(n - j - 2, row + j + 1, row + j + 2, 1);
+            e[j] = row[j + 1];
+
+            v[0] = 1;
+            for (r = j + 2; r < n; ++r) {
+                v[r - j - 1] = row[r];
+            }
+
+            /* w = tau (A22 v - V W^T v - W V^T v), then w -= (tau / 2) (w^T v) v */
+            eigen_symv_upper(n - j - 1, a + (j + 1) * lda + j + 1, lda, v, p);
+            for (r = 0; r < n - j - 1; ++r) {
+                W[(j + 1 + r - i) * nb + k] = p[r];
+            }
+
+            for (r = j + 1; r < n; ++r) {
+                V[(r - i) * nb + k] = v[r - j - 1];
+            }
+
+            if (k > 0) {
+                double *w = W + (j + 1 - i) * nb;
+                const double *vv = V + (j + 1 - i) * nb;
+                size_t q;
+
+                gemv(BLAS_TRANS, k, n - j - 1, 1, w, nb, v, 0, aux);
+                for (r = 0; r < n - j - 1; ++r) {
+                    double sum = 0;
+                    for (q = 0; q < k; ++q) {
+                        sum += vv[r * nb + q] * aux[q];
+                    }
+                    w[r * nb + k] -= sum;
+                }
+
+                gemv(BLAS_TRANS, k, n - j - 1, 1, vv, nb, v, 0, aux);
+                for (r = 0; r < n - j - 1; ++r) {
+                    double sum = 0;
+                    for (q = 0; q < k; ++q) {
+                        sum += w[r * nb + q] * aux[q];
+                    }
+                    w[r * nb + k] -= sum;
+                }
+            }
+
+            dot = 0;
+            for (r = 0; r < n - j - 1; ++r) {
+                W[(j + 1 + r - i) * nb + k] *= tau[j];
+                dot += W[(j + 1 + r - i) * nb + k] * v[r];
+            }
+            alpha = -0.5 * tau[j] * dot;
+            for (r = 0; r < n - j - 1; ++r) {
+                W[(j + 1 + r - i) * nb + k] += alpha * v[r];
+            }
+        }
+
+        /*
+         * the trailing matrix gets the whole panel, A22 -= V W^T + W V^T, on its upper triangle only:
+         * each block row updates its diagonal block by hand and the columns right of it with gemm
+         */
+        for (r = i + nb; r < n; r += EIGEN_BLOCK) {
+            size_t stop = r + EIGEN_BLOCK < n ? r + EIGEN_BLOCK : n;
+            size_t l, c, q;
+
+            for (l = r; l < stop; ++l) {
+                const double *vl = V + (l - i) * nb;
+                const double *wl = W + (l - i) * nb;
+                double *row = a + l * lda;
+
+                for (c = l; c < stop; ++c) {
+                    const double *vc = V + (c - i) * nb;
+                    const double *wc = W + (c - i) * nb;
+                    double sum = 0;
+                    for (q = 0; q < nb; ++q) {
+                        sum += vl[q] * wc[q] + wl[q] * vc[q];
+                    }
+                    row[c] -= sum;
+                }
+            }
+
+            if (stop < n) {
+                gemm(BLAS_NO_TRANS, BLAS_TRANS, stop - r, n - stop, nb, -1, V + (r - i) * nb, nb,
+                     W + (stop - i) * nb, nb, 1, a + r * lda + stop, lda);
+                gemm(BLAS_NO_TRANS, BLAS_TRANS, stop - r, n - stop, nb, -1, W + (r - i) * nb, nb,
+                     V + (stop - i) * nb, nb, 1, a + r * lda + stop, lda);
+            }
+        }
+    }
+
+    free(V);
+    free(W);
+    free(v);
+    free(p);
+    free(aux);
+
+    return 0;
+}
+
+/**
+ *  Calcula Z = Q Z, com Q de eigen_tridiagonalize_array.
+ *  @param Z Matriz n x columns, linha a linha com leading dimension ldz.
+ *  @return 0, ou -1 caso falte memória.
+ */
+static int eigen_apply_q(size_t n, const double *a, size_t lda, const double *tau, double *Z, size_t ldz, size_t columns)
+{
+    double *reflectors;
+    size_t r, j;
+    int status;
+
+    if (n < 3) {
+        return 0;
+    }
+
+    /* shifted down by one, H_j acts like the j-th reflector of a QR of order n - 1 */
+    reflectors = (double *) malloc(sizeof(double) * (n - 1) * (n - 2));
+    if (reflectors == NULL) {
+        return -1;
+    }
+
+    for (r = 0; r < n - 1; ++r) {
+        for (j = 0; j < n - 2; ++j) {
+            reflectors[r * (n - 2) + j] = r > j ? a[j * lda + r + 1] : 0;
+        }
+    }
+
+    status = qr_apply_array(BLAS_NO_TRANS, n - 1, n - 2, reflectors, n - 2, tau, Z + ldz, ldz, columns);
+
+    free(reflectors);
+
+    return status;
+}
+
+/**
+ *  Diagonaliza a tridiagonal (d, e) por QL implícito, com autovalores em ordem crescente em d. <br>
+ *  Caso Zt não seja NULL, as rotações são acumuladas nas suas linhas: se Zt entra como a identidade, a linha
+ *  i sai como o autovetor de d[i].
+ *  @param e Subdiagonal, com n posições (e[n - 1] é usada como rascunho); é destruída.
+ *  @param Zt Matriz n x n, linha a linha com leading dimension ldz, ou NULL.
+ *  @return 0, ou -1 caso o QL não convirja.
+ */
+static int eigen_tridiagonal_ql(size_t n, double *d, double *e, double *Zt, size_t ldz)
+{
+    size_t l, i, j;
+
+    if (n == 0) {
+        return 0;
+    }
+    e[n - 1] = 0;
+
+    for (l = 0; l < n; ++l) {
+        int iterations = 0;
+        size_t m;
+
+        for (;;) {
+            double g, r, s, c, p;
+            int underflow = 0;
+
+            for (m = l; m + 1 < n; ++m) {
+                double dd = fabs(d[m]) + fabs(d[m + 1]);
+                if (fabs(e[m]) <= EPSILON * dd) {
+                    break;
+                }
+            }
+            if (m == l) {
+                break;
+            }
+
+            if (iterations++ == EIGEN_MAX_ITERATIONS) {
+                return -1;
+            }
+
+            /* Wilkinson shift from the leading 2 x 2 block */
+            g = (d[l + 1] - d[l]) / (2 * e[l]);
+            r = hypot(g, 1);
+            g = d[m] - d[l] + e[l] / (g + (g >= 0 ? r : -r));
+            s = c = 1;
+            p = 0;
+
+            for (i = m; i-- > l;) {
+                double f = s * e[i];
+                double b = c * e[i];
+
+                r = hypot(f, g);
+                e[i + 1] = r;
+                if (r == 0) {
+                    d[i + 1] -= p;
+                    e[m] = 0;
+                    underflow = 1;
+                    break;
+                }
+
+                s = f / r;
+                c = g / r;
+                g = d[i + 1] - p;
+                r = (d[i] - g) * s + 2 * c * b;
+                p = s * r;
+                d[i + 1] = g + p;
+                g = c * r - b;
+
+                if (Zt != NULL) {
+                    double *zi = Zt + i * ldz;
+                    double *zn = Zt + (i + 1) * ldz;
+                    for (j = 0; j < n; ++j) {
+                        f = zn[j];
+                        zn[j] = s * zi[j] + c * f;
+                        zi[j] = c * zi[j] - s * f;
+                    }
+                }
+            }
+
+            if (underflow) {
+                continue;
+            }
+
+            d[l] -= p;
+            e[l] = g;
+            e[m] = 0;
+        }
+    }
+
+    /* selection sort, so that each eigenvector moves at most once */
+    for (i = 0; i + 1 < n; ++i) {
+        size_t smallest = i;
+        for (j = i + 1; j < n; ++j) {
+            if (d[j] < d[smallest]) {
+                smallest = j;
+            }
+        }
+        if (smallest != i) {
+            double swap = d[i];
+            d[i] = d[smallest];
+            d[smallest] = swap;
+            if (Zt != NULL) {
+                for (j = 0; j < n; ++j) {
+                    swap = Zt[i * ldz + j];
+                    Zt[i * ldz + j] = Zt[smallest * ldz + j];
+                    Zt[smallest * ldz + j] = swap;
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ *  Quantidade de autovalores da tridiagonal (d, e) menores que x, pela sequência de Sturm.
+ */
+static size_t eigen_sturm_count(size_t n, const double *d, const double *e, double x, double pivmin)
+{
+    double q = d[0] - x;
+    size_t count = q < 0;
+    size_t i;
+
+    for (i = 1; i < n; ++i) {
+        if (fabs(q) < pivmin) {
+            q = -pivmin;
+        }
+        q = d[i] - x - e[i - 1] * e[i - 1] / q;
+        count += q < 0;
+    }
+
+    return count;
+}
+
+/**
+ *  Calcula, por bisseção, os autovalores first .. first + count - 1 (em ordem crescente) da tridiagonal (d, e).
+ *  @param values Recebe os count autovalores, em ordem crescente.
+ */
+static void eigen_tridiagonal_bisect(size_t n, const double *d, const double *e, size_t first, size_t count, double *values)
+{
+    double low = d[0], high = d[0], pivmin = DBL_MIN, tnorm;
+    size_t i;
+
+    /* Gershgorin bounds */
+    for (i = 0; i < n; ++i) {
+        double radius = (i > 0 ? fabs(e[i - 1]) : 0) + (i + 1 < n ? fabs(e[i]) : 0);
+        low = fmin(low, d[i] - radius);
+        high = fmax(high, d[i] + radius);
+        if (i + 1 < n) {
+            pivmin = fmax(pivmin, e[i] * e[i] * DBL_MIN);
+        }
+    }
+    tnorm = fmax(fabs(low), fabs(high));
+    low -= 2 * EPSILON * tnorm * n + pivmin;
+    high += 2 * EPSILON * tnorm * n + pivmin;
+
+    for (i = 0; i < count; ++i) {
+        size_t index = first + i;
+        double lo = i > 0 ? values[i - 1] : low;
+        double hi = high;
+
+        /* invariant: fewer than index + 1 eigenvalues below lo, at least index + 1 below hi */
+        while (hi - lo > 2 * EPSILON * fmax(fabs(lo), fabs(hi)) + pivmin) {
+            double mid = lo + (hi - lo) / 2;
+            if (mid <= lo || mid >= hi) {
+                break;
+            }
+            if (eigen_sturm_count(n, d, e, mid, pivmin) > index) {
+                hi = mid;
+            } else {
+                lo = mid;
+            }
+        }
+
+        values[i] = lo + (hi - lo) / 2;
+    }
+}
+
+/**
+ *  Calcula por iteração inversa os autovetores da tridiagonal (d, e) para os autovalores dados, em ordem
+ *  crescente. Autovetores de autovalores próximos (a menos de 10^-3 ||T||) são reortogonalizados entre si.
+ *  @param Zt Recebe os autovetores nas linhas: count x n, com leading dimension ldz.
+ *  @return 0, ou -1 caso falte memória.
+ */
+static int eigen_tridiagonal_inverse_iteration(size_t n, const double *d, const double *e, size_t count,
+                                               const double *values, double *Zt, size_t ldz)
+{
+    double *dl = (double *) malloc(sizeof(double) * (n + 1));
+    double *dd = (double *) malloc(sizeof(double) * (n + 1));
+    double *du = (double *) malloc(sizeof(double) * (n + 1));
+    double *du2 = (double *) malloc(sizeof(double) * (n + 1));
+    char *swapped = (char *) malloc(n + 1);
+    double tnorm = 0;
+    size_t cluster = 0;
+    size_t i, j, q;
+
+    if (dl == NULL || dd == NULL || du == NULL || du2 == NULL || swapped == NULL) {
+        free(dl);
+        free(dd);
+        free(du);
+        free(du2);
+        free(swapped);
+        return -1;
+    }
+
+    for (i = 0; i < n; ++i) {
+        tnorm = fmax(tnorm, fabs(d[i]) + (i > 0 ? fabs(e[i - 1]) : 0) + (i + 1 < n ? fabs(e[i]) : 0));
+    }
+
+    for (j = 0; j < count; ++j) {
+        double *z = Zt + j * ldz;
+        double lambda = values[j];
+        double tiny = EPSILON * fmax(tnorm, DBL_MIN);
+        unsigned long seed = 0x9e3779b9ul + j;
+        int iteration;
+
+        if (j > 0 && values[j] - values[j - 1] > 1e-3 * tnorm) {
+            cluster = j;
+        }
+
+        /* LU with partial pivoting of T - lambda I, as LAPACK's DGTTRF */
+        for (i = 0; i < n; ++i) {
+            dd[i] = d[i] - lambda;
+            if (i + 1 < n) {
+                dl[i] = e[i];
+                du[i] = e[i];
+            }
+            du2[i] = 0;
+        }
+        for (i = 0; i + 1 < n; ++i) {
+            if (fabs(dd[i]) >= fabs(dl[i])) {
+                swapped[i] = 0;
+                if (dd[i] != 0) {
+                    double fact = dl[i] / dd[i];
+                    dl[i] = fact;
+                    dd[i + 1] -= fact * du[i];
+                }
+            } else {
+                double fact = dd[i] / dl[i];
+                double swap = du[i];
+
+                swapped[i] = 1;
+                dd[i] = dl[i];
+                dl[i] = fact;
+                du[i] = dd[i + 1];
+                dd[i + 1] = swap - fact * dd[i + 1];
+                if (i + 2 < n) {
+                    du2[i] = du[i + 1];
+                    du[i + 1] = -fact * du[i + 1];
+                }
+            }
+        }
+        /* lambda is an eigenvalue to working precision, so a pivot may vanish */
+        for (i = 0; i < n; ++i) {
+            if (fabs(dd[i]) < tiny) {
+                dd[i] = dd[i] < 0 ? -tiny : tiny;
+            }
+        }
+
+        for (i = 0; i < n; ++i) {
+            seed = seed * 1103515245ul + 12345ul;
+            z[i] = (double) ((seed >> 16) & 0x7fff) / 0x7fff - 0.5;
+        }
+
+        for (iteration = 0; iteration < 3; ++iteration) {
+            double norm = 0;
+
+            for (i = 0; i + 1 < n; ++i) {
+                if (swapped[i]) {
+                    double swap = z[i];
+                    z[i] = z[i + 1];
+                    z[i + 1] = swap - dl[i] * z[i];
+                } else {
+                    z[i + 1] -= dl[i] * z[i];
+                }
+            }
+            for (i = n; i-- > 0;) {
+                double sum = z[i];
+                if (i + 1 < n) {
+                    sum -= du[i] * z[i + 1];
+                }
+                if (i + 2 < n) {
+                    sum -= du2[i] * z[i + 2];
+                }
+                z[i] = sum / dd[i];
+            }
+
+            /* modified Gram-Schmidt against the earlier vectors of the cluster */
+            for (q = cluster; q < j; ++q) {
+                const double *y = Zt + q * ldz;
+                double dot = 0;
+                for (i = 0; i < n; ++i) {
+                    dot += y[i] * z[i];
+                }
+                for (i = 0; i < n; ++i) {
+                    z[i] -= dot * y[i];
+                }
+            }
+
+            norm = qr_norm2(n, z, 1);
+            for (i = 0; i < n; ++i) {
+                z[i] /= norm;
+            }
+        }
+    }
+
+    free(dl);
+    free(dd);
+    free(du);
+    free(du2);
+    free(swapped);
+
+    return 0;
+}
+
+/**
+ *  Copia o triângulo superior de A, denso e linha a linha, para os dois triângulos de uma nova matriz.
+ */
+static matrix_t *eigen_symmetric_copy(const matrix_t *A)
+{
+    size_t n = A->rows;
+    matrix_t *S = matrix_new(n, n);
+    size_t i, j;
+
+    if (S == NULL) {
+        return NULL;
+    }
+
+    for (i = 0; i < n; ++i) {
+        for (j = i; j < n; ++j) {
+            double value = matrix_get_at(A, i, j);
+            S->elements[i * n + j] = value;
+            S->elements[j * n + i] = value;
+        }
+    }
+
+    return S;
+}
+
+/**
+ *  Calcula todos os autovalores de A, simétrica, e opcionalmente os autovetores. Só o triângulo superior
+ *  de A é lido.
+ *  @param vectors Caso não seja NULL, recebe a matriz n x n com os autovetores nas colunas, na ordem dos
+ *  autovalores; caso seja NULL, os autovetores não são calculados, o que é bem mais rápido.
+ *  @return Os autovalores em ordem crescente (n x 1), ou NULL caso falte memória ou o QL não convirja.
+ */
+static matrix_t *eigen_symmetric(const matrix_t *A, matrix_t **vectors)
+{
+    size_t n = A->rows;
+    matrix_t *S = eigen_symmetric_copy(A);
+    matrix_t *values = matrix_new(n, 1);
+    matrix_t *Z = NULL;
+    double *e = (double *) malloc(sizeof(double) * (n + 1));
+    double *tau = (double *) malloc(sizeof(double) * (n + 1));
+    double *Zt = vectors != NULL ? (double *) calloc(n * n + 1, sizeof(double)) : NULL;
+    int status = 0;
+    size_t i, j;
+
+    assert(A->rows == A->columns);
+
+    if (S == NULL || values == NULL || e == NULL || tau == NULL || (vectors != NULL && Zt == NULL)) {
+        status = -1;
+    }
+
+    if (status == 0) {
+        if (Zt != NULL) {
+            for (i = 0; i < n; ++i) {
+                Zt[i * n + i] = 1;
+            }
+        }
+
+        status = eigen_tridiagonalize_array(n, S->elements, n, values->elements, e, tau);
+        if (status == 0) {
+            status = eigen_tridiagonal_ql(n, values->elements, e, Zt, n);
+        }
+    }
+
+    if (status == 0 && vectors != NULL) {
+        /* the eigenvectors of T are the rows of Zt; those of A are Q times them, as columns */
+        Z = matrix_new(n, n);
+        status = Z == NULL ? -1 : 0;
+
+        if (status == 0) {
+            for (i = 0; i < n; ++i) {
+                for (j = 0; j < n; ++j) {
+                    Z->elements[i * n + j] = Zt[j * n + i];
+                }
+            }
+            status = eigen_apply_q(n, S->elements, n, tau, Z->elements, n, n);
+        }
+    }
+
+    if (S != NULL) {
+        matrix_free(S);
+    }
+    free(e);
+    free(tau);
+    free(Zt);
+
+    if (status != 0) {
+        if (values != NULL) {
+            matrix_free(values);
+        }
+        if (Z != NULL) {
+            matrix_free(Z);
+        }
+        values = NULL;
+        Z = NULL;
+    }
+
+    if (vectors != NULL) {
+        *vectors = Z;
+    }
+
+    return values;
+}
+
+/**
+ *  Calcula os k maiores autovalores de A, simétrica, e opcionalmente os seus autovetores, sem calcular o
+ *  resto do espectro. Só o triângulo superior de A é lido.
+ *  @param vectors Caso não seja NULL, recebe a matriz n x k com os autovetores nas colunas.
+ *  @return Os autovalores em ordem decrescente (k x 1), ou NULL caso falte memória.
+ */
+static matrix_t *eigen_symmetric_largest(const matrix_t *A, size_t k, matrix_t **vectors)
+{
+    size_t n = A->rows;
+    matrix_t *S = eigen_symmetric_copy(A);
+    matrix_t *values = matrix_new(k, 1);
+    matrix_t *Z = NULL;
+    double *d = (double *) malloc(sizeof(double) * (n + 1));
+    double *e = (double *) malloc(sizeof(double) * (n + 1));
+    double *tau = (double *) malloc(sizeof(double) * (n + 1));
+    double *ascending = (double *) malloc(sizeof(double) * (k + 1));
+    double *Zt = vectors != NULL ? (double *) malloc(sizeof(double) * (k * n + 1)) : NULL;
+    int status = 0;
+    size_t i, j;
+
+    assert(A->rows == A->columns);
+    assert(k > 0 && k <= n);
+
+    if (S == NULL || values == NULL || d == NULL || e == NULL || tau == NULL || ascending == NULL ||
+        (vectors != NULL && Zt == NULL)) {
+        status = -1;
+    }
+
+    if (status == 0) {
+        status = eigen_tridiagonalize_array(n, S->elements, n, d, e, tau);
+    }
+
+    if (status == 0) {
+        eigen_tridiagonal_bisect(n, d, e, n - k, k, ascending);
+        for (i = 0; i < k; ++i) {
+            values->elements[i] = ascending[k - 1 - i];
+        }
+    }
+
+    if (status == 0 && vectors != NULL) {
+        status = eigen_tridiagonal_inverse_iteration(n, d, e, k, ascending, Zt, n);
+
+        if (status == 0) {
+            Z = matrix_new(n, k);
+            status = Z == NULL ? -1 : 0;
+        }
+
+        if (status == 0) {
+            for (i = 0; i < n; ++i) {
+                for (j = 0; j < k; ++j) {
+                    Z->elements[i * k + j] = Zt[(k - 1 - j) * n + i];
+                }
+            }
+            status = eigen_apply_q(n, S->elements, n, tau, Z->elements, k, k);
+        }
+    }
+
+    if (S != NULL) {
+        matrix_free(S);
+    }
+    free(d);
+    free(e);
+    free(tau);
+    free(ascending);
+    free(Zt);
+
+    if (status != 0) {
+        if (values != NULL) {
+            matrix_free(values);
+        }
+        if (Z != NULL) {
+            matrix_free(Z);
+        }
+        values = NULL;
+        Z = NULL;
+    }
+
+    if (vectors != NULL) {
+        *vectors = Z;
+    }
+
+    return values;
+}
+
+#endif
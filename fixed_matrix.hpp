@@ -0,0 +1,481 @@
+/**
+ *  @file
+ */
+/*
+ * Copyright (c) 2018 Victor Hermann "vitorhnn" Chiletto
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+**/
+
+#ifndef FIXED_MATRIX_HPP
+#define FIXED_MATRIX_HPP
+
+/*
+ * Matrices whose dimensions are known at compile time (C++17).
+ *
+ * Storage is inline and row-major, exactly like matrix_t's elements, so a
+ * Matrix<double, R, C> can be viewed as a matrix_t and a matrix_t of the right
+ * size can be viewed through a MatrixRef without copying. Every loop runs over
+ * compile-time index packs, so the kernels are fully unrolled and small-matrix
+ * code compiles down to straight-line, vectorizable arithmetic.
+ */
+
+#include <cmath>
+#include <cstddef>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "matrix.h"
+
+namespace alc {
+
+namespace detail {
+
+template <typename F, std::size_t... I>
+constexpr void unroll(F &&f, std::index_sequence<I...>)
+{
+    (f(std::integral_constant<std::size_t, I>{}), ...);
+}
+
+/**
+ *  Chama f(0), f(1), ..., f(N - 1), com índices constantes em tempo de compilação.
+ */
+template <std::size_t N, typename F>
+constexpr void unroll(F &&f)
+{
+    unroll(std::forward<F>(f), std::make_index_sequence<N>{});
+}
+
+} // namespace detail
+
+template <std::size_t R, std::size_t C>
+struct MatrixRef;
+
+/**
+ *  Matriz R x C de elementos T, guardada inline por linhas.
+ */
+template <typename T, std::size_t R, std::size_t C>
+struct Matrix {
+    static_assert(R > 0 && C > 0, "empty matrices are not supported");
+
+    static constexpr std::size_t rows = R;
+    static constexpr std::size_t columns = C;
+
+    T elements[R * C];
+
+    constexpr T &operator()(std::size_t row, std::size_t column)
+    {
+        return elements[row * C + column];
+    }
+
+    constexpr const T &operator()(std::size_t row, std::size_t column) const
+    {
+        return elements[row * C + column];
+    }
+
+    static constexpr Matrix filled(T value)
+    {
+        Matrix m{};
+        detail::unroll<R * C>([&](auto i) { m.elements[i] = value; });
+        return m;
+    }
+
+    static constexpr Matrix zeros()
+    {
+        return filled(T(0));
+    }
+
+    static constexpr Matrix identity()
+    {
+        Matrix m = zeros();
+        detail::unroll<(R < C ? R : C)>([&](auto i) { m(i, i) = T(1); });
+        return m;
+    }
+
+    /**
+     *  Visão desta matriz como matrix_t, sem cópia. <br>
+     *  A visão aponta para elements; não a libere com matrix_free.
+     */
+    template <typename U = T, typename = std::enable_if_t<std::is_same_v<U, double>>>
+    matrix_t view()
+    {
+        matrix_t m;
+        matrix_wrap_init(&m, elements, R, C, 0, MATRIX_ROW_MAJOR);
+        return m;
+    }
+
+    /**
+     *  Visão dos elementos de um matrix_t R x C, sem cópia. <br>
+     *  A visão não possui os elementos e vale enquanto mat existir.
+     */
+    template <typename U = T, typename = std::enable_if_t<std::is_same_v<U, double>>>
+    static MatrixRef<R, C> map(matrix_t *mat)
+    {
+        assert(mat->rows == R && mat->columns == C && matrix_is_dense(mat));
+        return MatrixRef<R, C>{mat->elements};
+    }
+};
+
+/**
+ *  Visão sem posse de R x C doubles densos por linhas, como os elementos de um matrix_t.
+ */
+template <std::size_t R, std::size_t C>
+struct MatrixRef {
+    static constexpr std::size_t rows = R;
+    static constexpr std::size_t columns = C;
+
+    double *elements;
+
+    double &operator()(std::size_t row, std::size_t column) const
+    {
+        return elements[row * C + column];
+    }
+
+    /**
+     *  Copia os elementos vistos para uma Matrix.
+     */
+    Matrix<double, R, C> load() const
+    {
+        Matrix<double, R, C> m{};
+        detail::unroll<R * C>([&](auto i) { m.elements[i] = elements[i]; });
+        return m;
+    }
+
+    /**
+     *  Sobrescreve os elementos vistos com os de m.
+     */
+    void store(const Matrix<double, R, C> &m) const
+    {
+        detail::unroll<R * C>([&](auto i) { elements[i] = m.elements[i]; });
+    }
+};
+
+template <typename T, std::size_t R, std::size_t C>
+constexpr Matrix<T, R, C> operator+(const Matrix<T, R, C> &a, const Matrix<T, R, C> &b)
+{
+    Matrix<T, R, C> out{};
+    detail::unroll<R * C>([&](auto i) { out.elements[i] = a.elements[i] + b.elements[i]; });
+    return out;
+}
+
+template <typename T, std::size_t R, std::size_t C>
+constexpr Matrix<T, R, C> operator-(const Matrix<T, R, C> &a, const Matrix<T, R, C> &b)
+{
+    Matrix<T, R, C> out{};
+    detail::unroll<R * C>([&](auto i) { out.elements[i] = a.elements[i] - b.elements[i]; });
+    return out;
+}
+
+template <typename T, std::size_t R, std::size_t C>
+constexpr Matrix<T, R, C> operator*(const Matrix<T, R, C> &a, T scalar)
+{
+    Matrix<T, R, C> out{};
+    detail::unroll<R * C>([&](auto i) { out.elements[i] = a.elements[i] * scalar; });
+    return out;
+}
+
+template <typename T, std::size_t R, std::size_t C>
+constexpr Matrix<T, R, C> operator*(T scalar, const Matrix<T, R, C> &a)
+{
+    return a * scalar;
+}
+
+/**
+ *  Produto a * b, com o laço interno sobre as colunas de b para que cada linha do resultado vetorize.
+ */
+template <typename T, std::size_t R, std::size_t K, std::size_t C>
+constexpr Matrix<T, R, C> operator*(const Matrix<T, R, K> &a, const Matrix<T, K, C> &b)
+{
+    Matrix<T, R, C> out = Matrix<T, R, C>::zeros();
+    detail::unroll<R>([&](auto i) {
+        detail::unroll<K>([&](auto k) {
+            const T aik = a(i, k);
+            detail::unroll<C>([&](auto j) { out(i, j) += aik * b(k, j); });
+        });
+    });
+    return out;
+}
+
+template <typename T, std::size_t R, std::size_t C>
+constexpr Matrix<T, C, R> transpose(const Matrix<T, R, C> &a)
+{
+    Matrix<T, C, R> out{};
+    detail::unroll<R>([&](auto i) {
+        detail::unroll<C>([&](auto j) { out(j, i) = a(i, j); });
+    });
+    return out;
+}
+
+/**
+ *  Norma de Frobenius.
+ */
+template <typename T, std::size_t R, std::size_t C>
+T frobenius_norm(const Matrix<T, R, C> &a)
+{
+    T sum = 0;
+    detail::unroll<R * C>([&](auto i) { sum += a.elements[i] * a.elements[i]; });
+    return std::sqrt(sum);
+}
+
+/**
+ *  Norma linha (maior soma absoluta de uma linha).
+ */
+template <typename T, std::size_t R, std::size_t C>
+T row_norm(const Matrix<T, R, C> &a)
+{
+    T norm = 0;
+    detail::unroll<R>([&](auto i) {
+        T sum = 0;
+        detail::unroll<C>([&](auto j) { sum += std::fabs(a(i, j)); });
+        norm = sum > norm ? sum : norm;
+    });
+    return norm;
+}
+
+/**
+ *  Norma coluna (maior soma absoluta de uma coluna), acumulada linha a linha.
+ */
+template <typename T, std::size_t R, std::size_t C>
+T column_norm(const Matrix<T, R, C> &a)
+{
+    T sums[C] = {};
+    T norm = 0;
+    detail::unroll<R>([&](auto i) {
+        detail::unroll<C>([&](auto j) { sums[j] += std::fabs(a(i, j)); });
+    });
+    detail::unroll<C>([&](auto j) { norm = sums[j] > norm ? sums[j] : norm; });
+    return norm;
+}
+
+/**
+ *  Fatoração PA = LU com pivoteamento parcial, compactada como em lu_factor.
+ */
+template <typename T, std::size_t N>
+struct LU {
+    Matrix<T, N, N> factor;
+    std::size_t pivots[N];
+};
+
+/**
+ *  Calcula a fatoração PA = LU de a.
+ *  @return A fatoração, ou vazio caso a seja singular.
+ */
+template <typename T, std::size_t N>
+std::optional<LU<T, N>> lu_factor(const Matrix<T, N, N> &a)
+{
+    LU<T, N> lu{a, {}};
+    bool singular = false;
+
+    detail::unroll<N>([&](auto k) {
+        std::size_t p = k;
+        T biggest = std::fabs(lu.factor(k, k));
+
+        detail::unroll<N - k - 1>([&](auto r) {
+            constexpr std::size_t i = k + 1 + r;
+            if (std::fabs(lu.factor(i, k)) > biggest) {
+                biggest = std::fabs(lu.factor(i, k));
+                p = i;
+            }
+        });
+
+        singular = singular || biggest == 0;
+        lu.pivots[k] = p;
+
+        if (p != k) {
+            detail::unroll<N>([&](auto j) { std::swap(lu.factor(k, j), lu.factor(p, j)); });
+        }
+
+        const T inverse = biggest == 0 ? T(0) : T(1) / lu.factor(k, k);
+
+        detail::unroll<N - k - 1>([&](auto r) {
+            constexpr std::size_t i = k + 1 + r;
+            const T l = lu.factor(i, k) * inverse;
+            lu.factor(i, k) = l;
+            detail::unroll<N - k - 1>([&](auto c) { lu.factor(i, k + 1 + c) -= l * lu.factor(k, k + 1 + c); });
+        });
+    });
+
+    if (singular) {
+        return std::nullopt;
+    }
+
+    return lu;
+}
+
+/**
+ *  Resolve AX = B a partir da fatoração de lu_factor.
+ */
+template <typename T, std::size_t N, std::size_t K>
+Matrix<T, N, K> lu_solve(const LU<T, N> &lu, Matrix<T, N, K> b)
+{
+    detail::unroll<N>([&](auto i) {
+        if (lu.pivots[i] != i) {
+            detail::unroll<K>([&](auto j) { std::swap(b(i, j), b(lu.pivots[i], j)); });
+        }
+    });
+
+    detail::unroll<N>([&](auto i) {
+        detail::unroll<i>([&](auto p) {
+            const T l = lu.factor(i, p);
+            detail::unroll<K>([&](auto j) { b(i, j) -= l * b(p, j); });
+        });
+    });
+
+    detail::unroll<N>([&](auto r) {
+        constexpr std::size_t i = N - 1 - r;
+        detail::unroll<N - i - 1>([&](auto c) {
+            constexpr std::size_t p = i + 1 + c;
+            const T u = lu.factor(i, p);
+            detail::unroll<K>([&](auto j) { b(i, j) -= u * b(p, j); });
+        });
+        const T inverse = T(1) / lu.factor(i, i);
+        detail::unroll<K>([&](auto j) { b(i, j) *= inverse; });
+    });
+
+    return b;
+}
+
+/**
+ *  Resolve AX = B por LU com pivoteamento parcial.
+ *  @return X, ou vazio caso A seja singular.
+ */
+template <typename T, std::size_t N, std::size_t K>
+std::optional<Matrix<T, N, K>> solve(const Matrix<T, N, N> &a, const Matrix<T, N, K> &b)
+{
+    auto lu = lu_factor(a);
+    if (!lu) {
+        return std::nullopt;
+    }
+    return lu_solve(*lu, b);
+}
+
+/**
+ *  Calcula o fator de Cholesky superior R de a (a = R^T R, como cholesky_factor).
+ *  @return R, ou vazio caso a não seja positiva definida.
+ */
+template <typename T, std::size_t N>
+std::optional<Matrix<T, N, N>> cholesky_factor(const Matrix<T, N, N> &a)
+{
+    Matrix<T, N, N> r = Matrix<T, N, N>::zeros();
+    bool definite = true;
+
+    detail::unroll<N>([&](auto i) {
+        T d = a(i, i);
+        detail::unroll<i>([&](auto k) { d -= r(k, i) * r(k, i); });
+
+        definite = definite && d > 0;
+        const T root = d > 0 ? std::sqrt(d) : T(1);
+        const T inverse = T(1) / root;
+        r(i, i) = root;
+
+        detail::unroll<N - i - 1>([&](auto c) {
+            constexpr std::size_t j = i + 1 + c;
+            T v = a(i, j);
+            detail::unroll<i>([&](auto k) { v -= r(k, i) * r(k, j); });
+            r(i, j) = v * inverse;
+        });
+    });
+
+    if (!definite) {
+        return std::nullopt;
+    }
+
+    return r;
+}
+
+/**
+ *  Resolve AX = B por fatoração de Cholesky.
+ *  @return X, ou vazio caso A não seja positiva definida.
+ */
+template <typename T, std::size_t N, std::size_t K>
+std::optional<Matrix<T, N, K>> cholesky_solve(const Matrix<T, N, N> &a, Matrix<T, N, K> b)
+{
+    auto factor = cholesky_factor(a);
+    if (!factor) {
+        return std::nullopt;
+    }
+    const Matrix<T, N, N> &r = *factor;
+
+    /* R^T y = b */
+    detail::unroll<N>([&](auto i) {
+        detail::unroll<i>([&](auto k) {
+            const T v = r(k, i);
+            detail::unroll<K>([&](auto j) { b(i, j) -= v * b(k, j); });
+        });
+        const T inverse = T(1) / r(i, i);
+        detail::unroll<K>([&](auto j) { b(i, j) *= inverse; });
+    });
+
+    /* R x = y */
+    detail::unroll<N>([&](auto s) {
+        constexpr std::size_t i = N - 1 - s;
+        detail::unroll<N - i - 1>([&](auto c) {
+            constexpr std::size_t k = i + 1 + c;
+            const T v = r(i, k);
+            detail::unroll<K>([&](auto j) { b(i, j) -= v * b(k, j); });
+        });
+        const T inverse = T(1) / r(i, i);
+        detail::unroll<K>([&](auto j) { b(i, j) *= inverse; });
+    });
+
+    return b;
+}
+
+/**
+ *  Calcula a inversa de a; ordens 2 e 3 usam fórmulas fechadas, as demais LU.
+ *  @return A inversa, ou vazio caso a seja singular.
+ */
+template <typename T, std::size_t N>
+std::optional<Matrix<T, N, N>> inverse(const Matrix<T, N, N> &a)
+{
+    if constexpr (N == 1) {
+        if (a(0, 0) == 0) {
+            return std::nullopt;
+        }
+        return Matrix<T, 1, 1>{{T(1) / a(0, 0)}};
+    } else if constexpr (N == 2) {
+        const T det = a(0, 0) * a(1, 1) - a(0, 1) * a(1, 0);
+        if (det == 0) {
+            return std::nullopt;
+        }
+        const T r = T(1) / det;
+        return Matrix<T, 2, 2>{{a(1, 1) * r, -a(0, 1) * r, -a(1, 0) * r, a(0, 0) * r}};
+    } else if constexpr (N == 3) {
+        const T c00 = a(1, 1) * a(2, 2) - a(1, 2) * a(2, 1);
+        const T c01 = a(1, 2) * a(2, 0) - a(1, 0) * a(2, 2);
+        const T c02 = a(1, 0) * a(2, 1) - a(1, 1) * a(2, 0);
+        const T det = a(0, 0) * c00 + a(0, 1) * c01 + a(0, 2) * c02;
+        if (det == 0) {
+            return std::nullopt;
+        }
+        const T r = T(1) / det;
+        return Matrix<T, 3, 3>{{
+            c00 * r, (a(0, 2) * a(2, 1) - a(0, 1) * a(2, 2)) * r, (a(0, 1) * a(1, 2) - a(0, 2) * a(1, 1)) * r,
+            c01 * r, (a(0, 0) * a(2, 2) - a(0, 2) * a(2, 0)) * r, (a(0, 2) * a(1, 0) - a(0, 0) * a(1, 2)) * r,
+            c02 * r, (a(0, 1) * a(2, 0) - a(0, 0) * a(2, 1)) * r, (a(0, 0) * a(1, 1) - a(0, 1) * a(1, 0)) * r,
+        }};
+    } else {
+        return solve(a, Matrix<T, N, N>::identity());
+    }
+}
+
+} // namespace alc
+
+#endif
@@ -29,11 +29,68 @@
 
 #include "matrix.h"
 #include "matrix_norms.h"
+#include "workspace.h"
 
-static size_t __g_iterations;
+#include <time.h>
+
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define ITERATIVE_THREAD_LOCAL _Thread_local
+#elif defined(__GNUC__)
+#define ITERATIVE_THREAD_LOCAL __thread
+#else
+#define ITERATIVE_THREAD_LOCAL
+#endif
+
+struct solver_context;
+
+/**
+ *  Callback chamado ao fim de cada iteração de um método iterativo.
+ *  @param ctx O contexto do método, com iterations, residual e flops atualizados.
+ *  @param x A aproximação atual.
+ *  @return 0 para continuar, qualquer outro valor para interromper o método.
+ */
+typedef int (*solver_callback_t)(const struct solver_context *ctx, const matrix_t *x, void *userdata);
+
+/**
+ *  Contexto de uma chamada a um método iterativo. <br>
+ *  Cada chamada usa o seu próprio contexto, então vários sistemas podem ser resolvidos em paralelo.
+ *  Inicialize com solver_context_init e preencha os campos de entrada desejados.
+ */
+typedef struct solver_context {
+    /** Entrada: limite de iterações, 0 para nenhum limite. **/
+    size_t max_iterations;
+    /** Entrada: buffer opcional que recebe a maior variação de x em cada iteração. **/
+    double *history;
+    /** Entrada: quantidade de elementos de history. **/
+    size_t history_capacity;
+    /** Entrada: callback opcional chamado a cada iteração. **/
+    solver_callback_t callback;
+    /** Entrada: repassado ao callback. **/
+    void *userdata;
+    /** Entrada: workspace opcional de onde saem os temporários, veja iterative_workspace_size. **/
+    workspace_t *workspace;
+
+    /** Saída: iterações executadas. **/
+    size_t iterations;
+    /** Saída: quantidade de elementos escritos em history. **/
+    size_t history_length;
+    /** Saída: maior variação de x na última iteração. **/
+    double delta;
+    /** Saída: norma infinito de b - Ax ao fim do método. **/
+    double residual;
+    /** Saída: tempo decorrido, em segundos. **/
+    double elapsed;
+    /** Saída: estimativa de operações de ponto flutuante executadas. **/
+    double flops;
+    /** Saída: 1 se o critério de parada foi atingido, 0 se o método foi interrompido. **/
+    int converged;
+} solver_context_t;
+
+static ITERATIVE_THREAD_LOCAL size_t __g_iterations;
 
 /**
- *  Informa a quantidade de iterações usadas no último método iterativo chamado.
+ *  Informa a quantidade de iterações usadas no último método iterativo chamado pela thread atual.
+ *  \deprecated Use as variantes _ctx dos métodos e leia solver_context_t::iterations.
  *  @return As iterações
  */
 static size_t get_iterations(void)
@@ -41,6 +98,84 @@ static size_t get_iterations(void)
     return __g_iterations;
 }
 
+/**
+ *  Inicializa um contexto sem limite de iterações, histórico ou callback.
+ */
+static void solver_context_init(solver_context_t *ctx)
+{
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+static double solver_clock(void)
+{
+#ifdef CLOCK_MONOTONIC
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#else
+    return (double) clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+static void solver_begin(solver_context_t *ctx)
+{
+    ctx->iterations = 0;
+    ctx->history_length = 0;
+    ctx->delta = 0;
+    ctx->residual = 0;
+    ctx->flops = 0;
+    ctx->converged = 0;
+    ctx->elapsed = solver_clock();
+}
+
+/**
+ *  Registra uma iteração no contexto.
+ *  @return 1 se o método deve continuar, 0 se deve ser interrompido.
+ */
+static int solver_step(solver_context_t *ctx, const matrix_t *x, double delta, double flops)
+{
+    ctx->iterations++;
+    ctx->delta = delta;
+    ctx->flops += flops;
+
+    if (ctx->history != NULL && ctx->history_length < ctx->history_capacity) {
+        ctx->history[ctx->history_length++] = delta;
+    }
+
+    if (ctx->callback != NULL && ctx->callback(ctx, x, ctx->userdata) != 0) {
+        return 0;
+    }
+
+    if (ctx->max_iterations != 0 && ctx->iterations >= ctx->max_iterations) {
+        return 0;
+    }
+
+    return 1;
+}
+
+static void solver_end(solver_context_t *ctx, const matrix_t * ALC_RESTRICT A, const matrix_t * ALC_RESTRICT b,
+                       const matrix_t * ALC_RESTRICT x, int converged)
+{
+    double residual = 0;
+    size_t i;
+
+    for (i = 0; i < A->rows; ++i) {
+        double r = matrix_get_at(b, i, 0);
+        size_t j;
+        for (j = 0; j < A->columns; ++j) {
+            r -= matrix_get_at(A, i, j) * matrix_get_at(x, j, 0);
+        }
+        if (fabs(r) > residual) {
+            residual = fabs(r);
+        }
+    }
+
+    ctx->residual = residual;
+    ctx->flops += 2.0 * A->rows * A->columns;
+    ctx->converged = converged;
+    ctx->elapsed = solver_clock() - ctx->elapsed;
+}
+
 /**
  *  Confere o critério das linhas em mat
  *  @author Andrei Parente
@@ -182,25 +317,53 @@ static int convergence_check_all(const matrix_t *mat)
     return 0;
 }
 
+/**
+ *  Bytes de workspace com que os métodos iterativos não alocam temporários para um sistema de ordem n.
+ */
+static size_t iterative_workspace_size(size_t n)
+{
+    size_t jacobi = workspace_matrix_bytes(n, 1);
+    size_t power = 2 * workspace_bytes(sizeof(double) * n);
+
+    return jacobi > power ? jacobi : power;
+}
+
 /**
  *  Resolve o sistema Ax = b pelo método iterativo de Jacobi.
+ *  @param ctx Contexto da chamada, pode ser NULL.
  *  @return O vetor x.
  *  @author Andrei Parente
  */
-static matrix_t *jacobi_solve(const matrix_t * restrict A, const matrix_t * restrict b, double absolute_error)
+static matrix_t *jacobi_solve_ctx(const matrix_t * ALC_RESTRICT A, const matrix_t * ALC_RESTRICT b, double absolute_error,
+                                  solver_context_t *ctx)
 {
-    matrix_t *x1 = matrix_new(b->rows, 1);
+    solver_context_t local;
+    matrix_t *result = matrix_new(b->rows, 1);
+    matrix_t *x1 = result;
+    matrix_t *x0;
+    size_t mark;
+    int running = 1;
+    size_t flag = 0;
 
-    size_t i;
-    for (i = 0; i < x1->rows; ++i) {
-        matrix_set_at(x1, i, 0, 0);
+    if (ctx == NULL) {
+        solver_context_init(&local);
+        ctx = &local;
     }
 
-    size_t flag = 0;
-    __g_iterations = 0;
-    while (flag != x1->rows) {
-        __g_iterations++;
-        matrix_t *x0 = matrix_copy(x1);
+    solver_begin(ctx);
+
+    mark = workspace_mark(ctx->workspace);
+    x0 = workspace_matrix(ctx->workspace, b->rows, 1);
+
+    memset(x1->elements, 0, sizeof(double) * x1->rows);
+
+    while (flag != x1->rows && running) {
+        matrix_t *swap = x0;
+        double delta = 0;
+        size_t i;
+
+        x0 = x1;
+        x1 = swap;
         flag = 0;
 
         for (i = 0; i < A->rows; ++i) {
@@ -219,65 +382,366 @@ static matrix_t *jacobi_solve(const matrix_t * restrict A, const matrix_t * rest
             if (fabs(matrix_get_at(x1, i, 0) - matrix_get_at(x0, i, 0)) < absolute_error) {
                 flag++;
             }
+
+            if (fabs(matrix_get_at(x1, i, 0) - matrix_get_at(x0, i, 0)) > delta) {
+                delta = fabs(matrix_get_at(x1, i, 0) - matrix_get_at(x0, i, 0));
+            }
         }
-        matrix_free(x0); 
+
+        running = solver_step(ctx, x1, delta, 2.0 * A->rows * A->columns);
+    }
+
+    /* the iterates take turns in the two buffers; the answer must end up in the one the caller owns */
+    if (x1 != result) {
+        memcpy(result->elements, x1->elements, sizeof(double) * result->rows);
+        x0 = x1;
     }
 
-    return x1;
+    workspace_matrix_free(ctx->workspace, x0);
+    workspace_release(ctx->workspace, mark);
+    solver_end(ctx, A, b, result, flag == result->rows);
+
+    return result;
 }
 
 /**
- *  Resolve o sistema Ax = b pelo método iterativo de Sobre-Relaxação Sucessiva.
+ *  Resolve o sistema Ax = b pelo método iterativo de Jacobi.
  *  @return O vetor x.
+ *  @author Andrei Parente
  */
-static matrix_t *sor_solve(const matrix_t * restrict A, const matrix_t * restrict b, double w, double absolute_error)
+static matrix_t *jacobi_solve(const matrix_t * ALC_RESTRICT A, const matrix_t * ALC_RESTRICT b, double absolute_error)
 {
-    matrix_t *x = matrix_new(b->rows, 1);
-    size_t done = 0;
+    solver_context_t ctx;
+    matrix_t *x;
 
-    __g_iterations = 0;
+    solver_context_init(&ctx);
+    x = jacobi_solve_ctx(A, b, absolute_error, &ctx);
+    __g_iterations = ctx.iterations;
 
-    memset(x->elements, 0, sizeof(double) * x->rows);
+    return x;
+}
 
-    while (done != x->rows) {
-        __g_iterations++;
-        done = 0;
-        matrix_t *prevx = matrix_copy(x);
-        size_t i;
-        for (i = 0; i < x->rows; ++i) {
-            double xhat = matrix_get_at(b, i, 0);
-            double delta;
-            size_t j;
+/**
+ *  Valor de w que faz sor_solve estimar o fator de relaxação ótimo.
+ */
+#define SOR_AUTO_OMEGA 0.0
+
+/**
+ *  Quantidade de iterações de potência usadas para estimar o raio espectral de Jacobi.
+ */
+#ifndef SOR_POWER_SWEEPS
+#define SOR_POWER_SWEEPS 16
+#endif
+
+/**
+ *  Intervalo, em iterações, entre as reavaliações de w no modo adaptativo.
+ */
+#ifndef SOR_ADAPT_INTERVAL
+#define SOR_ADAPT_INTERVAL 8
+#endif
+
+/**
+ *  Aplica uma varredura de Sobre-Relaxação Sucessiva em x.
+ *  @param done Recebe a quantidade de componentes que variaram menos que absolute_error.
+ *  @return A maior variação absoluta entre as componentes de x.
+ */
+static double sor_sweep(const matrix_t * ALC_RESTRICT A, const matrix_t * ALC_RESTRICT b, matrix_t * ALC_RESTRICT x,
+                        double w, double absolute_error, size_t *done)
+{
+    double biggest = 0;
+    size_t i;
+
+    *done = 0;
+
+    for (i = 0; i < x->rows; ++i) {
+        double xhat = matrix_get_at(b, i, 0);
+        double delta;
+        size_t j;
+
+        for (j = 0; j < x->rows; ++j) {
+            if (i != j) {
+                xhat -= matrix_get_at(A, i, j) * matrix_get_at(x, j, 0);
+            }
+        }
+
+        xhat /= matrix_get_at(A, i, i);
+        delta = w * (xhat - matrix_get_at(x, i, 0));
+
+        matrix_set_at(x, i, 0, matrix_get_at(x, i, 0) + delta);
+
+        if (fabs(delta) < absolute_error) {
+            (*done)++;
+        }
+
+        if (fabs(delta) > biggest) {
+            biggest = fabs(delta);
+        }
+    }
+
+    return biggest;
+}
+
+/**
+ *  Estima o raio espectral da matriz de iteração de Jacobi, I - D^-1 A, por iteração de potência.
+ *  Como os autovalores dominantes costumam vir em pares ±rho, a razão é medida a cada duas aplicações.
+ *  @param sweeps Quantidade de aplicações da matriz de iteração.
+ *  @param ws Workspace de 2n doubles, ou NULL.
+ *  @return A estimativa do raio espectral.
+ */
+static double jacobi_spectral_radius_ws(const matrix_t *A, size_t sweeps, workspace_t *ws)
+{
+    size_t n = A->rows;
+    size_t mark = workspace_mark(ws);
+    double *v = (double *) workspace_alloc(ws, sizeof(double) * n);
+    double *next = (double *) workspace_alloc(ws, sizeof(double) * n);
+    double rho = 0;
+    double product = 1;
+    double norm = 0;
+    size_t i, k;
+
+    assert(A->rows == A->columns);
+
+    /* a non-constant start vector, so that it is unlikely to be orthogonal to the dominant eigenvector */
+    for (i = 0; i < n; ++i) {
+        v[i] = 1.0 + (double) (i % 7) / 7.0;
+        norm += v[i] * v[i];
+    }
+    norm = sqrt(norm);
+
+    for (i = 0; i < n; ++i) {
+        v[i] /= norm;
+    }
+
+    for (k = 0; k < sweeps || k < 2; ++k) {
+        double *swap;
 
-            for (j = 0; j < x->rows; ++j) {
+        norm = 0;
+        for (i = 0; i < n; ++i) {
+            double sum = 0;
+            size_t j;
+            for (j = 0; j < n; ++j) {
                 if (i != j) {
-                    xhat -= matrix_get_at(A, i, j) * matrix_get_at(x, j, 0);
+                    sum -= matrix_get_at(A, i, j) * v[j];
                 }
             }
+            next[i] = sum / matrix_get_at(A, i, i);
+            norm += next[i] * next[i];
+        }
+        norm = sqrt(norm);
+
+        swap = v;
+        v = next;
+        next = swap;
+
+        if (norm == 0) {
+            rho = 0;
+            break;
+        }
+
+        /* v is kept normalized, so every pair of steps gives ||B^2 v|| */
+        product *= norm;
+        if (k % 2 == 1) {
+            rho = sqrt(product);
+            product = 1;
+        }
+
+        for (i = 0; i < n; ++i) {
+            v[i] /= norm;
+        }
+    }
+
+    workspace_dealloc(ws, v);
+    workspace_dealloc(ws, next);
+    workspace_release(ws, mark);
+
+    return rho;
+}
+
+/**
+ *  Estima o raio espectral da matriz de iteração de Jacobi, I - D^-1 A, por iteração de potência.
+ *  @see jacobi_spectral_radius_ws
+ */
+static double jacobi_spectral_radius(const matrix_t *A, size_t sweeps)
+{
+    return jacobi_spectral_radius_ws(A, sweeps, NULL);
+}
+
+/**
+ *  Calcula o fator de relaxação ótimo de Young a partir do raio espectral de Jacobi.
+ *  @return w ótimo, ou 1 (Gauss-Seidel) caso Jacobi não convirja.
+ */
+static double sor_optimal_omega(double rho)
+{
+    if (rho >= 1) {
+        return 1;
+    }
+
+    return 2 / (1 + sqrt(1 - rho * rho));
+}
+
+/**
+ *  Estima o fator de relaxação ótimo de A para o método de Sobre-Relaxação Sucessiva.
+ *  @param sweeps Quantidade de iterações de potência usadas na estimativa.
+ */
+static double sor_estimate_omega(const matrix_t *A, size_t sweeps)
+{
+    return sor_optimal_omega(jacobi_spectral_radius(A, sweeps));
+}
+
+/**
+ *  Resolve o sistema Ax = b pelo método de Sobre-Relaxação Sucessiva, estimando w automaticamente. <br>
+ *  O w inicial vem de uma estimativa por iteração de potência do raio espectral de Jacobi. Durante a
+ *  execução, a taxa de convergência observada é comparada à esperada (w - 1) e, se ela for pior,
+ *  o raio espectral é reestimado pela relação de Young e w é corrigido.
+ *  @param ctx Contexto da chamada, pode ser NULL.
+ *  @return O vetor x.
+ */
+static matrix_t *sor_auto_solve_ctx(const matrix_t * ALC_RESTRICT A, const matrix_t * ALC_RESTRICT b, double absolute_error,
+                                    solver_context_t *ctx)
+{
+    solver_context_t local;
+    matrix_t *x = matrix_new(b->rows, 1);
+    double rho, w;
+    double last_delta = 0;
+    size_t done = 0;
+    size_t since_adapt = 0;
+    int running = 1;
+
+    if (ctx == NULL) {
+        solver_context_init(&local);
+        ctx = &local;
+    }
+
+    solver_begin(ctx);
+
+    rho = jacobi_spectral_radius_ws(A, SOR_POWER_SWEEPS, ctx->workspace);
+    w = sor_optimal_omega(rho);
+    ctx->flops += 2.0 * A->rows * A->columns * (SOR_POWER_SWEEPS < 2 ? 2 : SOR_POWER_SWEEPS);
+
+    memset(x->elements, 0, sizeof(double) * x->rows);
+
+    while (done != x->rows && running) {
+        double delta = sor_sweep(A, b, x, w, absolute_error, &done);
 
-            xhat /= matrix_get_at(A, i, i);
-            delta = xhat - matrix_get_at(x, i, 0);
+        if (since_adapt == 0) {
+            last_delta = delta;
+        }
+
+        if (++since_adapt > SOR_ADAPT_INTERVAL && last_delta > 0 && delta > 0 && rho < 1) {
+            double rate = pow(delta / last_delta, 1.0 / (since_adapt - 1));
 
-            matrix_set_at(x, i, 0, matrix_get_at(x, i, 0) + w * delta);
+            since_adapt = 0;
 
-            if (fabs(matrix_get_at(x, i, 0) - matrix_get_at(prevx, i, 0)) < absolute_error) {
-                done++;
+            /* the asymptotic rate at the optimum is w - 1; a slower rate means rho was underestimated */
+            if (rate < 1 && rate > (w - 1) * 1.05) {
+                double estimate = (rate + w - 1) / (w * sqrt(rate));
+
+                if (estimate > rho) {
+                    rho = estimate < 1 ? estimate : rho;
+                    w = sor_optimal_omega(rho);
+                }
             }
         }
-        
 
-        matrix_free(prevx);
+        running = solver_step(ctx, x, delta, 2.0 * A->rows * A->columns);
     }
 
+    solver_end(ctx, A, b, x, done == x->rows);
+
+    return x;
+}
+
+/**
+ *  Resolve o sistema Ax = b pelo método de Sobre-Relaxação Sucessiva, estimando w automaticamente.
+ *  @see sor_auto_solve_ctx
+ *  @return O vetor x.
+ */
+static matrix_t *sor_auto_solve(const matrix_t * ALC_RESTRICT A, const matrix_t * ALC_RESTRICT b, double absolute_error)
+{
+    solver_context_t ctx;
+    matrix_t *x;
+
+    solver_context_init(&ctx);
+    x = sor_auto_solve_ctx(A, b, absolute_error, &ctx);
+    __g_iterations = ctx.iterations;
+
     return x;
 }
 
+/**
+ *  Resolve o sistema Ax = b pelo método iterativo de Sobre-Relaxação Sucessiva.
+ *  @param w O fator de relaxação, ou SOR_AUTO_OMEGA para estimá-lo com sor_auto_solve_ctx.
+ *  @param ctx Contexto da chamada, pode ser NULL.
+ *  @return O vetor x.
+ */
+static matrix_t *sor_solve_ctx(const matrix_t * ALC_RESTRICT A, const matrix_t * ALC_RESTRICT b, double w, double absolute_error,
+                               solver_context_t *ctx)
+{
+    solver_context_t local;
+    matrix_t *x;
+    size_t done = 0;
+    int running = 1;
+
+    if (w == SOR_AUTO_OMEGA) {
+        return sor_auto_solve_ctx(A, b, absolute_error, ctx);
+    }
+
+    if (ctx == NULL) {
+        solver_context_init(&local);
+        ctx = &local;
+    }
+
+    solver_begin(ctx);
+
+    x = matrix_new(b->rows, 1);
+
+    memset(x->elements, 0, sizeof(double) * x->rows);
+
+    while (done != x->rows && running) {
+        double delta = sor_sweep(A, b, x, w, absolute_error, &done);
+        running = solver_step(ctx, x, delta, 2.0 * A->rows * A->columns);
+    }
+
+    solver_end(ctx, A, b, x, done == x->rows);
+
+    return x;
+}
+
+/**
+ *  Resolve o sistema Ax = b pelo método iterativo de Sobre-Relaxação Sucessiva.
+ *  @param w O fator de relaxação, ou SOR_AUTO_OMEGA para estimá-lo com sor_auto_solve.
+ *  @return O vetor x.
+ */
+static matrix_t *sor_solve(const matrix_t * ALC_RESTRICT A, const matrix_t * ALC_RESTRICT b, double w, double absolute_error)
+{
+    solver_context_t ctx;
+    matrix_t *x;
+
+    solver_context_init(&ctx);
+    x = sor_solve_ctx(A, b, w, absolute_error, &ctx);
+    __g_iterations = ctx.iterations;
+
+    return x;
+}
+
+/**
+ *  Resolve o sistema Ax = b pelo método iterativo de Gauss-Seidel.
+ *  @param ctx Contexto da chamada, pode ser NULL.
+ *  @return O vetor x.
+ *  @author Márcio Medeiros
+ */
+static matrix_t *gauss_seidel_solve_ctx(const matrix_t * ALC_RESTRICT A, const matrix_t * ALC_RESTRICT b, double absolute_error,
+                                        solver_context_t *ctx)
+{
+    return sor_solve_ctx(A, b, 1, absolute_error, ctx);
+}
+
 /**
  *  Resolve o sistema Ax = b pelo método iterativo de Gauss-Seidel.
  *  @return O vetor x.
  *  @author Márcio Medeiros
  */
-static matrix_t *gauss_seidel_solve(const matrix_t * restrict A, const matrix_t * restrict b, double absolute_error)
+static matrix_t *gauss_seidel_solve(const matrix_t * ALC_RESTRICT A, const matrix_t * ALC_RESTRICT b, double absolute_error)
 {
     return sor_solve(A, b, 1, absolute_error);
 }
@@ -0,0 +1,974 @@
+/**
+ *  @file
+ */
+/*
+ * Copyright (c) 2018 Victor Hermann "vitorhnn" Chiletto
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+**/
+
+#ifndef KRYLOV_H
+#define KRYLOV_H
+
+/*
+ * A few eigenpairs of a large operator, from a Krylov subspace of small
+ * dimension m: only y = A x is needed, and memory is O(nm).
+ *
+ * The basis V (m vectors of n elements, one per row) grows by Arnoldi steps,
+ * A V = V H + f e_m^T, orthogonalized by classical Gram-Schmidt applied twice
+ * (DGKS) with gemv. The eigenpairs of the small H give the Ritz pairs, and
+ * ||f|| |e_m^T y| is the residual of each one.
+ *
+ * Until the wanted pairs converge, the method restarts from the subspace
+ * spanned by them and some of the next best ones: W, an orthonormal basis of
+ * that invariant subspace of H, turns the factorization into
+ * A (V W) = (V W) (W^T H W) + f e_m^T W, which then grows again. This is the
+ * thick restart of Wu and Simon for Lanczos and Stewart's Krylov-Schur for
+ * Arnoldi, and is equivalent to ARPACK's implicit restart with exact shifts,
+ * without applying the shifts one at a time.
+ *
+ * For symmetric operators (Lanczos) H is symmetric and its eigenpairs come
+ * from eigen_symmetric. For general ones (Arnoldi) H is reduced to Hessenberg
+ * form and goes through the double-shift QR of EISPACK's HQR2.
+ */
+
+#include "matrix.h"
+#include "blas.h"
+#include "qr.h"
+#include "eigen.h"
+#include "operator.h"
+
+/**
+ *  Limite padrão de reinícios.
+ */
+#ifndef KRYLOV_MAX_RESTARTS
+#define KRYLOV_MAX_RESTARTS 1000
+#endif
+
+/**
+ *  Quais autovalores são procurados.
+ */
+typedef enum {
+    /** Os de maior módulo. **/
+    KRYLOV_LARGEST_MAGNITUDE = 0,
+    /** Os de maior parte real (os maiores, para operadores simétricos). **/
+    KRYLOV_LARGEST_REAL = 1,
+    /** Os de menor parte real (os menores, para operadores simétricos). **/
+    KRYLOV_SMALLEST_REAL = 2
+} krylov_which_t;
+
+/**
+ *  Contexto de uma chamada a lanczos_eigen_ctx ou arnoldi_eigen_ctx. <br>
+ *  Inicialize com krylov_context_init e preencha os campos de entrada desejados.
+ */
+typedef struct {
+    /** Entrada: dimensão m do subespaço, 0 para min(n, max(2k + 1, 20)). **/
+    size_t subspace;
+    /** Entrada: resíduo relativo aceito para cada par de Ritz, 0 para EPSILON. **/
+    double tolerance;
+    /** Entrada: limite de reinícios, 0 para KRYLOV_MAX_RESTARTS. **/
+    size_t max_restarts;
+    /** Entrada: vetor inicial opcional, com n posições. **/
+    const double *start;
+
+    /** Saída: reinícios executados. **/
+    size_t restarts;
+    /** Saída: aplicações do operador. **/
+    size_t products;
+    /** Saída: quantos dos pares pedidos convergiram. **/
+    size_t converged;
+} krylov_context_t;
+
+/**
+ *  Inicializa ctx com os valores padrão.
+ */
+static void krylov_context_init(krylov_context_t *ctx)
+{
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+/**
+ *  Reduz h[0:m, 0:m] à forma de Hessenberg por refletores, acumulando-os em z: H = Z^T H Z.
+ *  @param v Espaço para m elementos.
+ */
+static void krylov_hessenberg(size_t m, double *h, size_t ldh, double *z, size_t ldz, double *v)
+{
+    size_t j, r, c;
+
+    for (j = 0; j + 2 < m; ++j) {
+        double tau;
+
+        v[0] = h[(j + 1) * ldh + j];
+        for (r = j + 2; r < m; ++r) {
+            v[r - j - 1] = h[r * ldh + j];
+        }
+
+        tau = qr_householder(m - j - 2, v, v + 1, 1);
+        if (tau == 0) {
+            continue;
+        }
+
+        h[(j + 1) * ldh + j] = v[0];
+        for (r = j + 2; r < m; ++r) {
+            h[r * ldh + j] = 0;
+        }
+        v[0] = 1;
+
+        /* H = P H P and Z = Z P, P = I - tau v v^T acting on indices j + 1 .. m - 1 */
+        for (c = j + 1; c < m; ++c) {
+            double sum = 0;
+            for (r = j + 1; r < m; ++r) {
+                sum += v[r - j - 1] * h[r * ldh + c];
+            }
+            sum *= tau;
+            for (r = j + 1; r < m; ++r) {
+                h[r * ldh + c] -= sum * v[r - j - 1];
+            }
+        }
+        for (r = 0; r < m; ++r) {
+            double *hr = h + r * ldh;
+            double *zr = z + r * ldz;
+            double hsum = 0, zsum = 0;
+            for (c = j + 1; c < m; ++c) {
+                hsum += hr[c] * v[c - j - 1];
+                zsum += zr[c] * v[c - j - 1];
+            }
+            hsum *= tau;
+            zsum *= tau;
+            for (c = j + 1; c < m; ++c) {
+                hr[c] -= hsum * v[c - j - 1];
+                zr[c] -= zsum * v[c - j - 1];
+            }
+        }
+    }
+}
+
+/**
+ *  Calcula (xr + i xi) / (yr + i yi) sem overflow intermediário.
+ */
+static void krylov_complex_divide(double xr, double xi, double yr, double yi, double *real, double *imaginary)
+{
+    double r, d;
+
+    if (fabs(yr) > fabs(yi)) {
+        r = yi / yr;
+        d = yr + r * yi;
+        *real = (xr + r * xi) / d;
+        *imaginary = (xi - r * xr) / d;
+    } else {
+        r = yr / yi;
+        d = yi + r * yr;
+        *real = (r * xr + xi) / d;
+        *imaginary = (r * xi - xr) / d;
+    }
+}
+
+/**
+ *  Calcula autovalores e autovetores da Hessenberg superior h[0:size, 0:size], destruindo h, pelo QR de duplo
+ *  deslocamento da HQR2 do EISPACK.
+ *  @param wr Recebe as partes reais dos autovalores.
+ *  @param wi Recebe as partes imaginárias; um par conjugado fica em posições consecutivas, a positiva primeiro.
+ *  @param z Entra com a matriz que levou à forma de Hessenberg (ou a identidade) e recebe os autovetores nas
+ *  colunas, sem normalizar: para um par em j e j + 1, o autovetor de wr[j] + i wi[j] é z[:, j] + i z[:, j + 1].
+ *  @return 0, ou -1 caso o QR não convirja.
+ */
+static int krylov_hessenberg_eigen(size_t size, double *h, size_t ldh, double *wr, double *wi, double *z, size_t ldz)
+{
+    /* signed indices, as in the original: l, m and n walk down past each other */
+    long nn = (long) size;
+    long n = nn - 1;
+    long i, j, k, l, m;
+    long iterations = 0, total = 0;
+    double exshift = 0, norm = 0;
+    double p = 0, q = 0, r = 0, s = 0, t, w, x, y, zz = 0;
+
+    for (i = 0; i < nn; ++i) {
+        for (j = i > 0 ? i - 1 : 0; j < nn; ++j) {
+            norm += fabs(h[i * ldh + j]);
+        }
+    }
+
+    while (n >= 0) {
+        /* look for a single small subdiagonal element */
+        l = n;
+        while (l > 0) {
+            s = fabs(h[(l - 1) * ldh + l - 1]) + fabs(h[l * ldh + l]);
+            if (s == 0) {
+                s = norm;
+            }
+            if (fabs(h[l * ldh + l - 1]) < EPSILON * s) {
+                break;
+            }
+            l--;
+        }
+
+        if (l == n) {
+            /* one root */
+            h[n * ldh + n] += exshift;
+            wr[n] = h[n * ldh + n];
+            wi[n] = 0;
+            n--;
+            iterations = 0;
+        } else if (l == n - 1) {
+            /* two roots */
+            w = h[n * ldh + n - 1] * h[(n - 1) * ldh + n];
+            p = (h[(n - 1) * ldh + n - 1] - h[n * ldh + n]) / 2;
+            q = p * p + w;
+            zz = sqrt(fabs(q));
+            h[n * ldh + n] += exshift;
+            h[(n - 1) * ldh + n - 1] += exshift;
+            x = h[n * ldh + n];
+
+            if (q >= 0) {
+                /* a real pair: split it with a rotation */
+                zz = p >= 0 ? p + zz : p - zz;
+                wr[n - 1] = x + zz;
+                wr[n] = zz != 0 ? x - w / zz : wr[n - 1];
+                wi[n - 1] = 0;
+                wi[n] = 0;
+
+                x = h[n * ldh + n - 1];
+                s = fabs(x) + fabs(zz);
+                p = x / s;
+                q = zz / s;
+                r = sqrt(p * p + q * q);
+                p /= r;
+                q /= r;
+
+                for (j = n - 1; j < nn; ++j) {
+                    zz = h[(n - 1) * ldh + j];
+                    h[(n - 1) * ldh + j] = q * zz + p * h[n * ldh + j];
+                    h[n * ldh + j] = q * h[n * ldh + j] - p * zz;
+                }
+                for (i = 0; i <= n; ++i) {
+                    zz = h[i * ldh + n - 1];
+                    h[i * ldh + n - 1] = q * zz + p * h[i * ldh + n];
+                    h[i * ldh + n] = q * h[i * ldh + n] - p * zz;
+                }
+                for (i = 0; i < nn; ++i) {
+                    zz = z[i * ldz + n - 1];
+                    z[i * ldz + n - 1] = q * zz + p * z[i * ldz + n];
+                    z[i * ldz + n] = q * z[i * ldz + n] - p * zz;
+                }
+            } else {
+                wr[n - 1] = x + p;
+                wr[n] = x + p;
+                wi[n - 1] = zz;
+                wi[n] = -zz;
+            }
+            n -= 2;
+            iterations = 0;
+        } else {
+            if (total++ == (long) (EIGEN_MAX_ITERATIONS * size)) {
+                return -1;
+            }
+
+            /* form the shift, with the exceptional ones of EISPACK and MATLAB */
+            x = h[n * ldh + n];
+            y = h[(n - 1) * ldh + n - 1];
+            w = h[n * ldh + n - 1] * h[(n - 1) * ldh + n];
+
+            if (iterations == 10) {
+                exshift += x;
+                for (i = 0; i <= n; ++i) {
+                    h[i * ldh + i] -= x;
+                }
+                s = fabs(h[n * ldh + n - 1]) + fabs(h[(n - 1) * ldh + n - 2]);
+                x = y = 0.75 * s;
+                w = -0.4375 * s * s;
+            }
+            if (iterations == 30) {
+                s = (y - x) / 2;
+                s = s * s + w;
+                if (s > 0) {
+                    s = sqrt(s);
+                    if (y < x) {
+                        s = -s;
+                    }
+                    s = x - w / ((y - x) / 2 + s);
+                    for (i = 0; i <= n; ++i) {
+                        h[i * ldh + i] -= s;
+                    }
+                    exshift += s;
+                    x = y = w = 0.964;
+                }
+            }
+            iterations++;
+
+            /* look for two consecutive small subdiagonal elements */
+            for (m = n - 2; m >= l; --m) {
+                zz = h[m * ldh + m];
+                r = x - zz;
+                s = y - zz;
+                p = (r * s - w) / h[(m + 1) * ldh + m] + h[m * ldh + m + 1];
+                q = h[(m + 1) * ldh + m + 1] - zz - r - s;
+                r = h[(m + 2) * ldh + m + 1];
+                s = fabs(p) + fabs(q) + fabs(r);
+                p /= s;
+                q /= s;
+                r /= s;
+                if (m == l) {
+                    break;
+                }
+                if (fabs(h[m * ldh + m - 1]) * (fabs(q) + fabs(r)) <
+                    EPSILON * (fabs(p) * (fabs(h[(m - 1) * ldh + m - 1]) + fabs(zz) + fabs(h[(m + 1) * ldh + m + 1])))) {
+                    break;
+                }
+            }
+
+            for (i = m + 2; i <= n; ++i) {
+                h[i * ldh + i - 2] = 0;
+                if (i > m + 2) {
+                    h[i * ldh + i - 3] = 0;
+                }
+            }
+
+            /* double QR step on rows l .. n and columns m .. n */
+            for (k = m; k <= n - 1; ++k) {
+                int notlast = k != n - 1;
+
+                if (k != m) {
+                    p = h[k * ldh + k - 1];
+                    q = h[(k + 1) * ldh + k - 1];
+                    r = notlast ? h[(k + 2) * ldh + k - 1] : 0;
+                    x = fabs(p) + fabs(q) + fabs(r);
+                    if (x == 0) {
+                        continue;
+                    }
+                    p /= x;
+                    q /= x;
+                    r /= x;
+                }
+
+                s = sqrt(p * p + q * q + r * r);
+                if (p < 0) {
+                    s = -s;
+                }
+                if (s == 0) {
+                    continue;
+                }
+
+                if (k != m) {
+                    h[k * ldh + k - 1] = -s * x;
+                } else if (l != m) {
+                    h[k * ldh + k - 1] = -h[k * ldh + k - 1];
+                }
+                p += s;
+                x = p / s;
+                y = q / s;
+                zz = r / s;
+                q /= p;
+                r /= p;
+
+                for (j = k; j < nn; ++j) {
+                    p = h[k * ldh + j] + q * h[(k + 1) * ldh + j];
+                    if (notlast) {
+                        p += r * h[(k + 2) * ldh + j];
+                        h[(k + 2) * ldh + j] -= p * zz;
+                    }
+                    h[k * ldh + j] -= p * x;
+                    h[(k + 1) * ldh + j] -= p * y;
+                }
+                for (i = 0; i <= (n < k + 3 ? n : k + 3); ++i) {
+                    p = x * h[i * ldh + k] + y * h[i * ldh + k + 1];
+                    if (notlast) {
+                        p += zz * h[i * ldh + k + 2];
+                        h[i * ldh + k + 2] -= p * r;
+                    }
+                    h[i * ldh + k] -= p;
+                    h[i * ldh + k + 1] -= p * q;
+                }
+                for (i = 0; i < nn; ++i) {
+                    p = x * z[i * ldz + k] + y * z[i * ldz + k + 1];
+                    if (notlast) {
+                        p += zz * z[i * ldz + k + 2];
+                        z[i * ldz + k + 2] -= p * r;
+                    }
+                    z[i * ldz + k] -= p;
+                    z[i * ldz + k + 1] -= p * q;
+                }
+            }
+        }
+    }
+
+    if (norm == 0) {
+        return 0;
+    }
+
+    /* back substitution for the eigenvectors of the quasi-triangular Schur form */
+    for (n = nn - 1; n >= 0; --n) {
+        p = wr[n];
+        q = wi[n];
+
+        if (q == 0) {
+            l = n;
+            h[n * ldh + n] = 1;
+            for (i = n - 1; i >= 0; --i) {
+                w = h[i * ldh + i] - p;
+                r = 0;
+                for (j = l; j <= n; ++j) {
+                    r += h[i * ldh + j] * h[j * ldh + n];
+                }
+                if (wi[i] < 0) {
+                    zz = w;
+                    s = r;
+                    continue;
+                }
+
+                l = i;
+                if (wi[i] == 0) {
+                    h[i * ldh + n] = w != 0 ? -r / w : -r / (EPSILON * norm);
+                } else {
+                    x = h[i * ldh + i + 1];
+                    y = h[(i + 1) * ldh + i];
+                    q = (wr[i] - p) * (wr[i] - p) + wi[i] * wi[i];
+                    t = (x * s - zz * r) / q;
+                    h[i * ldh + n] = t;
+                    h[(i + 1) * ldh + n] = fabs(x) > fabs(zz) ? (-r - w * t) / x : (-s - y * t) / zz;
+                }
+
+                t = fabs(h[i * ldh + n]);
+                if ((EPSILON * t) * t > 1) {
+                    for (j = i; j <= n; ++j) {
+                        h[j * ldh + n] /= t;
+                    }
+                }
+            }
+        } else if (q < 0) {
+            l = n - 1;
+
+            /* the last component is imaginary, so the matrix is triangular */
+            if (fabs(h[n * ldh + n - 1]) > fabs(h[(n - 1) * ldh + n])) {
+                h[(n - 1) * ldh + n - 1] = q / h[n * ldh + n - 1];
+                h[(n - 1) * ldh + n] = -(h[n * ldh + n] - p) / h[n * ldh + n - 1];
+            } else {
+                krylov_complex_divide(0, -h[(n - 1) * ldh + n], h[(n - 1) * ldh + n - 1] - p, q,
+                                      &h[(n - 1) * ldh + n - 1], &h[(n - 1) * ldh + n]);
+            }
+            h[n * ldh + n - 1] = 0;
+            h[n * ldh + n] = 1;
+
+            for (i = n - 2; i >= 0; --i) {
+                double ra = 0, sa = 0, vr, vi;
+
+                for (j = l; j <= n; ++j) {
+                    ra += h[i * ldh + j] * h[j * ldh + n - 1];
+                    sa += h[i * ldh + j] * h[j * ldh + n];
+                }
+                w = h[i * ldh + i] - p;
+
+                if (wi[i] < 0) {
+                    zz = w;
+                    r = ra;
+                    s = sa;
+                    continue;
+                }
+
+                l = i;
+                if (wi[i] == 0) {
+                    krylov_complex_divide(-ra, -sa, w, q, &h[i * ldh + n - 1], &h[i * ldh + n]);
+                } else {
+                    x = h[i * ldh + i + 1];
+                    y = h[(i + 1) * ldh + i];
+                    vr = (wr[i] - p) * (wr[i] - p) + wi[i] * wi[i] - q * q;
+                    vi = (wr[i] - p) * 2 * q;
+                    if (vr == 0 && vi == 0) {
+                        vr = EPSILON * norm * (fabs(w) + fabs(q) + fabs(x) + fabs(y) + fabs(zz));
+                    }
+                    krylov_complex_divide(x * r - zz * ra + q * sa, x * s - zz * sa - q * ra, vr, vi,
+                                          &h[i * ldh + n - 1], &h[i * ldh + n]);
+                    if (fabs(x) > fabs(zz) + fabs(q)) {
+                        h[(i + 1) * ldh + n - 1] = (-ra - w * h[i * ldh + n - 1] + q * h[i * ldh + n]) / x;
+                        h[(i + 1) * ldh + n] = (-sa - w * h[i * ldh + n] - q * h[i * ldh + n - 1]) / x;
+                    } else {
+                        krylov_complex_divide(-r - y * h[i * ldh + n - 1], -s - y * h[i * ldh + n], zz, q,
+                                              &h[(i + 1) * ldh + n - 1], &h[(i + 1) * ldh + n]);
+                    }
+                }
+
+                t = fmax(fabs(h[i * ldh + n - 1]), fabs(h[i * ldh + n]));
+                if ((EPSILON * t) * t > 1) {
+                    for (j = i; j <= n; ++j) {
+                        h[j * ldh + n - 1] /= t;
+                        h[j * ldh + n] /= t;
+                    }
+                }
+            }
+        }
+    }
+
+    /* back to the original basis: Z = Z X, with X upper triangular in h */
+    for (j = nn - 1; j >= 0; --j) {
+        for (i = 0; i < nn; ++i) {
+            zz = 0;
+            for (k = 0; k <= j; ++k) {
+                zz += z[i * ldz + k] * h[k * ldh + j];
+            }
+            z[i * ldz + j] = zz;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ *  Ordena order[0:m] pela preferência de which, com os pares conjugados juntos e a parte imaginária positiva
+ *  primeiro.
+ */
+static void krylov_sort(krylov_which_t which, size_t m, const double *wr, const double *wi, size_t *order)
+{
+    size_t i, j;
+
+    for (i = 0; i < m; ++i) {
+        order[i] = i;
+    }
+
+    /* insertion sort by (preference, real part, imaginary part), all descending */
+    for (i = 1; i < m; ++i) {
+        size_t current = order[i];
+        double key = which == KRYLOV_LARGEST_MAGNITUDE ? hypot(wr[current], wi[current]) :
+                     which == KRYLOV_LARGEST_REAL ? wr[current] : -wr[current];
+
+        for (j = i; j > 0; --j) {
+            size_t other = order[j - 1];
+            double okey = which == KRYLOV_LARGEST_MAGNITUDE ? hypot(wr[other], wi[other]) :
+                          which == KRYLOV_LARGEST_REAL ? wr[other] : -wr[other];
+
+            if (okey > key || (okey == key && (wr[other] > wr[current] ||
+                                               (wr[other] == wr[current] && wi[other] >= wi[current])))) {
+                break;
+            }
+            order[j] = other;
+        }
+        order[j] = current;
+    }
+}
+
+/**
+ *  Norma do autovetor de H na coluna c de Y (m x m); para um par conjugado, a do vetor complexo.
+ */
+static double krylov_ritz_norm(size_t m, const double *Y, const double *wi, size_t c)
+{
+    size_t re = wi[c] < 0 ? c - 1 : c;
+    double norm = qr_norm2(m, Y + re, m);
+
+    if (wi[c] != 0) {
+        norm = hypot(norm, qr_norm2(m, Y + re + 1, m));
+    }
+
+    return norm;
+}
+
+/**
+ *  Estende a fatoração A V = V H + f e^T de first para m vetores. <br>
+ *  Para first > 0, a linha first de H já deve ter o acoplamento com f, e f não é alterado antes de ser usado.
+ *  @param Vt Base, um vetor de n elementos por linha.
+ *  @param H Matriz m x m, linha a linha.
+ *  @param f Resíduo, n elementos.
+ *  @param w Espaço para m elementos.
+ */
+static void krylov_expand(const operator_t *op, int symmetric, size_t first, size_t m, double *Vt, double *H,
+                          double *f, double *w, krylov_context_t *ctx)
+{
+    size_t n = op->rows;
+    double hnorm = 0;
+    size_t i, j;
+
+    for (i = 0; i < first * m; ++i) {
+        hnorm = fmax(hnorm, fabs(H[i]));
+    }
+
+    for (j = first; j < m; ++j) {
+        double *v = Vt + j * n;
+        double beta = qr_norm2(n, f, 1);
+        int pass;
+
+        if (j > 0 && beta > EPSILON * hnorm) {
+            for (i = 0; i < n; ++i) {
+                v[i] = f[i] / beta;
+            }
+            if (j > first) {
+                H[j * m + j - 1] = beta;
+            }
+        } else {
+            /* an invariant subspace (or the very first vector): continue from a new direction orthogonal to V */
+            unsigned long seed = 0x2545f491ul + j;
+
+            if (j == 0 && ctx->start != NULL) {
+                memcpy(v, ctx->start, sizeof(double) * n);
+            } else {
+                for (i = 0; i < n; ++i) {
+                    seed = seed * 1103515245ul + 12345ul;
+                    v[i] = (double) ((seed >> 16) & 0x7fff) / 0x7fff - 0.5;
+                }
+            }
+            for (pass = 0; pass < 2 && j > 0; ++pass) {
+                gemv(BLAS_NO_TRANS, j, n, 1, Vt, n, v, 0, w);
+                gemv(BLAS_TRANS, n, j, -1, Vt, n, w, 1, v);
+            }
+            beta = qr_norm2(n, v, 1);
+            for (i = 0; i < n; ++i) {
+                v[i] /= beta;
+            }
+            if (j > 0) {
+                memset(H + j * m, 0, sizeof(double) * j);
+            }
+        }
+
+        operator_apply(op, v, f);
+        ctx->products++;
+
+        /* f -= V h, twice, so that f stays orthogonal to V to working precision */
+        for (i = 0; i <= j; ++i) {
+            H[i * m + j] = 0;
+        }
+        for (pass = 0; pass < 2; ++pass) {
+            gemv(BLAS_NO_TRANS, j + 1, n, 1, Vt, n, f, 0, w);
+            gemv(BLAS_TRANS, n, j + 1, -1, Vt, n, w, 1, f);
+            for (i = 0; i <= j; ++i) {
+                H[i * m + j] += w[i];
+            }
+        }
+
+        if (symmetric) {
+            for (i = 0; i < j; ++i) {
+                H[j * m + i] = H[i * m + j];
+            }
+        }
+
+        for (i = 0; i <= j; ++i) {
+            hnorm = fmax(hnorm, fabs(H[i * m + j]));
+        }
+    }
+}
+
+/**
+ *  Núcleo de lanczos_eigen_ctx e arnoldi_eigen_ctx.
+ *  @return Os autovalores, k x 1 para operadores simétricos e count x 2 (partes real e imaginária) para os
+ *  gerais, ou NULL caso falte memória.
+ */
+static matrix_t *krylov_eigen(const operator_t *op, size_t k, krylov_which_t which, int symmetric,
+                              matrix_t **vectors, krylov_context_t *ctx)
+{
+    size_t n = op->rows;
+    size_t m = ctx->subspace;
+    size_t max_restarts = ctx->max_restarts ? ctx->max_restarts : KRYLOV_MAX_RESTARTS;
+    double tolerance = ctx->tolerance > 0 ? ctx->tolerance : EPSILON;
+    double *Vt, *H, *f, *w, *S, *Y, *wr, *wi, *residual, *W, *T, *tau;
+    size_t *order;
+    matrix_t *values = NULL, *X = NULL;
+    size_t wanted = k, first = 0;
+    int status = 0;
+    size_t i, j;
+
+    assert(op->rows == op->columns);
+    assert(k > 0 && k < n);
+
+    if (m == 0) {
+        m = 2 * k + 1 > 20 ? 2 * k + 1 : 20;
+    }
+    /* room for a conjugate pair beyond the k wanted values, and for at least one new vector per restart */
+    if (m < k + 3) {
+        m = k + 3;
+    }
+    if (m > n) {
+        m = n;
+    }
+
+    ctx->restarts = 0;
+    ctx->products = 0;
+    ctx->converged = 0;
+
+    Vt = (double *) malloc(sizeof(double) * m * n);
+    T = (double *) malloc(sizeof(double) * m * n);
+    f = (double *) calloc(n, sizeof(double));
+    H = (double *) calloc(m * m, sizeof(double));
+    S = (double *) malloc(sizeof(double) * m * m);
+    Y = (double *) malloc(sizeof(double) * m * m);
+    W = (double *) malloc(sizeof(double) * m * m);
+    w = (double *) malloc(sizeof(double) * m);
+    wr = (double *) malloc(sizeof(double) * m);
+    wi = (double *) calloc(m, sizeof(double));
+    residual = (double *) malloc(sizeof(double) * m);
+    tau = (double *) malloc(sizeof(double) * m);
+    order = (size_t *) malloc(sizeof(size_t) * m);
+
+    if (Vt == NULL || T == NULL || f == NULL || H == NULL || S == NULL || Y == NULL || W == NULL || w == NULL ||
+        wr == NULL || wi == NULL || residual == NULL || tau == NULL || order == NULL) {
+        status = -1;
+    }
+
+    while (status == 0) {
+        double beta, largest = 0;
+        size_t keep, converged = 0;
+
+        krylov_expand(op, symmetric, first, m, Vt, H, f, w, ctx);
+        beta = qr_norm2(n, f, 1);
+
+        /* Ritz pairs: the eigenvectors of H go in the columns of Y */
+        if (symmetric) {
+            matrix_t Hm, *theta, *vecs;
+
+            theta = eigen_symmetric(matrix_wrap_init(&Hm, H, m, m, m, MATRIX_ROW_MAJOR), &vecs);
+            if (theta == NULL) {
+                status = -1;
+                break;
+            }
+            memcpy(wr, theta->elements, sizeof(double) * m);
+            memcpy(Y, vecs->elements, sizeof(double) * m * m);
+            matrix_free(theta);
+            matrix_free(vecs);
+        } else {
+            memcpy(S, H, sizeof(double) * m * m);
+            for (i = 0; i < m * m; ++i) {
+                Y[i] = i % (m + 1) == 0;
+            }
+            krylov_hessenberg(m, S, m, Y, m, w);
+            if (krylov_hessenberg_eigen(m, S, m, wr, wi, Y, m) != 0) {
+                status = -1;
+                break;
+            }
+        }
+
+        krylov_sort(which, m, wr, wi, order);
+
+        /* ||A x - theta x|| = beta |e_m^T y| / ||y|| for each Ritz pair */
+        for (i = 0; i < m; ++i) {
+            size_t c = order[i];
+            size_t re = wi[c] < 0 ? c - 1 : c;
+            double last = fabs(Y[(m - 1) * m + c]);
+
+            if (wi[c] != 0) {
+                last = hypot(Y[(m - 1) * m + re], Y[(m - 1) * m + re + 1]);
+            }
+
+            residual[i] = beta * last / krylov_ritz_norm(m, Y, wi, c);
+            largest = fmax(largest, hypot(wr[c], wi[c]));
+        }
+
+        /* never leave half of a conjugate pair out */
+        wanted = k;
+        if (wi[order[k - 1]] > 0) {
+            wanted = k + 1;
+        }
+
+        for (i = 0; i < wanted; ++i) {
+            size_t c = order[i];
+            if (residual[i] <= tolerance * fmax(hypot(wr[c], wi[c]), pow(EPSILON, 2.0 / 3) * largest)) {
+                converged++;
+            }
+        }
+        ctx->converged = converged < k ? converged : k;
+
+        if (converged >= wanted || ctx->restarts == max_restarts) {
+            break;
+        }
+        ctx->restarts++;
+
+        /* restart from the wanted pairs and half of the rest */
+        keep = wanted + (m - wanted) / 2;
+        if (wi[order[keep - 1]] > 0) {
+            keep++;
+        }
+        if (keep >= m) {
+            keep = wanted;
+        }
+
+        /* W: an orthonormal basis of the invariant subspace of H for the kept Ritz values */
+        /* a conjugate pair contributes the real and imaginary parts of its eigenvector, which span the same plane */
+        for (j = 0; j < keep; ++j) {
+            for (i = 0; i < m; ++i) {
+                W[i * keep + j] = Y[i * m + order[j]];
+            }
+        }
+        if (!symmetric) {
+            memcpy(S, W, sizeof(double) * m * keep);
+            if (qr_factor_array(m, keep, S, keep, tau) != 0) {
+                status = -1;
+                break;
+            }
+            memset(W, 0, sizeof(double) * m * keep);
+            for (j = 0; j < keep; ++j) {
+                W[j * keep + j] = 1;
+            }
+            if (qr_apply_array(BLAS_NO_TRANS, m, keep, S, keep, tau, W, keep, keep) != 0) {
+                status = -1;
+                break;
+            }
+        }
+
+        /* A (V W) = (V W) (W^T H W) + f (e_m^T W) */
+        gemm(BLAS_NO_TRANS, BLAS_NO_TRANS, m, keep, m, 1, H, m, W, keep, 0, Y, keep);
+        gemm(BLAS_TRANS, BLAS_NO_TRANS, keep, keep, m, 1, W, keep, Y, keep, 0, S, keep);
+        memset(H, 0, sizeof(double) * m * m);
+        for (i = 0; i < keep; ++i) {
+            memcpy(H + i * m, S + i * keep, sizeof(double) * keep);
+            H[keep * m + i] = beta * W[(m - 1) * keep + i];
+        }
+
+        gemm(BLAS_TRANS, BLAS_NO_TRANS, keep, n, m, 1, W, keep, Vt, n, 0, T, n);
+        memcpy(Vt, T, sizeof(double) * keep * n);
+        first = keep;
+    }
+
+    if (status == 0) {
+        values = matrix_new(wanted, symmetric ? 1 : 2);
+        status = values == NULL ? -1 : 0;
+    }
+
+    if (status == 0) {
+        size_t count = values->rows;
+
+        for (i = 0; i < count; ++i) {
+            size_t c = order[i];
+            values->elements[i * values->columns] = wr[c];
+            if (!symmetric) {
+                values->elements[i * 2 + 1] = wi[c];
+            }
+        }
+
+        if (vectors != NULL) {
+            /* the Ritz vectors are V y, with the real and imaginary parts of a pair in consecutive columns */
+            for (j = 0; j < count; ++j) {
+                double norm = krylov_ritz_norm(m, Y, wi, order[j]);
+                for (i = 0; i < m; ++i) {
+                    W[i * count + j] = Y[i * m + order[j]] / norm;
+                }
+            }
+
+            X = matrix_new(n, count);
+            status = X == NULL ? -1 : 0;
+            if (status == 0) {
+                gemm(BLAS_TRANS, BLAS_NO_TRANS, n, count, m, 1, Vt, n, W, count, 0, X->elements, count);
+            }
+        }
+    }
+
+    free(Vt);
+    free(T);
+    free(f);
+    free(H);
+    free(S);
+    free(Y);
+    free(W);
+    free(w);
+    free(wr);
+    free(wi);
+    free(residual);
+    free(tau);
+    free(order);
+
+    if (status != 0) {
+        if (values != NULL) {
+            matrix_free(values);
+        }
+        values = NULL;
+    }
+
+    if (vectors != NULL) {
+        *vectors = X;
+    }
+
+    return values;
+}
+
+/**
+ *  Calcula k autovalores extremos de um operador simétrico, e opcionalmente os seus autovetores, por Lanczos
+ *  com reinício espesso.
+ *  @param which Quais autovalores procurar.
+ *  @param vectors Caso não seja NULL, recebe a matriz n x k com os autovetores nas colunas.
+ *  @param ctx Parâmetros e estatísticas; ctx->converged diz quantos pares atingiram a tolerância.
+ *  @return Os autovalores (k x 1), na ordem de preferência de which, ou NULL caso falte memória.
+ */
+static matrix_t *lanczos_eigen_ctx(const operator_t *op, size_t k, krylov_which_t which, matrix_t **vectors,
+                                   krylov_context_t *ctx)
+{
+    return krylov_eigen(op, k, which, 1, vectors, ctx);
+}
+
+/**
+ *  Calcula k autovalores extremos de um operador simétrico com os parâmetros padrão.
+ *  @see lanczos_eigen_ctx
+ *  @return Os autovalores (k x 1), ou NULL caso falte memória ou algum par não convirja.
+ */
+static matrix_t *lanczos_eigen(const operator_t *op, size_t k, krylov_which_t which, matrix_t **vectors)
+{
+    krylov_context_t ctx;
+    matrix_t *values;
+
+    krylov_context_init(&ctx);
+    values = lanczos_eigen_ctx(op, k, which, vectors, &ctx);
+
+    if (values != NULL && ctx.converged < k) {
+        matrix_free(values);
+        values = NULL;
+        if (vectors != NULL) {
+            matrix_free(*vectors);
+            *vectors = NULL;
+        }
+    }
+
+    return values;
+}
+
+/**
+ *  Calcula k autovalores extremos de um operador qualquer, e opcionalmente os seus autovetores, por Arnoldi
+ *  com reinício de Krylov-Schur. <br>
+ *  Autovalores complexos vêm em pares conjugados; caso o k-ésimo seja metade de um par, o par inteiro é
+ *  devolvido, com k + 1 autovalores.
+ *  @param which Quais autovalores procurar.
+ *  @param vectors Caso não seja NULL, recebe a matriz n x count com os autovetores nas colunas. Para um par
+ *  conjugado nas linhas j e j + 1, as colunas j e j + 1 são as partes real e imaginária do autovetor de
+ *  values[j], e o de values[j + 1] é o seu conjugado.
+ *  @param ctx Parâmetros e estatísticas; ctx->converged diz quantos pares atingiram a tolerância.
+ *  @return Os autovalores (count x 2, com as partes real e imaginária), na ordem de preferência de which, ou
+ *  NULL caso falte memória ou o QR do problema projetado não convirja.
+ */
+static matrix_t *arnoldi_eigen_ctx(const operator_t *op, size_t k, krylov_which_t which, matrix_t **vectors,
+                                   krylov_context_t *ctx)
+{
+    return krylov_eigen(op, k, which, 0, vectors, ctx);
+}
+
+/**
+ *  Calcula k autovalores extremos de um operador qualquer com os parâmetros padrão.
+ *  @see arnoldi_eigen_ctx
+ *  @return Os autovalores (count x 2), ou NULL caso falte memória ou algum par não convirja.
+ */
+static matrix_t *arnoldi_eigen(const operator_t *op, size_t k, krylov_which_t which, matrix_t **vectors)
+{
+    krylov_context_t ctx;
+    matrix_t *values;
+
+    krylov_context_init(&ctx);
+    values = arnoldi_eigen_ctx(op, k, which, vectors, &ctx);
+
+    if (values != NULL && ctx.converged < k) {
+        matrix_free(values);
+        values = NULL;
+        if (vectors != NULL) {
+            matrix_free(*vectors);
+            *vectors = NULL;
+        }
+    }
+
+    return values;
+}
+
+#endif
@@ -0,0 +1,141 @@
+/**
+ *  @file
+ */
+/*
+ * Copyright (c) 2018 Victor Hermann "vitorhnn" Chiletto
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+**/
+
+#ifndef LDLT_H
+#define LDLT_H
+
+#include "matrix.h"
+
+/**
+ *  Calcula a fatoração LDLt da matriz simétrica mat. <br>
+ *  O resultado é guardado compactado: D na diagonal e L, com diagonal unitária implícita, abaixo dela.
+ *  Somente o triângulo inferior de mat é lido.
+ *  \warning Não há pivoteamento; pivôs desprezíveis em relação aos elementos de mat fazem a fatoração falhar.
+ *  @return A fatoração compactada, ou NULL caso um pivô seja desprezível.
+ */
+static matrix_t *ldlt_factor(const matrix_t *mat)
+{
+    size_t n = mat->rows;
+    matrix_t *factor;
+    double *work;
+    double biggest = 0;
+    size_t i, j, k;
+
+    assert(mat->rows == mat->columns);
+
+    factor = matrix_new(n, n);
+    work = malloc(sizeof(double) * (n ? n : 1));
+
+    memset(factor->elements, 0, sizeof(double) * (n * n));
+
+    for (i = 0; i < n; ++i) {
+        for (j = 0; j <= i; ++j) {
+            if (fabs(matrix_get_at(mat, i, j)) > biggest) {
+                biggest = fabs(matrix_get_at(mat, i, j));
+            }
+        }
+    }
+
+    for (j = 0; j < n; ++j) {
+        double d = matrix_get_at(mat, j, j);
+
+        /* work[k] = L(j, k) * D(k) */
+        for (k = 0; k < j; ++k) {
+            work[k] = matrix_get_at(factor, j, k) * matrix_get_at(factor, k, k);
+            d -= matrix_get_at(factor, j, k) * work[k];
+        }
+
+        if (fabs(d) <= n * DBL_EPSILON * biggest) {
+            free(work);
+            matrix_free(factor);
+            return NULL;
+        }
+
+        matrix_set_at(factor, j, j, d);
+
+        for (i = j + 1; i < n; ++i) {
+            double l = matrix_get_at(mat, i, j);
+
+            for (k = 0; k < j; ++k) {
+                l -= matrix_get_at(factor, i, k) * work[k];
+            }
+
+            matrix_set_at(factor, i, j, l / d);
+        }
+    }
+
+    free(work);
+
+    return factor;
+}
+
+/**
+ *  Resolve o sistema Ax = b, com A simétrica, por fatoração LDLt.
+ *  @return O vetor x, ou NULL caso a fatoração falhe.
+ */
+static matrix_t *ldlt_solve(const matrix_t * ALC_RESTRICT A, const matrix_t * ALC_RESTRICT b)
+{
+    matrix_t *factor = ldlt_factor(A);
+    matrix_t *x;
+    size_t n = A->rows;
+    size_t i;
+
+    if (factor == NULL) {
+        return NULL;
+    }
+
+    x = matrix_copy(b);
+
+    /* Lz = b */
+    for (i = 0; i < n; ++i) {
+        double sum = matrix_get_at(x, i, 0);
+        size_t k;
+        for (k = 0; k < i; ++k) {
+            sum -= matrix_get_at(factor, i, k) * matrix_get_at(x, k, 0);
+        }
+        matrix_set_at(x, i, 0, sum);
+    }
+
+    /* Dy = z */
+    for (i = 0; i < n; ++i) {
+        matrix_set_at(x, i, 0, matrix_get_at(x, i, 0) / matrix_get_at(factor, i, i));
+    }
+
+    /* Ltx = y */
+    for (i = n; i-- > 0;) {
+        double sum = matrix_get_at(x, i, 0);
+        size_t k;
+        for (k = i + 1; k < n; ++k) {
+            sum -= matrix_get_at(factor, k, i) * matrix_get_at(x, k, 0);
+        }
+        matrix_set_at(x, i, 0, sum);
+    }
+
+    matrix_free(factor);
+
+    return x;
+}
+
+#endif
@@ -28,11 +28,13 @@
 
 #include "matrix.h"
 #include "basic.h"
+#include "blas.h"
+#include "workspace.h"
 
 /**
  *  Decompõe a matriz A em L, triangular inferior, e U, triangular superior.
  */
-static void lu_decompose(const matrix_t * restrict A, matrix_t ** restrict L, matrix_t ** restrict U)
+static void lu_decompose(const matrix_t * ALC_RESTRICT A, matrix_t ** ALC_RESTRICT L, matrix_t ** ALC_RESTRICT U)
 {
     /* doolittle reduction. */
     /* using the variables from watkin's book because this is confusing */
@@ -68,22 +70,177 @@ static void lu_decompose(const matrix_t * restrict A, matrix_t ** restrict L, ma
 }
 
 /**
- *  Resolve o sistema Ax = b por decomposição LU
+ *  Largura dos painéis da fatoração LU em blocos.
+ */
+#ifndef LU_BLOCK
+#define LU_BLOCK 64
+#endif
+
+#define REAL double
+#define REAL_NAME(name) name
+#define REAL_FABS(x) fabs(x)
+#include "lu_impl.h"
+#undef REAL_FABS
+#undef REAL_NAME
+#undef REAL
+
+#define REAL float
+#define REAL_NAME(name) name##f
+#define REAL_FABS(x) fabsf(x)
+#include "lu_impl.h"
+#undef REAL_FABS
+#undef REAL_NAME
+#undef REAL
+
+/**
+ *  Calcula a fatoração PA = LU com pivoteamento parcial. <br>
+ *  O resultado é compactado em uma única matriz: U no triângulo superior e L, com diagonal unitária
+ *  implícita, abaixo da diagonal. Na etapa i, a linha i foi trocada com a linha (*pivots)[i]. <br>
+ *  A fatoração é feita em painéis de LU_BLOCK colunas; o restante da matriz é atualizado com gemm.
+ *  @param pivots Recebe um vetor de A->rows índices, alocado com malloc.
+ *  @return A fatoração compactada, ou NULL (e *pivots NULL) caso A seja singular.
+ */
+static matrix_t *lu_factor(const matrix_t *A, size_t **pivots)
+{
+    size_t n = A->rows;
+    matrix_t *LU;
+    size_t *piv;
+
+    assert(A->rows == A->columns);
+
+    LU = matrix_copy(A);
+    piv = (size_t *) malloc(sizeof(size_t) * (n ? n : 1));
+
+    if (lu_factor_array(n, LU->elements, n, piv) != 0) {
+        free(piv);
+        matrix_free(LU);
+        *pivots = NULL;
+        return NULL;
+    }
+
+    *pivots = piv;
+
+    return LU;
+}
+
+/**
+ *  Resolve Ax = b em O(n^2), no próprio vetor x, a partir da fatoração de lu_factor.
+ *  @param x Contém b na entrada e x na saída.
+ */
+static void lu_factor_apply(const matrix_t * ALC_RESTRICT LU, const size_t * ALC_RESTRICT pivots, double * ALC_RESTRICT x)
+{
+    assert(LU->order == MATRIX_ROW_MAJOR);
+
+    lu_apply_array(LU->rows, LU->elements, matrix_ld(LU), pivots, x);
+}
+
+/**
+ *  Resolve A^T x = b em O(n^2), no próprio vetor x, a partir da fatoração de lu_factor.
+ *  @param x Contém b na entrada e x na saída.
+ */
+static void lu_factor_apply_transpose(const matrix_t * ALC_RESTRICT LU, const size_t * ALC_RESTRICT pivots,
+                                      double * ALC_RESTRICT x)
+{
+    size_t n = LU->rows;
+    size_t ld = matrix_ld(LU);
+    const double *a = LU->elements;
+    size_t i;
+
+    assert(LU->order == MATRIX_ROW_MAJOR);
+
+    /* U^T z = b, walking U by rows so that the inner loop is contiguous */
+    for (i = 0; i < n; ++i) {
+        const double *row = a + i * ld;
+        double z = x[i] / row[i];
+        size_t j;
+
+        x[i] = z;
+        for (j = i + 1; j < n; ++j) {
+            x[j] -= row[j] * z;
+        }
+    }
+
+    /* L^T w = z */
+    for (i = n; i-- > 0;) {
+        const double *row = a + i * ld;
+        double w = x[i];
+        size_t j;
+        for (j = 0; j < i; ++j) {
+            x[j] -= row[j] * w;
+        }
+    }
+
+    for (i = n; i-- > 0;) {
+        if (pivots[i] != i) {
+            double swap = x[i];
+            x[i] = x[pivots[i]];
+            x[pivots[i]] = swap;
+        }
+    }
+}
+
+/**
+ *  Resolve o sistema Ax = b a partir da fatoração de lu_factor.
  *  @return O vetor x.
  */
-static matrix_t *lu_solve(const matrix_t * restrict A, const matrix_t * restrict b)
+static matrix_t *lu_factor_solve(const matrix_t * ALC_RESTRICT LU, const size_t * ALC_RESTRICT pivots,
+                                 const matrix_t * ALC_RESTRICT b)
 {
-    matrix_t *l, *u;
-    lu_decompose(A, &l, &u);
+    matrix_t *x = matrix_copy(b);
 
-    matrix_t *y = forwards_substitution(l, b);
-    matrix_t *x = backwards_substitution(u, y);
+    assert(b->rows == LU->rows && b->columns == 1);
 
-    matrix_free(l);
-    matrix_free(u);
-    matrix_free(y);
+    lu_factor_apply(LU, pivots, x->elements);
 
     return x;
 }
 
+/**
+ *  Bytes de workspace com que lu_solve_ws não aloca temporários.
+ */
+static size_t lu_solve_workspace_size(size_t n)
+{
+    return workspace_bytes(sizeof(double) * n * n) + workspace_bytes(sizeof(size_t) * n);
+}
+
+/**
+ *  Resolve o sistema Ax = b por decomposição LU com pivoteamento parcial,
+ *  tirando a fatoração e os pivôs de ws.
+ *  @param ws Workspace de lu_solve_workspace_size(n) bytes, ou NULL.
+ *  @return O vetor x, ou NULL caso A seja singular.
+ */
+static matrix_t *lu_solve_ws(const matrix_t * ALC_RESTRICT A, const matrix_t * ALC_RESTRICT b, workspace_t *ws)
+{
+    size_t n = A->rows;
+    size_t mark = workspace_mark(ws);
+    double *a = (double *) workspace_alloc(ws, sizeof(double) * n * n);
+    size_t *pivots = (size_t *) workspace_alloc(ws, sizeof(size_t) * n);
+    matrix_t *x = NULL;
+
+    assert(A->rows == A->columns);
+    assert(b->rows == n && b->columns == 1);
+
+    matrix_pack(A, a, n);
+
+    if (lu_factor_array(n, a, n, pivots) == 0) {
+        x = matrix_copy(b);
+        lu_apply_array(n, a, n, pivots, x->elements);
+    }
+
+    workspace_dealloc(ws, pivots);
+    workspace_dealloc(ws, a);
+    workspace_release(ws, mark);
+
+    return x;
+}
+
+/**
+ *  Resolve o sistema Ax = b por decomposição LU
+ *  @return O vetor x, ou NULL caso A seja singular.
+ */
+static matrix_t *lu_solve(const matrix_t * ALC_RESTRICT A, const matrix_t * ALC_RESTRICT b)
+{
+    return lu_solve_ws(A, b, NULL);
+}
+
 #endif
@@ -0,0 +1,136 @@
+/**
+ *  @file
+ */
+/*
+ * Copyright (c) 2018 Victor Hermann "vitorhnn" Chiletto
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+**/
+
+/*
+ * Precision-generic body of the packed LU kernels in lu.h; no include guard on
+ * purpose. The includer defines REAL and REAL_NAME(name) as for blas_impl.h,
+ * and REAL_FABS(x) as fabs or fabsf, so floats stay floats.
+ */
+
+/**
+ *  Fatora a[0:n, 0:n] em PA = LU, no próprio vetor e com pivoteamento parcial. <br>
+ *  U fica no triângulo superior e L, com diagonal unitária implícita, abaixo da diagonal;
+ *  na etapa i, a linha i foi trocada com a linha pivots[i]. <br>
+ *  A fatoração é feita em painéis de LU_BLOCK colunas; o restante da matriz é atualizado com gemm.
+ *  @return 0 em caso de sucesso, k + 1 caso o k-ésimo pivô seja nulo.
+ */
+static size_t REAL_NAME(lu_factor_array)(size_t n, REAL *a, size_t lda, size_t *pivots)
+{
+    size_t k;
+
+    for (k = 0; k < n; k += LU_BLOCK) {
+        size_t end = k + LU_BLOCK < n ? k + LU_BLOCK : n;
+        size_t j;
+
+        /* factor the panel a[k:n, k:end], swapping whole rows so the rest of the matrix follows along */
+        for (j = k; j < end; ++j) {
+            size_t p = j;
+            REAL biggest = REAL_FABS(a[j * lda + j]);
+            REAL *row_j;
+            size_t i;
+
+            for (i = j + 1; i < n; ++i) {
+                if (REAL_FABS(a[i * lda + j]) > biggest) {
+                    biggest = REAL_FABS(a[i * lda + j]);
+                    p = i;
+                }
+            }
+
+            if (biggest == 0) {
+                return j + 1;
+            }
+
+            pivots[j] = p;
+            row_j = a + j * lda;
+
+            if (p != j) {
+                REAL *row_p = a + p * lda;
+                size_t c;
+                for (c = 0; c < n; ++c) {
+                    REAL swap = row_j[c];
+                    row_j[c] = row_p[c];
+                    row_p[c] = swap;
+                }
+            }
+
+            for (i = j + 1; i < n; ++i) {
+                REAL *row_i = a + i * lda;
+                REAL l = row_i[j] / row_j[j];
+                size_t c;
+
+                row_i[j] = l;
+                for (c = j + 1; c < end; ++c) {
+                    row_i[c] -= l * row_j[c];
+                }
+            }
+        }
+
+        if (end < n) {
+            /* U12 = L11^-1 A12, then A22 -= L21 U12 */
+            REAL_NAME(trsm_left_lower_unit)(end - k, n - end, a + k * lda + k, lda, a + k * lda + end, lda);
+            REAL_NAME(gemm)(BLAS_NO_TRANS, BLAS_NO_TRANS, n - end, n - end, end - k,
+                            -1, a + end * lda + k, lda, a + k * lda + end, lda, 1, a + end * lda + end, lda);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ *  Resolve Ax = b em O(n^2), no próprio vetor x, a partir da fatoração de lu_factor_array.
+ *  @param x Contém b na entrada e x na saída.
+ */
+static void REAL_NAME(lu_apply_array)(size_t n, const REAL *a, size_t lda, const size_t *pivots, REAL *x)
+{
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        if (pivots[i] != i) {
+            REAL swap = x[i];
+            x[i] = x[pivots[i]];
+            x[pivots[i]] = swap;
+        }
+    }
+
+    for (i = 0; i < n; ++i) {
+        const REAL *row = a + i * lda;
+        REAL sum = x[i];
+        size_t j;
+        for (j = 0; j < i; ++j) {
+            sum -= row[j] * x[j];
+        }
+        x[i] = sum;
+    }
+
+    for (i = n; i-- > 0;) {
+        const REAL *row = a + i * lda;
+        REAL sum = x[i];
+        size_t j;
+        for (j = i + 1; j < n; ++j) {
+            sum -= row[j] * x[j];
+        }
+        x[i] = sum / row[i];
+    }
+}
@@ -34,13 +34,46 @@
 #include <assert.h>
 #include <float.h>
 
+#include "parallel.h"
+
+/*
+ * 1 when the system headers declare POSIX.1-2008 (pread, pwrite, ftruncate, posix_memalign, ...).
+ * Read from what the headers above ended up exposing, since a strict -std=c99 hides POSIX and the
+ * feature macros belong to the program; Darwin exposes everything unless _POSIX_C_SOURCE narrows it.
+ */
+#if (defined(__APPLE__) && !defined(_POSIX_C_SOURCE)) || \
+    (defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 200809L) || (defined(_XOPEN_SOURCE) && _XOPEN_SOURCE >= 700)
+#define MATRIX_POSIX 1
+#else
+#define MATRIX_POSIX 0
+#endif
+
 #ifndef EPSILON
 #define EPSILON DBL_EPSILON
 #endif
 
+/* ALC_RESTRICT qualifier for the library's own declarations; C++ spells it __restrict */
+#ifdef __cplusplus
+#define ALC_RESTRICT __restrict
+#else
+#define ALC_RESTRICT restrict
+#endif
+
+/**
+ * Ordem em que os elementos de uma matriz ficam na memória.
+ */
+typedef enum {
+    /** Linha a linha, como em C. **/
+    MATRIX_ROW_MAJOR = 0,
+    /** Coluna a coluna, como em Fortran ou numpy com order='F'. **/
+    MATRIX_COLUMN_MAJOR = 1
+} matrix_order_t;
+
 /**
  * Estrutura representando uma matriz. <br>
- * É uma boa ideia não mexer nela diretamente.
+ * É uma boa ideia não mexer nela diretamente. <br>
+ * Os campos ld, order e borrowed zerados descrevem uma matriz densa, linha a linha e dona de elements,
+ * que é o que matrix_new cria; matrix_wrap descreve memória de terceiros.
  */
 typedef struct {
     double *elements;
@@ -48,8 +81,58 @@ typedef struct {
     size_t columns;
     /** Usado internamente na hora de transpor a matriz **/
     int transposed;
+    /** Distância, em elementos, entre o início de duas linhas (ou colunas, se order for MATRIX_COLUMN_MAJOR); 0 para densa. **/
+    size_t ld;
+    matrix_order_t order;
+    /** elements pertence a outra pessoa e não é liberado por matrix_free. **/
+    int borrowed;
 } matrix_t;
 
+/**
+ *  Distância, em elementos, entre o início de duas linhas de mat (ou colunas, se mat for MATRIX_COLUMN_MAJOR).
+ */
+static size_t matrix_ld(const matrix_t *mat)
+{
+    if (mat->ld != 0) {
+        return mat->ld;
+    }
+
+    return mat->order == MATRIX_COLUMN_MAJOR ? mat->rows : mat->columns;
+}
+
+/**
+ *  Posição do elemento (row, column) em mat->elements, sem considerar transposed.
+ */
+static size_t matrix_offset(const matrix_t *mat, size_t row, size_t column)
+{
+    if (mat->order == MATRIX_COLUMN_MAJOR) {
+        return column * matrix_ld(mat) + row;
+    }
+
+    return row * matrix_ld(mat) + column;
+}
+
+/**
+ *  Distância, em elementos, entre dois elementos seguidos de uma linha e de uma coluna de mat,
+ *  considerando transposed: o elemento (i, j) está em elements[i * column_stride + j * row_stride].
+ */
+static void matrix_strides(const matrix_t *mat, size_t *row_stride, size_t *column_stride)
+{
+    size_t ld = matrix_ld(mat);
+    int by_rows = (mat->order == MATRIX_ROW_MAJOR) == !mat->transposed;
+
+    *row_stride = by_rows ? 1 : ld;
+    *column_stride = by_rows ? ld : 1;
+}
+
+/**
+ *  Confere se mat é densa e linha a linha, isto é, se o elemento (i, j) está em elements[i * columns + j].
+ */
+static int matrix_is_dense(const matrix_t *mat)
+{
+    return mat->order == MATRIX_ROW_MAJOR && matrix_ld(mat) == mat->columns && !mat->transposed;
+}
+
 /** 
  *  Seta um elemento na matriz de forma segura <br>
  *  Necessário porque ela é alocada como um bloco de tamanho linhas * colunas.
@@ -75,7 +158,7 @@ static void matrix_set_at(matrix_t *mat, size_t row, size_t column, double value
     assert(!isnan(value));
     assert(isfinite(value));
 
-    pos = (row * mat->columns) + column;
+    pos = matrix_offset(mat, row, column);
 
     mat->elements[pos] = value;
 }
@@ -101,7 +184,7 @@ static double matrix_get_at(const matrix_t *mat, size_t row, size_t column)
     assert(row < mat->rows);
     assert(column < mat->columns);
 
-    pos = (row * mat->columns) + column;
+    pos = matrix_offset(mat, row, column);
 
     return mat->elements[pos];
 }
@@ -136,12 +219,12 @@ static matrix_t *matrix_load_identity(matrix_t *mat)
  */
 static matrix_t *matrix_new(size_t rows, size_t columns)
 {
-    matrix_t *mat = malloc(sizeof(matrix_t));
+    matrix_t *mat = (matrix_t *) malloc(sizeof(matrix_t));
     if (!mat) {
         return NULL;
     }
 
-    mat->elements = malloc(sizeof(double) * (rows * columns));
+    mat->elements = (double *) malloc(sizeof(double) * (rows * columns));
     if (!mat->elements) {
         free(mat);
         return NULL;
@@ -150,19 +233,91 @@ static matrix_t *matrix_new(size_t rows, size_t columns)
     mat->rows = rows;
     mat->columns = columns;
     mat->transposed = 0;
+    mat->ld = 0;
+    mat->order = MATRIX_ROW_MAJOR;
+    mat->borrowed = 0;
+
+    return mat;
+}
+
+/**
+ *  Descreve, em mat, uma matriz guardada em memória de terceiros, sem copiar nem alocar nada.
+ *  @param data Os elementos, que continuam pertencendo ao chamador e devem viver mais que mat.
+ *  @param ld Distância, em elementos, entre o início de duas linhas (ou colunas, em MATRIX_COLUMN_MAJOR);
+ *  0 para a matriz densa.
+ *  @return mat.
+ */
+static matrix_t *matrix_wrap_init(matrix_t *mat, double *data, size_t rows, size_t columns,
+                                  size_t ld, matrix_order_t order)
+{
+    assert(ld == 0 || ld >= (order == MATRIX_COLUMN_MAJOR ? rows : columns));
+
+    mat->elements = data;
+    mat->rows = rows;
+    mat->columns = columns;
+    mat->transposed = 0;
+    mat->ld = ld;
+    mat->order = order;
+    mat->borrowed = 1;
 
     return mat;
 }
 
+/**
+ *  Cria uma matriz sobre memória de terceiros, sem copiá-la nem assumir a sua posse. <br>
+ *  Todas as rotinas operam diretamente sobre data; matrix_free libera só a estrutura.
+ *  @param data Os elementos, que continuam pertencendo ao chamador e devem viver mais que a matriz.
+ *  @param ld Distância, em elementos, entre o início de duas linhas (ou colunas, em MATRIX_COLUMN_MAJOR);
+ *  0 para a matriz densa.
+ *  @return A nova matriz, ou NULL caso falte memória.
+ */
+static matrix_t *matrix_wrap(double *data, size_t rows, size_t columns, size_t ld, matrix_order_t order)
+{
+    matrix_t *mat = (matrix_t *) malloc(sizeof(matrix_t));
+    if (!mat) {
+        return NULL;
+    }
+
+    return matrix_wrap_init(mat, data, rows, columns, ld, order);
+}
+
 /**
  *  Libera uma matriz.
  */
 static void matrix_free(matrix_t *mat)
 {
-    free(mat->elements);
+    if (!mat->borrowed) {
+        free(mat->elements);
+    }
     free(mat);
 }
 
+/**
+ *  Copia mat, em qualquer layout, para dst, densa e linha a linha.
+ *  @param ldd Distância, em elementos, entre o início de duas linhas de dst.
+ */
+static void matrix_pack(const matrix_t * ALC_RESTRICT mat, double * ALC_RESTRICT dst, size_t ldd)
+{
+    size_t ld = matrix_ld(mat);
+    size_t i, j;
+
+    assert(!mat->transposed);
+
+    if (mat->order == MATRIX_ROW_MAJOR) {
+        for (i = 0; i < mat->rows; ++i) {
+            memcpy(dst + i * ldd, mat->elements + i * ld, sizeof(double) * mat->columns);
+        }
+    } else {
+        /* walk the source by columns so that its reads stay contiguous */
+        for (j = 0; j < mat->columns; ++j) {
+            const double *column = mat->elements + j * ld;
+            for (i = 0; i < mat->rows; ++i) {
+                dst[i * ldd + j] = column[i];
+            }
+        }
+    }
+}
+
 /** 
  *  Gera uma cópia funda da matrix fornecida
  *  @param mat A matriz a ser copiada
@@ -184,8 +339,11 @@ static matrix_t *matrix_copy(const matrix_t *mat)
                     matrix_set_at(new_mat, i, j, matrix_get_at(mat, i, j)); 
                 }
             }
-        } else {
+        } else if (matrix_is_dense(mat)) {
             memcpy(new_mat->elements, mat->elements, sizeof(double) * (mat->rows * mat->columns));
+        } else {
+            /* wrapped memory: strided or column-major */
+            matrix_pack(mat, new_mat->elements, new_mat->columns);
         }
     }
 
@@ -217,24 +375,56 @@ static int doublecmp(double a, double b)
     return fabs(a - b) < EPSILON;
 }
 
-static int matrix_cmp(const matrix_t * restrict a, const matrix_t * restrict b)
+static int matrix_row_cmp(const matrix_t * ALC_RESTRICT a, const matrix_t * ALC_RESTRICT b, size_t row)
 {
-    size_t i;
+    size_t j;
+
+    if (matrix_is_dense(a) && matrix_is_dense(b)) {
+        const double *x = a->elements + row * a->columns;
+        const double *y = b->elements + row * b->columns;
+        for (j = 0; j < a->columns; ++j) {
+            if (!doublecmp(x[j], y[j])) {
+                return 0;
+            }
+        }
+        return 1;
+    }
+
+    for (j = 0; j < a->columns; ++j) {
+        if (!doublecmp(matrix_get_at(a, row, j), matrix_get_at(b, row, j))) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static int matrix_cmp(const matrix_t * ALC_RESTRICT a, const matrix_t * ALC_RESTRICT b)
+{
+    size_t first;
 
     if (a->rows != b->rows || a->columns != b->columns) {
         return 0;
     }
 
-    for (i = 0; i < a->rows; ++i) {
-        size_t j;
-        for (j = 0; j < a->columns; ++j) {
-            if (!doublecmp(matrix_get_at(a, i, j), matrix_get_at(b, i, j))) {
+    /* PARALLEL_CHUNKS rows at a time between the threads, stopping after the first batch with a difference */
+    for (first = 0; first < a->rows; first += PARALLEL_CHUNKS) {
+        size_t count = a->rows - first < PARALLEL_CHUNKS ? a->rows - first : PARALLEL_CHUNKS;
+        int equal[PARALLEL_CHUNKS];
+        size_t i;
+
+        PARALLEL_FOR_IF(count * a->columns >= PARALLEL_MIN_WORK)
+        for (i = 0; i < count; ++i) {
+            equal[i] = matrix_row_cmp(a, b, first + i);
+        }
+
+        for (i = 0; i < count; ++i) {
+            if (!equal[i]) {
                 return 0;
             }
         }
     }
 
-
     return 1;
 }
 
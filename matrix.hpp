@@ -0,0 +1,672 @@
+/**
+ *  @file
+ */
+/*
+ * Copyright (c) 2018 Victor Hermann "vitorhnn" Chiletto
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+**/
+
+#ifndef MATRIX_HPP
+#define MATRIX_HPP
+
+/*
+ * RAII wrapper over matrix_t with expression templates (C++17).
+ *
+ * alc::MatrixX owns a matrix_t and frees it on destruction; it can be moved
+ * for free and copied deeply. Arithmetic on matrices builds a lightweight
+ * expression instead of a result:
+ *
+ *  - elementwise chains (sums, differences, scalar products and shifts) are
+ *    evaluated in a single fused loop when assigned, with no temporaries;
+ *  - anything of the form alpha * op(A) * op(B) + beta * C, where op is
+ *    nothing or transpose(), becomes one gemm call writing straight into the
+ *    destination.
+ *
+ * Products nested inside other elementwise expressions are evaluated into one
+ * temporary each. Expressions refer to their operands, so do not keep them
+ * around with auto: assign them to a MatrixX in the same statement.
+ */
+
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include "matrix.h"
+#include "blas.h"
+
+namespace alc {
+
+class MatrixX;
+
+namespace expr {
+
+/** Base de todas as expressões, para restringir os operadores. **/
+template <typename E>
+struct Base {
+};
+
+template <typename E>
+constexpr bool is_expression = std::is_base_of_v<Base<E>, E>;
+
+/**
+ *  Referência a um matrix_t existente.
+ */
+struct Ref : Base<Ref> {
+    const matrix_t *mat;
+
+    std::size_t rows() const { return mat->rows; }
+    std::size_t columns() const { return mat->columns; }
+    double at(std::size_t r, std::size_t c) const { return mat->elements[matrix_offset(mat, r, c)]; }
+    void prepare() const {}
+    bool reads_transposed(const matrix_t *) const { return false; }
+
+    /* gemm operand; column-major storage is the row-major transpose */
+    const double *data() const { return mat->elements; }
+    std::size_t ld() const { return matrix_ld(mat); }
+    int trans() const { return mat->order == MATRIX_COLUMN_MAJOR ? BLAS_TRANS : BLAS_NO_TRANS; }
+    const matrix_t *source() const { return mat; }
+};
+
+/**
+ *  Transposta de um matrix_t existente, sem cópia.
+ */
+struct TransposedRef : Base<TransposedRef> {
+    const matrix_t *mat;
+
+    std::size_t rows() const { return mat->columns; }
+    std::size_t columns() const { return mat->rows; }
+    double at(std::size_t r, std::size_t c) const { return mat->elements[matrix_offset(mat, c, r)]; }
+    void prepare() const {}
+    bool reads_transposed(const matrix_t *m) const { return m == mat; }
+
+    const double *data() const { return mat->elements; }
+    std::size_t ld() const { return matrix_ld(mat); }
+    int trans() const { return mat->order == MATRIX_COLUMN_MAJOR ? BLAS_NO_TRANS : BLAS_TRANS; }
+    const matrix_t *source() const { return mat; }
+};
+
+template <typename E>
+constexpr bool is_terminal = std::is_same_v<E, Ref> || std::is_same_v<E, TransposedRef>;
+
+template <typename E>
+using stored_t = std::conditional_t<std::is_same_v<std::decay_t<E>, MatrixX>, Ref, std::decay_t<E>>;
+
+template <typename E>
+stored_t<E> store(const E &e);
+
+struct Add {
+    static double apply(double a, double b) { return a + b; }
+};
+
+struct Subtract {
+    static double apply(double a, double b) { return a - b; }
+};
+
+/**
+ *  Operação elemento a elemento entre duas expressões do mesmo tamanho.
+ */
+template <typename Op, typename L, typename R>
+struct Binary : Base<Binary<Op, L, R>> {
+    L left;
+    R right;
+
+    Binary(L l, R r) : left(std::move(l)), right(std::move(r))
+    {
+        assert(left.rows() == right.rows() && left.columns() == right.columns());
+    }
+
+    std::size_t rows() const { return left.rows(); }
+    std::size_t columns() const { return left.columns(); }
+    double at(std::size_t r, std::size_t c) const { return Op::apply(left.at(r, c), right.at(r, c)); }
+    void prepare() const { left.prepare(); right.prepare(); }
+    bool reads_transposed(const matrix_t *m) const { return left.reads_transposed(m) || right.reads_transposed(m); }
+};
+
+/**
+ *  scale * e.
+ */
+template <typename E>
+struct Scaled : Base<Scaled<E>> {
+    E inner;
+    double scale;
+
+    Scaled(E e, double s) : inner(std::move(e)), scale(s) {}
+
+    std::size_t rows() const { return inner.rows(); }
+    std::size_t columns() const { return inner.columns(); }
+    double at(std::size_t r, std::size_t c) const { return scale * inner.at(r, c); }
+    void prepare() const { inner.prepare(); }
+    bool reads_transposed(const matrix_t *m) const { return inner.reads_transposed(m); }
+};
+
+/**
+ *  e + shift, somado a todos os elementos.
+ */
+template <typename E>
+struct Shifted : Base<Shifted<E>> {
+    E inner;
+    double shift;
+
+    Shifted(E e, double s) : inner(std::move(e)), shift(s) {}
+
+    std::size_t rows() const { return inner.rows(); }
+    std::size_t columns() const { return inner.columns(); }
+    double at(std::size_t r, std::size_t c) const { return inner.at(r, c) + shift; }
+    void prepare() const { inner.prepare(); }
+    bool reads_transposed(const matrix_t *m) const { return inner.reads_transposed(m); }
+};
+
+/**
+ *  Guarda o resultado de um produto quando ele aparece dentro de outra expressão.
+ */
+struct Cache {
+    mutable matrix_t *mat = nullptr;
+
+    Cache() = default;
+    Cache(const Cache &) : mat(nullptr) {}
+    Cache &operator=(const Cache &) { return *this; }
+    ~Cache() { if (mat != nullptr) matrix_free(mat); }
+};
+
+/**
+ *  Operando de gemm: usa o matrix_t diretamente quando a expressão é terminal e, caso contrário,
+ *  avalia a expressão em uma temporária.
+ */
+template <typename E>
+struct Operand {
+    const double *data;
+    std::size_t ld;
+    int trans;
+    const matrix_t *source;
+    matrix_t *temporary = nullptr;
+
+    explicit Operand(const E &e);
+    Operand(const Operand &) = delete;
+    ~Operand() { if (temporary != nullptr) matrix_free(temporary); }
+};
+
+/**
+ *  alpha * op(A) * op(B).
+ */
+template <typename L, typename R>
+struct Product : Base<Product<L, R>> {
+    L left;
+    R right;
+    double alpha;
+    Cache cache;
+
+    Product(L l, R r, double a) : left(std::move(l)), right(std::move(r)), alpha(a)
+    {
+        assert(left.columns() == right.rows());
+    }
+
+    std::size_t rows() const { return left.rows(); }
+    std::size_t columns() const { return right.columns(); }
+    double at(std::size_t r, std::size_t c) const { return cache.mat->elements[r * cache.mat->columns + c]; }
+    bool reads_transposed(const matrix_t *) const { return false; }
+
+    bool aliases(const matrix_t *m) const
+    {
+        if constexpr (is_terminal<L>) {
+            if (left.source() == m) return true;
+        }
+        if constexpr (is_terminal<R>) {
+            if (right.source() == m) return true;
+        }
+        return false;
+    }
+
+    /** dst = alpha * op(A) * op(B) + beta * dst **/
+    void evaluate_into(double *dst, std::size_t ldd, double beta) const
+    {
+        Operand<L> a(left);
+        Operand<R> b(right);
+        gemm(a.trans, b.trans, rows(), columns(), left.columns(), alpha, a.data, a.ld, b.data, b.ld, beta, dst, ldd);
+    }
+
+    void prepare() const
+    {
+        if (cache.mat == nullptr) {
+            cache.mat = matrix_new(rows(), columns());
+            evaluate_into(cache.mat->elements, columns(), 0);
+        }
+    }
+};
+
+/**
+ *  alpha * op(A) * op(B) + beta * C, avaliada com uma única chamada a gemm.
+ */
+template <typename L, typename R, typename C>
+struct Gemm : Base<Gemm<L, R, C>> {
+    Product<L, R> product;
+    C addend;
+    double beta;
+    Cache cache;
+
+    Gemm(Product<L, R> p, C c, double b) : product(std::move(p)), addend(std::move(c)), beta(b)
+    {
+        assert(product.rows() == addend.rows() && product.columns() == addend.columns());
+    }
+
+    std::size_t rows() const { return product.rows(); }
+    std::size_t columns() const { return product.columns(); }
+    double at(std::size_t r, std::size_t c) const { return cache.mat->elements[r * cache.mat->columns + c]; }
+    bool reads_transposed(const matrix_t *) const { return false; }
+    bool aliases(const matrix_t *m) const { return product.aliases(m) || addend.reads_transposed(m); }
+
+    void evaluate_into(double *dst, std::size_t ldd) const
+    {
+        std::size_t r, c;
+
+        addend.prepare();
+        for (r = 0; r < rows(); ++r) {
+            double *row = dst + r * ldd;
+            for (c = 0; c < columns(); ++c) {
+                row[c] = beta * addend.at(r, c);
+            }
+        }
+
+        product.evaluate_into(dst, ldd, 1);
+    }
+
+    void prepare() const
+    {
+        if (cache.mat == nullptr) {
+            cache.mat = matrix_new(rows(), columns());
+            evaluate_into(cache.mat->elements, columns());
+        }
+    }
+};
+
+template <typename E>
+struct is_product : std::false_type {
+};
+
+template <typename L, typename R>
+struct is_product<Product<L, R>> : std::true_type {
+};
+
+template <typename E>
+struct is_gemm : std::false_type {
+};
+
+template <typename L, typename R, typename C>
+struct is_gemm<Gemm<L, R, C>> : std::true_type {
+};
+
+template <typename E>
+struct is_scaled : std::false_type {
+};
+
+template <typename E>
+struct is_scaled<Scaled<E>> : std::true_type {
+};
+
+} // namespace expr
+
+/**
+ *  Matriz de dimensões dinâmicas, dona de um matrix_t. <br>
+ *  As dimensões fixas ficam em alc::Matrix (fixed_matrix.hpp).
+ */
+class MatrixX : public expr::Base<MatrixX> {
+public:
+    MatrixX() : mat(nullptr) {}
+
+    /** Cria uma matriz rows x columns não inicializada. **/
+    MatrixX(std::size_t rows, std::size_t columns) : mat(matrix_new(rows, columns)) {}
+
+    /** Cria uma matriz rows x columns com todos os elementos iguais a value. **/
+    MatrixX(std::size_t rows, std::size_t columns, double value) : mat(matrix_new(rows, columns))
+    {
+        std::size_t i;
+        for (i = 0; i < rows * columns; ++i) {
+            mat->elements[i] = value;
+        }
+    }
+
+    /** Assume a posse de um matrix_t criado por matrix_new ou matrix_wrap; os elementos de matrix_wrap continuam do chamador. **/
+    explicit MatrixX(matrix_t *owned) : mat(owned) {}
+
+    /** Envolve memória de terceiros, sem copiá-la; atribuições de mesmo tamanho escrevem nela. **/
+    static MatrixX wrap(double *data, std::size_t rows, std::size_t columns, std::size_t ld = 0,
+                        matrix_order_t order = MATRIX_ROW_MAJOR)
+    {
+        return MatrixX(matrix_wrap(data, rows, columns, ld, order));
+    }
+
+    MatrixX(const MatrixX &other) : mat(other.mat != nullptr ? matrix_copy(other.mat) : nullptr) {}
+
+    MatrixX(MatrixX &&other) noexcept : mat(other.mat)
+    {
+        other.mat = nullptr;
+    }
+
+    template <typename E, typename = std::enable_if_t<expr::is_expression<E>>>
+    MatrixX(const E &e) : mat(nullptr)
+    {
+        assign(e);
+    }
+
+    ~MatrixX()
+    {
+        if (mat != nullptr) {
+            matrix_free(mat);
+        }
+    }
+
+    MatrixX &operator=(const MatrixX &other)
+    {
+        if (this != &other) {
+            MatrixX copy(other);
+            std::swap(mat, copy.mat);
+        }
+        return *this;
+    }
+
+    MatrixX &operator=(MatrixX &&other) noexcept
+    {
+        std::swap(mat, other.mat);
+        return *this;
+    }
+
+    template <typename E, typename = std::enable_if_t<expr::is_expression<E>>>
+    MatrixX &operator=(const E &e)
+    {
+        assign(e);
+        return *this;
+    }
+
+    template <typename E, typename = std::enable_if_t<expr::is_expression<E>>>
+    MatrixX &operator+=(const E &e);
+
+    template <typename E, typename = std::enable_if_t<expr::is_expression<E>>>
+    MatrixX &operator-=(const E &e);
+
+    MatrixX &operator*=(double scalar);
+
+    std::size_t rows() const { return mat->rows; }
+    std::size_t columns() const { return mat->columns; }
+
+    double &operator()(std::size_t r, std::size_t c) { return mat->elements[matrix_offset(mat, r, c)]; }
+    double operator()(std::size_t r, std::size_t c) const { return mat->elements[matrix_offset(mat, r, c)]; }
+
+    /* as an expression, a MatrixX is read in place */
+    double at(std::size_t r, std::size_t c) const { return mat->elements[matrix_offset(mat, r, c)]; }
+    void prepare() const {}
+    bool reads_transposed(const matrix_t *) const { return false; }
+
+    matrix_t *get() { return mat; }
+    const matrix_t *get() const { return mat; }
+
+    /** Devolve o matrix_t, que passa a ser do chamador. **/
+    matrix_t *release()
+    {
+        matrix_t *out = mat;
+        mat = nullptr;
+        return out;
+    }
+
+private:
+    matrix_t *mat;
+
+    void reshape(std::size_t rows, std::size_t columns)
+    {
+        if (mat == nullptr || mat->rows != rows || mat->columns != columns) {
+            MatrixX fresh(rows, columns);
+            std::swap(mat, fresh.mat);
+        }
+    }
+
+    /* keeps writing into wrapped memory when the shape allows, instead of replacing it */
+    void adopt(MatrixX &value)
+    {
+        if (mat != nullptr && mat->borrowed && mat->rows == value.rows() && mat->columns == value.columns()) {
+            std::size_t r, c;
+            for (r = 0; r < mat->rows; ++r) {
+                for (c = 0; c < mat->columns; ++c) {
+                    (*this)(r, c) = value(r, c);
+                }
+            }
+        } else {
+            std::swap(mat, value.mat);
+        }
+    }
+
+    template <typename E>
+    void assign(const E &e)
+    {
+        bool aliased;
+
+        if constexpr (expr::is_product<E>::value || expr::is_gemm<E>::value) {
+            aliased = mat != nullptr && e.aliases(mat);
+        } else {
+            aliased = mat != nullptr && e.reads_transposed(mat);
+        }
+
+        /* the kernels below write rows, so column-major destinations go through a temporary too */
+        if (aliased || (mat != nullptr && mat->order != MATRIX_ROW_MAJOR)) {
+            MatrixX value;
+            value.assign(e);
+            adopt(value);
+            return;
+        }
+
+        if constexpr (expr::is_product<E>::value || expr::is_gemm<E>::value) {
+            reshape(e.rows(), e.columns());
+
+            if constexpr (expr::is_product<E>::value) {
+                e.evaluate_into(mat->elements, matrix_ld(mat), 0);
+            } else {
+                e.evaluate_into(mat->elements, matrix_ld(mat));
+            }
+        } else {
+            e.prepare();
+            reshape(e.rows(), e.columns());
+
+            std::size_t r, c;
+            for (r = 0; r < mat->rows; ++r) {
+                double *row = mat->elements + r * matrix_ld(mat);
+                for (c = 0; c < mat->columns; ++c) {
+                    row[c] = e.at(r, c);
+                }
+            }
+        }
+    }
+};
+
+namespace expr {
+
+template <typename E>
+stored_t<E> store(const E &e)
+{
+    if constexpr (std::is_same_v<E, MatrixX>) {
+        return Ref{{}, e.get()};
+    } else {
+        return e;
+    }
+}
+
+template <typename E>
+Operand<E>::Operand(const E &e)
+{
+    if constexpr (is_terminal<E>) {
+        data = e.data();
+        ld = e.ld();
+        trans = e.trans();
+        source = e.source();
+    } else {
+        MatrixX value(e);
+        temporary = value.release();
+        data = temporary->elements;
+        ld = temporary->columns;
+        trans = BLAS_NO_TRANS;
+        source = temporary;
+    }
+}
+
+template <typename L, typename R>
+auto make_product(const L &l, const R &r, double alpha)
+{
+    /* pure scalings of either side are folded into alpha */
+    if constexpr (is_scaled<L>::value) {
+        return make_product(l.inner, r, alpha * l.scale);
+    } else if constexpr (is_scaled<R>::value) {
+        return make_product(l, r.inner, alpha * r.scale);
+    } else {
+        return Product<stored_t<L>, stored_t<R>>(store(l), store(r), alpha);
+    }
+}
+
+template <typename Op, typename L, typename R>
+auto make_sum(const L &l, const R &r)
+{
+    constexpr double sign = std::is_same_v<Op, Add> ? 1 : -1;
+
+    if constexpr (is_product<L>::value && !is_product<R>::value && !is_gemm<R>::value) {
+        if constexpr (is_scaled<R>::value) {
+            return Gemm<decltype(l.left), decltype(l.right), decltype(r.inner)>(l, r.inner, sign * r.scale);
+        } else {
+            return Gemm<decltype(l.left), decltype(l.right), stored_t<R>>(l, store(r), sign);
+        }
+    } else if constexpr (is_product<R>::value && !is_product<L>::value && !is_gemm<L>::value) {
+        auto p = r;
+        p.alpha *= sign;
+        return make_sum<Add>(p, l);
+    } else {
+        return Binary<Op, stored_t<L>, stored_t<R>>(store(l), store(r));
+    }
+}
+
+template <typename E>
+auto make_scaled(const E &e, double s)
+{
+    if constexpr (is_product<E>::value) {
+        auto p = e;
+        p.alpha *= s;
+        return p;
+    } else if constexpr (is_gemm<E>::value) {
+        auto g = e;
+        g.product.alpha *= s;
+        g.beta *= s;
+        return g;
+    } else if constexpr (is_scaled<E>::value) {
+        return Scaled<decltype(e.inner)>(e.inner, e.scale * s);
+    } else {
+        return Scaled<stored_t<E>>(store(e), s);
+    }
+}
+
+template <typename L, typename R>
+using both_expressions = std::enable_if_t<is_expression<L> && is_expression<R>, int>;
+
+template <typename E>
+using expression = std::enable_if_t<is_expression<E>, int>;
+
+} // namespace expr
+
+/**
+ *  Transposta de m, sem cópia; útil principalmente como operando de produtos.
+ */
+inline expr::TransposedRef transpose(const MatrixX &m)
+{
+    return expr::TransposedRef{{}, m.get()};
+}
+
+template <typename L, typename R, expr::both_expressions<L, R> = 0>
+auto operator+(const L &l, const R &r)
+{
+    return expr::make_sum<expr::Add>(l, r);
+}
+
+template <typename L, typename R, expr::both_expressions<L, R> = 0>
+auto operator-(const L &l, const R &r)
+{
+    return expr::make_sum<expr::Subtract>(l, r);
+}
+
+template <typename L, typename R, expr::both_expressions<L, R> = 0>
+auto operator*(const L &l, const R &r)
+{
+    return expr::make_product(l, r, 1.0);
+}
+
+template <typename E, expr::expression<E> = 0>
+auto operator*(const E &e, double s)
+{
+    return expr::make_scaled(e, s);
+}
+
+template <typename E, expr::expression<E> = 0>
+auto operator*(double s, const E &e)
+{
+    return expr::make_scaled(e, s);
+}
+
+template <typename E, expr::expression<E> = 0>
+auto operator/(const E &e, double s)
+{
+    return expr::make_scaled(e, 1 / s);
+}
+
+template <typename E, expr::expression<E> = 0>
+auto operator-(const E &e)
+{
+    return expr::make_scaled(e, -1.0);
+}
+
+template <typename E, expr::expression<E> = 0>
+auto operator+(const E &e, double s)
+{
+    return expr::Shifted<expr::stored_t<E>>(expr::store(e), s);
+}
+
+template <typename E, expr::expression<E> = 0>
+auto operator+(double s, const E &e)
+{
+    return e + s;
+}
+
+template <typename E, expr::expression<E> = 0>
+auto operator-(const E &e, double s)
+{
+    return e + (-s);
+}
+
+template <typename E, typename>
+MatrixX &MatrixX::operator+=(const E &e)
+{
+    return *this = *this + e;
+}
+
+template <typename E, typename>
+MatrixX &MatrixX::operator-=(const E &e)
+{
+    return *this = *this - e;
+}
+
+inline MatrixX &MatrixX::operator*=(double scalar)
+{
+    return *this = *this * scalar;
+}
+
+} // namespace alc
+
+#endif
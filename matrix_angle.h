@@ -28,22 +28,63 @@
 
 #include "matrix.h"
 #include "matrix_norms.h"
+#include "parallel.h"
+#include "blas.h"
+
+/* M_PI is POSIX, not C99, and a strict -std=c99 hides it */
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/**
+ *  Linhas de X tratadas de uma vez pelas rotinas pairwise_*.
+ */
+#ifndef PAIRWISE_BLOCK
+#define PAIRWISE_BLOCK 256
+#endif
 
 /**
- *  Calcula o produto interno entre a linha row e a coluna column de mat
+ *  Linhas de Y comparadas de uma vez por pairwise_nearest, que só guarda um bloco PAIRWISE_BLOCK x PAIRWISE_TILE.
+ */
+#ifndef PAIRWISE_TILE
+#define PAIRWISE_TILE 512
+#endif
+
+/**
+ *  Calcula o produto interno entre a linha row e a coluna column de mat <br>
+ *  Os termos são divididos entre as threads, com o mesmo resultado para qualquer quantidade delas.
  *  @author Andrei Parente
  */
 static double row_column_dot_product(const matrix_t *mat, size_t row, size_t column)
 {
+    double partial[PARALLEL_CHUNKS];
     double product = 0;
-    size_t i;
-    
+    size_t row_stride, column_stride;
+    const double *u, *v;
+    size_t c;
+
     assert(mat->rows == mat->columns);
+    assert(row < mat->rows && column < mat->columns);
 
-    for (i = 0; i < mat->rows; ++i) {
-        product += matrix_get_at(mat, row, i)* matrix_get_at(mat, i, column);
+    matrix_strides(mat, &row_stride, &column_stride);
+    u = mat->elements + row * column_stride;
+    v = mat->elements + column * row_stride;
+
+    PARALLEL_FOR_IF(mat->rows >= PARALLEL_MIN_WORK)
+    for (c = 0; c < PARALLEL_CHUNKS; ++c) {
+        size_t i, end = parallel_chunk_start(mat->rows, c + 1);
+
+        partial[c] = 0;
+        for (i = parallel_chunk_start(mat->rows, c); i < end; ++i) {
+            partial[c] += u[i * row_stride] * v[i * column_stride];
+        }
     }
-    return product; 
+
+    for (c = 0; c < PARALLEL_CHUNKS; ++c) {
+        product += partial[c];
+    }
+
+    return product;
 }
 
 /**
@@ -51,47 +92,23 @@ static double row_column_dot_product(const matrix_t *mat, size_t row, size_t col
  */
 static double vector_length(const matrix_t *vector)
 {
-    size_t i;
-    double accumulator = 0;
-
-    assert(vector->rows == 1);
-    
-    for (i = 0; i < vector->columns; ++i) {
-        accumulator += pow(matrix_get_at(vector, 0, i), 2);
-    }
-
-    return sqrt(accumulator);
+    return vector_norm2(vector);
 }
 
 /**
- *  Calcula o ângulo entre a linha row e a coluna column de mat
+ *  Calcula o ângulo entre a linha row e a coluna column de mat, direto na memória de mat.
  *  @author Andrei Parente
  */
 static double row_column_angle(const matrix_t *mat, size_t row, size_t column)
 {
-    size_t i;
-    double row_length = 0,
-           column_length = 0;
-
-    matrix_t *temp = matrix_new(1, mat->columns);
-    for (i = 0; i < mat->columns; ++i) {
-        matrix_set_at(temp, 0, i, matrix_get_at(mat, row, i));
-    }
-
-    row_length = vector_length(temp);
-    matrix_free(temp);
-
-    temp = matrix_new(1, mat->rows);
-    for (i = 0; i < mat->rows; ++i) {
-        matrix_set_at(temp, 0, i, matrix_get_at(mat, i, column)); 
-    }
+    size_t row_stride, column_stride;
+    double row_length, column_length;
 
-    column_length = vector_length(temp);
-    matrix_free(temp);
+    matrix_strides(mat, &row_stride, &column_stride);
+    row_length = norm2_strided(mat->columns, mat->elements + row * column_stride, row_stride);
+    column_length = norm2_strided(mat->rows, mat->elements + column * row_stride, column_stride);
 
-    double angle = row_column_dot_product(mat, row, column) / (row_length * column_length);
-
-    return acos(angle);
+    return acos(row_column_dot_product(mat, row, column) / (row_length * column_length));
 }
 
 /**
@@ -101,9 +118,9 @@ static double row_column_angle(const matrix_t *mat, size_t row, size_t column)
  *
  *  @author Pedro da Luz
  */
-static double vector_distance_vector(const matrix_t * restrict u, const matrix_t * restrict v)
+static double vector_distance_vector(const matrix_t * ALC_RESTRICT u, const matrix_t * ALC_RESTRICT v)
 {
-    double accumulator;
+    double accumulator = 0;
 
     size_t i;
 
@@ -125,7 +142,7 @@ static double vector_distance_vector(const matrix_t * restrict u, const matrix_t
  *
  *  @author Pedro da Luz
  */
-static double vector_angle_vector(const matrix_t * restrict u, const matrix_t * restrict v)
+static double vector_angle_vector(const matrix_t * ALC_RESTRICT u, const matrix_t * ALC_RESTRICT v)
 {
     double angle;
 
@@ -154,13 +171,399 @@ static double vector_angle_vector(const matrix_t * restrict u, const matrix_t *
  *
  *  @author Pedro da Luz
  */
-static double vector_innerProductSpace(const matrix_t * restrict u, const matrix_t * restrict v)
+static double vector_innerProductSpace(const matrix_t * ALC_RESTRICT u, const matrix_t * ALC_RESTRICT v)
 {
-    double innner_product_space;
+    double innner_product_space = 0;
 
-    innner_product_space = (vector_norm2(u) * vector_norm2(v)) * cos(vector_angle_vector(u, v) * (M_PI/180));
-    
-    return innner_product_space;    
+    size_t i;
+
+    assert(u->rows == 1);
+    assert(v->rows == 1);
+    assert(u->columns == v->columns);
+
+    for(i = 0; i < u->columns; i++)
+        innner_product_space += matrix_get_at(u, 0, i) * matrix_get_at(v, 0, i);
+
+    return innner_product_space;
+}
+
+/**
+ *  Medida usada por pairwise_nearest.
+ */
+typedef enum {
+    /** Distância euclidiana; os vizinhos mais próximos têm as menores. **/
+    PAIRWISE_EUCLIDEAN = 0,
+    /** Similaridade de cosseno; os vizinhos mais próximos têm as maiores. **/
+    PAIRWISE_COSINE = 1
+} pairwise_metric_t;
+
+/**
+ *  Normas euclidianas das linhas de mat, em qualquer layout, sem overflow nem underflow.
+ */
+static void pairwise_row_norms(const matrix_t *mat, double *norms)
+{
+    size_t ld = matrix_ld(mat);
+    size_t i;
+
+    for (i = 0; i < mat->rows; ++i) {
+        norms[i] = mat->order == MATRIX_ROW_MAJOR ? norm2_array(mat->columns, mat->elements + i * ld)
+                                                  : norm2_strided(mat->columns, mat->elements + i, ld);
+    }
+}
+
+/**
+ *  Calcula o bloco das linhas [x, x + rows) de X contra as linhas [y, y + columns) de Y em C,
+ *  com um gemm e as normas já calculadas.
+ */
+static void pairwise_block(pairwise_metric_t metric, const matrix_t *X, const double *xnorms, size_t x, size_t rows,
+                           const matrix_t *Y, const double *ynorms, size_t y, size_t columns, double *C, size_t ldc)
+{
+    size_t i;
+
+    /* a column-major operand is its transpose stored by rows, so only the gemm flags change */
+    gemm(X->order == MATRIX_COLUMN_MAJOR ? BLAS_TRANS : BLAS_NO_TRANS,
+         Y->order == MATRIX_COLUMN_MAJOR ? BLAS_NO_TRANS : BLAS_TRANS, rows, columns, X->columns,
+         metric == PAIRWISE_EUCLIDEAN ? -2 : 1, X->elements + matrix_offset(X, x, 0), matrix_ld(X),
+         Y->elements + matrix_offset(Y, y, 0), matrix_ld(Y), 0, C, ldc);
+
+    PARALLEL_FOR_IF(rows * columns >= PARALLEL_MIN_WORK)
+    for (i = 0; i < rows; ++i) {
+        double *c = C + i * ldc;
+        double xnorm = xnorms[x + i];
+        size_t j;
+
+        if (metric == PAIRWISE_EUCLIDEAN) {
+            /* ||x||^2 + ||y||^2 - 2 x.y, which cancellation can push slightly below zero */
+            for (j = 0; j < columns; ++j) {
+                double ynorm = ynorms[y + j];
+                double square = xnorm * xnorm + ynorm * ynorm + c[j];
+                c[j] = square > 0 ? sqrt(square) : 0;
+            }
+        } else {
+            for (j = 0; j < columns; ++j) {
+                double scale = xnorm * ynorms[y + j];
+                c[j] = scale > 0 ? c[j] / scale : 0;
+            }
+        }
+    }
+}
+
+static matrix_t *pairwise_matrix(pairwise_metric_t metric, const matrix_t *X, const matrix_t *Y)
+{
+    double *xnorms, *ynorms;
+    matrix_t *result;
+    size_t x;
+
+    assert(!X->transposed && !Y->transposed);
+    assert(X->columns == Y->columns);
+
+    result = matrix_new(X->rows, Y->rows);
+    xnorms = (double *) malloc(sizeof(double) * (X->rows + Y->rows + 1));
+
+    if (result == NULL || xnorms == NULL) {
+        free(xnorms);
+        if (result != NULL) {
+            matrix_free(result);
+        }
+        return NULL;
+    }
+
+    ynorms = xnorms + X->rows;
+    pairwise_row_norms(X, xnorms);
+    pairwise_row_norms(Y, ynorms);
+
+    /* a block of rows at a time, so that the fix up reads what gemm just wrote while it is still in cache */
+    for (x = 0; x < X->rows; x += PAIRWISE_BLOCK) {
+        size_t rows = X->rows - x < PAIRWISE_BLOCK ? X->rows - x : PAIRWISE_BLOCK;
+        pairwise_block(metric, X, xnorms, x, rows, Y, ynorms, 0, Y->rows, result->elements + x * Y->rows, Y->rows);
+    }
+
+    free(xnorms);
+
+    return result;
+}
+
+/**
+ *  Calcula a distância euclidiana entre cada linha de X e cada linha de Y, como ||x||^2 + ||y||^2 - 2 X Y^T. <br>
+ *  O produto X Y^T é feito por gemm, em blocos de PAIRWISE_BLOCK linhas de X. Distâncias muito menores que as normas
+ *  perdem precisão relativa na subtração.
+ *  @return Matriz X->rows x Y->rows, ou NULL caso falte memória.
+ */
+static matrix_t *pairwise_distance(const matrix_t *X, const matrix_t *Y)
+{
+    return pairwise_matrix(PAIRWISE_EUCLIDEAN, X, Y);
+}
+
+/**
+ *  Calcula a similaridade de cosseno entre cada linha de X e cada linha de Y, com um gemm e as normas das linhas. <br>
+ *  Linhas nulas têm similaridade 0 com todas as outras.
+ *  @return Matriz X->rows x Y->rows, ou NULL caso falte memória.
+ */
+static matrix_t *pairwise_cosine(const matrix_t *X, const matrix_t *Y)
+{
+    return pairwise_matrix(PAIRWISE_COSINE, X, Y);
+}
+
+/**
+ *  Troca o topo do max-heap (key, index) de count elementos e o desce até seu lugar; empates vão pelo índice.
+ */
+static void pairwise_heap_down(double *key, size_t *index, size_t count, size_t at)
+{
+    for (;;) {
+        size_t child = 2 * at + 1;
+        size_t largest = at;
+        double swap_key;
+        size_t swap_index;
+
+        if (child < count && (key[child] > key[largest] || (key[child] == key[largest] && index[child] > index[largest]))) {
+            largest = child;
+        }
+        child++;
+        if (child < count && (key[child] > key[largest] || (key[child] == key[largest] && index[child] > index[largest]))) {
+            largest = child;
+        }
+
+        if (largest == at) {
+            return;
+        }
+
+        swap_key = key[at];
+        key[at] = key[largest];
+        key[largest] = swap_key;
+        swap_index = index[at];
+        index[at] = index[largest];
+        index[largest] = swap_index;
+        at = largest;
+    }
+}
+
+/**
+ *  Encontra, para cada linha de X, as k linhas mais próximas de Y. <br>
+ *  Y é percorrida em blocos de PAIRWISE_TILE linhas, e cada linha de X mantém um heap com seus k melhores
+ *  candidatos, então a memória é O(k X->rows) mais um bloco, nunca a matriz X->rows x Y->rows inteira.
+ *  @param k Vizinhos por linha, no máximo Y->rows.
+ *  @param indices Recebe, alocado com malloc, os índices em Y dos vizinhos, k por linha de X.
+ *  @return Matriz X->rows x k com as distâncias (crescentes) ou similaridades (decrescentes) dos vizinhos,
+ *  ou NULL (e *indices NULL) caso falte memória.
+ */
+static matrix_t *pairwise_nearest(const matrix_t *X, const matrix_t *Y, size_t k, pairwise_metric_t metric,
+                                  size_t **indices)
+{
+    size_t m = X->rows;
+    double sign = metric == PAIRWISE_EUCLIDEAN ? 1 : -1;
+    double *xnorms, *ynorms, *tile;
+    matrix_t *result;
+    size_t *best;
+    size_t x, y, i;
+
+    assert(!X->transposed && !Y->transposed);
+    assert(X->columns == Y->columns);
+    assert(k <= Y->rows);
+
+    result = matrix_new(m, k);
+    best = (size_t *) malloc(sizeof(size_t) * (m * k + 1));
+    xnorms = (double *) malloc(sizeof(double) * (m + Y->rows + 1));
+    tile = (double *) malloc(sizeof(double) * PAIRWISE_BLOCK * PAIRWISE_TILE);
+
+    *indices = NULL;
+
+    if (result == NULL || best == NULL || xnorms == NULL || tile == NULL) {
+        free(tile);
+        free(xnorms);
+        free(best);
+        if (result != NULL) {
+            matrix_free(result);
+        }
+        return NULL;
+    }
+
+    ynorms = xnorms + m;
+    pairwise_row_norms(X, xnorms);
+    pairwise_row_norms(Y, ynorms);
+
+    if (k == 0) {
+        free(tile);
+        free(xnorms);
+        *indices = best;
+        return result;
+    }
+
+    /* heaps keyed so that the worst kept candidate is on top: distances, or similarities negated */
+    for (x = 0; x < m; x += PAIRWISE_BLOCK) {
+        size_t rows = m - x < PAIRWISE_BLOCK ? m - x : PAIRWISE_BLOCK;
+
+        for (y = 0; y < Y->rows; y += PAIRWISE_TILE) {
+            size_t columns = Y->rows - y < PAIRWISE_TILE ? Y->rows - y : PAIRWISE_TILE;
+
+            pairwise_block(metric, X, xnorms, x, rows, Y, ynorms, y, columns, tile, columns);
+
+            PARALLEL_FOR_IF(rows * columns >= PARALLEL_MIN_WORK)
+            for (i = 0; i < rows; ++i) {
+                double *key = result->elements + (x + i) * k;
+                size_t *index = best + (x + i) * k;
+                const double *row = tile + i * columns;
+                size_t j = 0;
+
+                /* the first k candidates of the row fill its heap */
+                for (; y + j < k && j < columns; ++j) {
+                    size_t at = y + j;
+                    key[at] = sign * row[j];
+                    index[at] = y + j;
+                    if (at == k - 1) {
+                        size_t parent;
+                        for (parent = k / 2; parent-- > 0;) {
+                            pairwise_heap_down(key, index, k, parent);
+                        }
+                    }
+                }
+
+                for (; j < columns; ++j) {
+                    double candidate = sign * row[j];
+                    if (candidate < key[0]) {
+                        key[0] = candidate;
+                        index[0] = y + j;
+                        pairwise_heap_down(key, index, k, 0);
+                    }
+                }
+            }
+        }
+    }
+
+    free(tile);
+    free(xnorms);
+
+    /* heapsort each row into increasing keys and undo the sign */
+    PARALLEL_FOR_IF(m * k >= PARALLEL_MIN_WORK)
+    for (i = 0; i < m; ++i) {
+        double *key = result->elements + i * k;
+        size_t *index = best + i * k;
+        size_t count, j;
+
+        for (count = k; count-- > 1;) {
+            double swap_key = key[0];
+            size_t swap_index = index[0];
+            key[0] = key[count];
+            index[0] = index[count];
+            key[count] = swap_key;
+            index[count] = swap_index;
+            pairwise_heap_down(key, index, count, 0);
+        }
+
+        for (j = 0; j < k; ++j) {
+            key[j] *= sign;
+        }
+    }
+
+    *indices = best;
+
+    return result;
+}
+
+/**
+ *  Descreve em view a transposta de mat, sobre a mesma memória.
+ */
+static matrix_t *angle_transpose_view(const matrix_t *mat, matrix_t *view)
+{
+    assert(!mat->transposed);
+
+    return matrix_wrap_init(view, mat->elements, mat->columns, mat->rows, matrix_ld(mat),
+                            mat->order == MATRIX_ROW_MAJOR ? MATRIX_COLUMN_MAJOR : MATRIX_ROW_MAJOR);
+}
+
+/**
+ *  Troca, em cosines, cada cosseno pelo ângulo correspondente.
+ *  @return cosines.
+ */
+static matrix_t *angle_from_cosines(matrix_t *cosines)
+{
+    size_t count, i;
+
+    if (cosines == NULL) {
+        return NULL;
+    }
+
+    count = cosines->rows * cosines->columns;
+
+    PARALLEL_FOR_IF(count >= PARALLEL_MIN_WORK)
+    for (i = 0; i < count; ++i) {
+        /* rounding can leave a cosine just outside [-1, 1] */
+        double cosine = cosines->elements[i];
+        cosines->elements[i] = acos(cosine > 1 ? 1 : cosine < -1 ? -1 : cosine);
+    }
+
+    return cosines;
+}
+
+/**
+ *  Calcula a tabela de ângulos, em radianos, entre cada linha i e cada coluna j de mat, em uma única passada. <br>
+ *  Cada norma de linha e de coluna é calculada uma vez, e os produtos internos saem de um gemm
+ *  direto sobre a memória de mat, sem cópias. Linhas ou colunas nulas fazem ângulo de pi / 2 com todas.
+ *  @return Matriz n x n com o ângulo entre a linha i e a coluna j na posição (i, j), ou NULL caso falte memória.
+ */
+static matrix_t *row_column_angles(const matrix_t *mat)
+{
+    matrix_t view;
+
+    assert(mat->rows == mat->columns);
+
+    return angle_from_cosines(pairwise_cosine(mat, angle_transpose_view(mat, &view)));
+}
+
+/**
+ *  Calcula a tabela de ângulos, em radianos, entre cada par de linhas de mat, como row_column_angles.
+ *  @return Matriz rows x rows, ou NULL caso falte memória.
+ */
+static matrix_t *row_angles(const matrix_t *mat)
+{
+    return angle_from_cosines(pairwise_cosine(mat, mat));
+}
+
+/**
+ *  Calcula a tabela de produtos internos entre cada linha i e cada coluna j de mat, isto é, mat * mat,
+ *  com um gemm direto sobre a memória de mat.
+ *  @return Matriz n x n, ou NULL caso falte memória.
+ */
+static matrix_t *row_column_dot_products(const matrix_t *mat)
+{
+    size_t n = mat->rows;
+    int trans = mat->order == MATRIX_COLUMN_MAJOR ? BLAS_TRANS : BLAS_NO_TRANS;
+    matrix_t *result;
+
+    assert(!mat->transposed);
+    assert(mat->rows == mat->columns);
+
+    result = matrix_new(n, n);
+    if (result == NULL) {
+        return NULL;
+    }
+
+    gemm(trans, trans, n, n, n, 1, mat->elements, matrix_ld(mat), mat->elements, matrix_ld(mat), 0, result->elements, n);
+
+    return result;
+}
+
+/**
+ *  Calcula a tabela de produtos internos entre cada par de linhas de mat, isto é, mat * mat^T,
+ *  com um gemm direto sobre a memória de mat.
+ *  @return Matriz rows x rows, ou NULL caso falte memória.
+ */
+static matrix_t *row_dot_products(const matrix_t *mat)
+{
+    size_t m = mat->rows;
+    int column_major = mat->order == MATRIX_COLUMN_MAJOR;
+    matrix_t *result;
+
+    assert(!mat->transposed);
+
+    result = matrix_new(m, m);
+    if (result == NULL) {
+        return NULL;
+    }
+
+    gemm(column_major ? BLAS_TRANS : BLAS_NO_TRANS, column_major ? BLAS_NO_TRANS : BLAS_TRANS, m, m, mat->columns, 1,
+         mat->elements, matrix_ld(mat), mat->elements, matrix_ld(mat), 0, result->elements, m);
+
+    return result;
 }
 
 #endif
@@ -28,6 +28,8 @@
 #define MATRIX_INVERSE_H
 
 #include "matrix.h"
+#include "blas.h"
+#include "lu.h"
 
 //funçao auxiliar para calcular a inversa
 static void troca_linha(matrix_t *mat, size_t l, size_t i)
@@ -120,4 +122,148 @@ static matrix_t *matrix_inverse(matrix_t *mat)
     return inv;
 }
 
+/**
+ *  Inverte, no próprio lugar, a matriz triangular superior U de ordem n (como o DTRTRI do LAPACK). <br>
+ *  As colunas são processadas em blocos de LU_BLOCK, e o grosso do trabalho é feito por gemm.
+ *  @param lda Distância entre o início de duas linhas consecutivas de U.
+ *  @return 0, ou -1 caso U tenha um zero na diagonal (U fica inalterada).
+ */
+static int upper_triangular_invert(size_t n, double *U, size_t lda)
+{
+    size_t j;
+
+    for (j = 0; j < n; ++j) {
+        if (U[j * lda + j] == 0) {
+            return -1;
+        }
+    }
+
+    for (j = 0; j < n; j += LU_BLOCK) {
+        size_t jb = n - j < LU_BLOCK ? n - j : LU_BLOCK;
+        double *diagonal = U + j * lda + j;
+        size_t i;
+
+        /* rows 0:j of the block column: inv(U11) * U12 * -inv(U22) */
+        trmm_left_upper(j, jb, U, lda, U + j, lda);
+        for (i = 0; i < j; ++i) {
+            size_t c;
+            for (c = 0; c < jb; ++c) {
+                U[i * lda + j + c] = -U[i * lda + j + c];
+            }
+        }
+        trsm_right_upper(j, jb, diagonal, lda, U + j, lda);
+
+        /* the diagonal block itself, column by column, reusing the inverted part to its left */
+        for (i = 0; i < jb; ++i) {
+            double inverse = 1 / diagonal[i * lda + i];
+            size_t r;
+
+            diagonal[i * lda + i] = inverse;
+
+            for (r = 0; r < i; ++r) {
+                double sum = 0;
+                size_t p;
+                for (p = r; p < i; ++p) {
+                    sum += diagonal[r * lda + p] * diagonal[p * lda + i];
+                }
+                diagonal[r * lda + i] = -sum * inverse;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ *  Transforma, no próprio lugar, a fatoração de lu_factor na inversa de A (como o DGETRI do LAPACK). <br>
+ *  U é invertida por upper_triangular_invert e então inv(A) * L = inv(U) é resolvido em blocos de
+ *  colunas com gemm. Usa somente n * LU_BLOCK elementos de memória extra.
+ *  @return 0, ou -1 caso a fatoração seja singular (LU fica inalterada).
+ */
+static int lu_invert(matrix_t *LU, const size_t *pivots)
+{
+    size_t n = LU->rows;
+    size_t ld = matrix_ld(LU);
+    double *a = LU->elements;
+    double *work;
+    size_t j;
+
+    assert(LU->order == MATRIX_ROW_MAJOR);
+
+    if (upper_triangular_invert(n, a, ld) != 0) {
+        return -1;
+    }
+
+    if (n == 0) {
+        return 0;
+    }
+
+    work = malloc(sizeof(double) * n * (n < LU_BLOCK ? n : LU_BLOCK));
+
+    for (j = ((n - 1) / LU_BLOCK) * LU_BLOCK; j < n; j -= LU_BLOCK) {
+        size_t jb = n - j < LU_BLOCK ? n - j : LU_BLOCK;
+        size_t i, c;
+
+        /* move the strictly lower part of L's block column into work, leaving inv(U) in a */
+        for (i = 0; i < n; ++i) {
+            for (c = 0; c < jb; ++c) {
+                if (i > j + c) {
+                    work[i * jb + c] = a[i * ld + j + c];
+                    a[i * ld + j + c] = 0;
+                } else {
+                    work[i * jb + c] = i == j + c ? 1 : 0;
+                }
+            }
+        }
+
+        if (j + jb < n) {
+            gemm(BLAS_NO_TRANS, BLAS_NO_TRANS, n, jb, n - j - jb,
+                 -1, a + j + jb, ld, work + (j + jb) * jb, jb, 1, a + j, ld);
+        }
+
+        trsm_right_lower_unit(n, jb, work + j * jb, jb, a + j, ld);
+    }
+
+    free(work);
+
+    /* undo the row interchanges of the factorization as column interchanges, in reverse */
+    for (j = n; j-- > 0;) {
+        size_t p = pivots[j];
+        if (p != j) {
+            size_t i;
+            for (i = 0; i < n; ++i) {
+                double swap = a[i * ld + j];
+                a[i * ld + j] = a[i * ld + p];
+                a[i * ld + p] = swap;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ *  Calcula a inversa de mat por fatoração LU com pivoteamento parcial. <br>
+ *  Ao contrário de matrix_inverse, mat não é alterada e matrizes singulares são reportadas.
+ *  @return A inversa de mat, ou NULL caso mat seja singular.
+ */
+static matrix_t *matrix_inverse_lu(const matrix_t *mat)
+{
+    size_t *pivots;
+    matrix_t *inv = lu_factor(mat, &pivots);
+
+    if (inv == NULL) {
+        return NULL;
+    }
+
+    if (lu_invert(inv, pivots) != 0) {
+        matrix_free(inv);
+        inv = NULL;
+    }
+
+    free(pivots);
+
+    return inv;
+}
+
 #endif
@@ -0,0 +1,422 @@
+/**
+ *  @file
+ */
+/*
+ * Copyright (c) 2018 Victor Hermann "vitorhnn" Chiletto
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+**/
+
+#ifndef MATRIX_IO_H
+#define MATRIX_IO_H
+
+/*
+ * Binary matrix files.
+ *
+ * A file is a 64-byte header followed, at data_offset, by the raw elements
+ * in native byte order, densely packed in the stored order (row- or
+ * column-major):
+ *
+ *     offset  size  field
+ *          0     8  magic "ALCMATRX"
+ *          8     4  byte_order, 0x01020304 as written by the producer
+ *         12     4  version, MATRIX_FILE_VERSION
+ *         16     4  dtype, MATRIX_FILE_FLOAT64 or MATRIX_FILE_FLOAT32
+ *         20     4  order, a matrix_order_t
+ *         24     8  rows
+ *         32     8  columns
+ *         40     8  data_offset, a multiple of alignment
+ *         48     8  alignment
+ *         56     8  reserved, zero
+ *
+ * Because the data is aligned and uncompressed, matrix_map can point a
+ * matrix_t straight at the file's pages: opening costs one mmap however big
+ * the matrix is, and the kernel reads pages in as they are first touched.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "matrix.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MATRIX_IO_MMAP 1
+#else
+#define MATRIX_IO_MMAP 0
+#endif
+
+/** Versão do formato escrita por matrix_save. **/
+#define MATRIX_FILE_VERSION 1
+/** Elementos double. **/
+#define MATRIX_FILE_FLOAT64 1
+/** Elementos float. **/
+#define MATRIX_FILE_FLOAT32 2
+
+/**
+ *  Alinhamento, em bytes, do início dos dados nos arquivos escritos por matrix_save.
+ */
+#ifndef MATRIX_FILE_ALIGNMENT
+#define MATRIX_FILE_ALIGNMENT 64
+#endif
+
+/**
+ *  Cabeçalho de um arquivo de matriz; 64 bytes, sem preenchimento.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t byte_order;
+    uint32_t version;
+    uint32_t dtype;
+    uint32_t order;
+    uint64_t rows;
+    uint64_t columns;
+    uint64_t data_offset;
+    uint64_t alignment;
+    uint64_t reserved;
+} matrix_file_header_t;
+
+/**
+ *  Matriz carregada por matrix_map; mat vem primeiro para que o matrix_t entregue aponte para ela.
+ */
+typedef struct {
+    matrix_t mat;
+    /** Início do mapeamento, ou NULL se os elementos foram lidos para a memória. **/
+    void *base;
+    size_t length;
+} matrix_mapping_t;
+
+static uint32_t matrix_file_swap32(uint32_t v)
+{
+    return (v >> 24) | ((v >> 8) & 0xff00u) | ((v << 8) & 0xff0000u) | (v << 24);
+}
+
+static uint64_t matrix_file_swap64(uint64_t v)
+{
+    return ((uint64_t) matrix_file_swap32((uint32_t) v) << 32) | matrix_file_swap32((uint32_t) (v >> 32));
+}
+
+/**
+ *  Lê e valida o cabeçalho de f, inclusive se as dimensões cabem em size_t e se o arquivo
+ *  tem todos os elementos que anuncia.
+ *  @param swapped Recebe 1 se o arquivo foi escrito com a ordem de bytes oposta à desta máquina.
+ *  @return 0, ou -1 caso f não seja um arquivo de matriz válido.
+ */
+static int matrix_file_read_header(FILE *f, matrix_file_header_t *header, int *swapped)
+{
+    uint64_t count, element;
+    long size;
+
+    if (fread(header, sizeof(*header), 1, f) != 1 || memcmp(header->magic, "ALCMATRX", 8) != 0) {
+        return -1;
+    }
+
+    *swapped = header->byte_order != 0x01020304u;
+
+    if (*swapped) {
+        if (matrix_file_swap32(header->byte_order) != 0x01020304u) {
+            return -1;
+        }
+        header->version = matrix_file_swap32(header->version);
+        header->dtype = matrix_file_swap32(header->dtype);
+        header->order = matrix_file_swap32(header->order);
+        header->rows = matrix_file_swap64(header->rows);
+        header->columns = matrix_file_swap64(header->columns);
+        header->data_offset = matrix_file_swap64(header->data_offset);
+        header->alignment = matrix_file_swap64(header->alignment);
+    }
+
+    if (header->version != MATRIX_FILE_VERSION ||
+        (header->dtype != MATRIX_FILE_FLOAT64 && header->dtype != MATRIX_FILE_FLOAT32) ||
+        (header->order != MATRIX_ROW_MAJOR && header->order != MATRIX_COLUMN_MAJOR) ||
+        header->data_offset < sizeof(*header)) {
+        return -1;
+    }
+
+    /* data_offset plus rows * columns doubles, which matrix_load allocates even for floats, must fit in size_t */
+    element = header->dtype == MATRIX_FILE_FLOAT64 ? sizeof(double) : sizeof(float);
+    if ((uint64_t) SIZE_MAX < header->rows || (uint64_t) SIZE_MAX < header->columns ||
+        (uint64_t) SIZE_MAX < header->data_offset ||
+        (header->columns != 0 && header->rows > (uint64_t) SIZE_MAX / header->columns)) {
+        return -1;
+    }
+    count = header->rows * header->columns;
+    if (count > ((uint64_t) SIZE_MAX - header->data_offset) / sizeof(double)) {
+        return -1;
+    }
+
+    /* a truncated or lying header must not make matrix_load allocate, or matrix_map map, past the data */
+    if (fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) < 0 ||
+        (uint64_t) size < header->data_offset || ((uint64_t) size - header->data_offset) / element < count) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ *  Grava mat em path no formato binário, com elementos do tipo dtype. <br>
+ *  O layout de mat é preservado: matrizes coluna a coluna são gravadas coluna a coluna.
+ *  @param dtype MATRIX_FILE_FLOAT64 ou MATRIX_FILE_FLOAT32.
+ *  @return 0, ou -1 caso a escrita falhe.
+ */
+static int matrix_save_as(const matrix_t *mat, const char *path, uint32_t dtype)
+{
+    matrix_file_header_t header;
+    static const char padding[MATRIX_FILE_ALIGNMENT];
+    size_t ld = matrix_ld(mat);
+    size_t lines, length, i;
+    float *converted = NULL;
+    FILE *f;
+    int ok;
+
+    assert(!mat->transposed);
+    assert(dtype == MATRIX_FILE_FLOAT64 || dtype == MATRIX_FILE_FLOAT32);
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "ALCMATRX", 8);
+    header.byte_order = 0x01020304u;
+    header.version = MATRIX_FILE_VERSION;
+    header.dtype = dtype;
+    header.order = mat->order;
+    header.rows = mat->rows;
+    header.columns = mat->columns;
+    header.alignment = MATRIX_FILE_ALIGNMENT;
+    header.data_offset = (sizeof(header) + MATRIX_FILE_ALIGNMENT - 1) / MATRIX_FILE_ALIGNMENT * MATRIX_FILE_ALIGNMENT;
+
+    /* a line is a row, or a column for column-major storage */
+    lines = mat->order == MATRIX_COLUMN_MAJOR ? mat->columns : mat->rows;
+    length = mat->order == MATRIX_COLUMN_MAJOR ? mat->rows : mat->columns;
+
+    f = fopen(path, "wb");
+    if (f == NULL) {
+        return -1;
+    }
+
+    ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+         fwrite(padding, 1, header.data_offset - sizeof(header), f) == header.data_offset - sizeof(header);
+
+    if (dtype == MATRIX_FILE_FLOAT32) {
+        converted = (float *) malloc(sizeof(float) * (length ? length : 1));
+        ok = ok && converted != NULL;
+    }
+
+    for (i = 0; ok && i < lines; ++i) {
+        const double *line = mat->elements + i * ld;
+
+        if (converted != NULL) {
+            size_t j;
+            for (j = 0; j < length; ++j) {
+                converted[j] = (float) line[j];
+            }
+            ok = fwrite(converted, sizeof(float), length, f) == length;
+        } else {
+            ok = fwrite(line, sizeof(double), length, f) == length;
+        }
+    }
+
+    free(converted);
+
+    if (fclose(f) != 0) {
+        ok = 0;
+    }
+
+    return ok ? 0 : -1;
+}
+
+/**
+ *  Grava mat em path no formato binário, em precisão dupla.
+ *  @return 0, ou -1 caso a escrita falhe.
+ */
+static int matrix_save(const matrix_t *mat, const char *path)
+{
+    return matrix_save_as(mat, path, MATRIX_FILE_FLOAT64);
+}
+
+/**
+ *  Lê para a memória uma matriz gravada por matrix_save, convertendo float e a ordem de bytes se preciso. <br>
+ *  O layout gravado é mantido.
+ *  @return A matriz, ou NULL caso o arquivo não possa ser lido.
+ */
+static matrix_t *matrix_load(const char *path)
+{
+    matrix_file_header_t header;
+    matrix_t *mat = NULL;
+    size_t count, i;
+    int swapped;
+    FILE *f = fopen(path, "rb");
+
+    if (f == NULL) {
+        return NULL;
+    }
+
+    if (matrix_file_read_header(f, &header, &swapped) != 0 || fseek(f, (long) header.data_offset, SEEK_SET) != 0) {
+        fclose(f);
+        return NULL;
+    }
+
+    count = (size_t) (header.rows * header.columns);
+    mat = matrix_new((size_t) header.rows, (size_t) header.columns);
+    if (mat == NULL) {
+        fclose(f);
+        return NULL;
+    }
+    mat->order = (matrix_order_t) header.order;
+
+    if (header.dtype == MATRIX_FILE_FLOAT64) {
+        if (fread(mat->elements, sizeof(double), count, f) != count) {
+            matrix_free(mat);
+            mat = NULL;
+        } else if (swapped) {
+            uint64_t *raw = (uint64_t *) mat->elements;
+            for (i = 0; i < count; ++i) {
+                raw[i] = matrix_file_swap64(raw[i]);
+            }
+        }
+    } else {
+        /* widen in place from the back, where the floats were read */
+        float *narrow = (float *) mat->elements + count;
+        if (fread(narrow, sizeof(float), count, f) != count) {
+            matrix_free(mat);
+            mat = NULL;
+        } else {
+            for (i = 0; i < count; ++i) {
+                uint32_t bits;
+                float value;
+
+                memcpy(&bits, narrow + i, sizeof(bits));
+                if (swapped) {
+                    bits = matrix_file_swap32(bits);
+                }
+                memcpy(&value, &bits, sizeof(value));
+                mat->elements[i] = value;
+            }
+        }
+    }
+
+    fclose(f);
+
+    return mat;
+}
+
+/**
+ *  Abre uma matriz gravada por matrix_save sem copiá-la: os elementos apontam direto para as páginas
+ *  do arquivo, que só são lidas quando acessadas. <br>
+ *  Arquivos em float ou com outra ordem de bytes, e sistemas sem mmap, recaem em matrix_load,
+ *  exceto com writable, já que uma cópia em memória não levaria as alterações ao arquivo.
+ *  @param writable 1 para que alterações nos elementos sejam gravadas no arquivo; com 0 elas ficam só na memória.
+ *  @return A matriz, que deve ser liberada com matrix_unmap, ou NULL caso o arquivo não possa ser aberto
+ *  (ou mapeado, com writable).
+ */
+static matrix_t *matrix_map(const char *path, int writable)
+{
+    matrix_mapping_t *mapping = (matrix_mapping_t *) malloc(sizeof(matrix_mapping_t));
+    matrix_file_header_t header;
+    int swapped;
+    FILE *f;
+
+    if (mapping == NULL) {
+        return NULL;
+    }
+
+    f = fopen(path, "rb");
+    if (f == NULL || matrix_file_read_header(f, &header, &swapped) != 0) {
+        if (f != NULL) {
+            fclose(f);
+        }
+        free(mapping);
+        return NULL;
+    }
+    fclose(f);
+
+#if MATRIX_IO_MMAP
+    if (header.dtype == MATRIX_FILE_FLOAT64 && !swapped && header.data_offset % sizeof(double) == 0) {
+        size_t bytes = (size_t) (header.data_offset + header.rows * header.columns * sizeof(double));
+        int fd = open(path, writable ? O_RDWR : O_RDONLY);
+        struct stat st;
+        void *base;
+
+        if (fd < 0 || fstat(fd, &st) != 0 || (uint64_t) st.st_size < bytes) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            free(mapping);
+            return NULL;
+        }
+
+        /* read-only maps are private copy-on-write, so the matrix is writable either way but the file is not */
+        base = mmap(NULL, bytes ? bytes : 1, PROT_READ | PROT_WRITE, writable ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+        close(fd);
+
+        if (base == MAP_FAILED) {
+            free(mapping);
+            return NULL;
+        }
+
+        matrix_wrap_init(&mapping->mat, (double *) ((unsigned char *) base + header.data_offset),
+                         (size_t) header.rows, (size_t) header.columns, 0, (matrix_order_t) header.order);
+        mapping->base = base;
+        mapping->length = bytes ? bytes : 1;
+
+        return &mapping->mat;
+    }
+#endif
+
+    {
+        matrix_t *loaded = writable ? NULL : matrix_load(path);
+
+        if (loaded == NULL) {
+            free(mapping);
+            return NULL;
+        }
+
+        /* the mapping struct takes over the loaded elements, so matrix_unmap handles both cases */
+        mapping->mat = *loaded;
+        mapping->base = NULL;
+        mapping->length = 0;
+        free(loaded);
+
+        return &mapping->mat;
+    }
+}
+
+/**
+ *  Libera uma matriz aberta por matrix_map.
+ */
+static void matrix_unmap(matrix_t *mat)
+{
+    matrix_mapping_t *mapping = (matrix_mapping_t *) mat;
+
+#if MATRIX_IO_MMAP
+    if (mapping->base != NULL) {
+        munmap(mapping->base, mapping->length);
+        free(mapping);
+        return;
+    }
+#endif
+
+    free(mapping->mat.elements);
+    free(mapping);
+}
+
+#endif
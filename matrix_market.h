@@ -0,0 +1,778 @@
+/**
+ *  @file
+ */
+/*
+ * Copyright (c) 2018 Victor Hermann "vitorhnn" Chiletto
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+**/
+
+#ifndef MATRIX_MARKET_H
+#define MATRIX_MARKET_H
+
+/*
+ * Matrix Market (.mtx) reader and writer for real matrices, in both the
+ * coordinate (sparse) and the array (dense, column-major) formats, with
+ * general, symmetric and skew-symmetric storage.
+ *
+ * The reader streams the file in blocks of MTX_BLOCK bytes. Each block is cut
+ * at line boundaries into chunks that are parsed in parallel (see parallel.h):
+ * one pass counts the entries of every chunk, so that the second pass knows
+ * where each chunk's entries go. Numbers are parsed by hand; decimals with up
+ * to 19 significant digits and small exponents are converted exactly with a
+ * single multiplication or division by a power of ten (Clinger's fast path),
+ * and anything else goes through strtod, so every value is correctly rounded.
+ *
+ * The writer prints the shortest of %.15g, %.16g and %.17g that reads back
+ * as the same double.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "matrix.h"
+#include "sparse.h"
+#include "parallel.h"
+
+/**
+ *  Tamanho, em bytes, dos blocos lidos do arquivo de uma vez.
+ */
+#ifndef MTX_BLOCK
+#define MTX_BLOCK (1 << 24)
+#endif
+
+/**
+ *  Quantidade de pedaços em que cada bloco é dividido, por thread.
+ */
+#ifndef MTX_CHUNKS_PER_THREAD
+#define MTX_CHUNKS_PER_THREAD 4
+#endif
+
+#define MTX_GENERAL 0
+#define MTX_SYMMETRIC 1
+#define MTX_SKEW_SYMMETRIC 2
+
+/**
+ *  Cabeçalho e linha de tamanhos de um arquivo Matrix Market.
+ */
+typedef struct {
+    /** 1 para o formato coordinate, 0 para array. **/
+    int coordinate;
+    /** Campo pattern: só as posições, sem valores. **/
+    int pattern;
+    /** MTX_GENERAL, MTX_SYMMETRIC ou MTX_SKEW_SYMMETRIC. **/
+    int symmetry;
+    size_t rows;
+    size_t columns;
+    /** Entradas listadas no arquivo. **/
+    size_t entries;
+} mtx_header_t;
+
+/**
+ *  Entradas lidas do corpo do arquivo. No formato array, row e column ficam NULL.
+ */
+typedef struct {
+    size_t *row;
+    size_t *column;
+    double *values;
+    size_t count;
+} mtx_entries_t;
+
+static const double mtx_powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static const char *mtx_skip_blanks(const char *p)
+{
+    while (*p == ' ' || *p == '\t' || *p == '\r') {
+        ++p;
+    }
+    return p;
+}
+
+/**
+ *  Lê um índice de base 1 e o converte para base 0.
+ *  @return 0, ou -1 caso não haja um índice válido em *p.
+ */
+static int mtx_parse_index(const char **p, size_t limit, size_t *out)
+{
+    const char *s = mtx_skip_blanks(*p);
+    size_t value = 0;
+
+    if (!isdigit((unsigned char) *s)) {
+        return -1;
+    }
+
+    while (isdigit((unsigned char) *s)) {
+        value = value * 10 + (size_t) (*s - '0');
+        ++s;
+    }
+
+    if (value == 0 || value > limit) {
+        return -1;
+    }
+
+    *out = value - 1;
+    *p = s;
+    return 0;
+}
+
+/**
+ *  Lê um número real de *p, com arredondamento correto.
+ *  @return 0, ou -1 caso não haja um número em *p.
+ */
+static int mtx_parse_double(const char **p, double *out)
+{
+    const char *start = mtx_skip_blanks(*p);
+    const char *s = start;
+    uint64_t mantissa = 0;
+    int digits = 0, any = 0, truncated = 0, negative = 0;
+    long exponent = 0;
+
+    if (*s == '+' || *s == '-') {
+        negative = *s == '-';
+        ++s;
+    }
+
+    for (; isdigit((unsigned char) *s); ++s) {
+        any = 1;
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (uint64_t) (*s - '0');
+            digits += mantissa != 0;
+        } else {
+            exponent++;
+            truncated |= *s != '0';
+        }
+    }
+
+    if (*s == '.') {
+        for (++s; isdigit((unsigned char) *s); ++s) {
+            any = 1;
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (uint64_t) (*s - '0');
+                digits += mantissa != 0;
+                exponent--;
+            } else {
+                truncated |= *s != '0';
+            }
+        }
+    }
+
+    if (any && (*s == 'e' || *s == 'E')) {
+        const char *e = s + 1;
+        int exponent_negative = 0;
+        long value = 0;
+
+        if (*e == '+' || *e == '-') {
+            exponent_negative = *e == '-';
+            ++e;
+        }
+
+        if (isdigit((unsigned char) *e)) {
+            for (; isdigit((unsigned char) *e); ++e) {
+                if (value < 100000) {
+                    value = value * 10 + (*e - '0');
+                }
+            }
+            exponent += exponent_negative ? -value : value;
+            s = e;
+        }
+    }
+
+    if (any && !truncated && mantissa <= (UINT64_C(1) << 53) && exponent >= -22 && exponent <= 22) {
+        /* both the mantissa and the power of ten are exact doubles, so one rounding gives the right answer */
+        double value = (double) mantissa;
+        value = exponent < 0 ? value / mtx_powers_of_ten[-exponent] : value * mtx_powers_of_ten[exponent];
+        *out = negative ? -value : value;
+        *p = s;
+        return 0;
+    }
+
+    {
+        /* long mantissas, big exponents, inf and nan; every line ends in '\n', which stops strtod */
+        char *end;
+
+        if (*start == '\n') {
+            return -1;
+        }
+
+        *out = strtod(start, &end);
+        if (end == start) {
+            return -1;
+        }
+
+        *p = end;
+        return 0;
+    }
+}
+
+/**
+ *  Lê o cabeçalho, os comentários e a linha de tamanhos de f.
+ *  @return 0, ou -1 caso o arquivo não seja um Matrix Market real suportado.
+ */
+static int mtx_read_header(FILE *f, mtx_header_t *header)
+{
+    char line[1024];
+    char object[64], format[64], field[64], symmetry[64];
+    unsigned long long rows, columns, entries = 0;
+    size_t i;
+
+    if (fgets(line, sizeof(line), f) == NULL) {
+        return -1;
+    }
+
+    /* the banner is case-insensitive */
+    for (i = 0; line[i] != '\0'; ++i) {
+        line[i] = (char) tolower((unsigned char) line[i]);
+    }
+
+    if (sscanf(line, "%%%%matrixmarket %63s %63s %63s %63s", object, format, field, symmetry) != 4) {
+        return -1;
+    }
+
+    if (strcmp(object, "matrix") != 0) {
+        return -1;
+    }
+
+    if (strcmp(format, "coordinate") == 0) {
+        header->coordinate = 1;
+    } else if (strcmp(format, "array") == 0) {
+        header->coordinate = 0;
+    } else {
+        return -1;
+    }
+
+    header->pattern = strcmp(field, "pattern") == 0;
+    if (!header->pattern && strcmp(field, "real") != 0 && strcmp(field, "integer") != 0 && strcmp(field, "double") != 0) {
+        return -1;
+    }
+
+    if (strcmp(symmetry, "general") == 0) {
+        header->symmetry = MTX_GENERAL;
+    } else if (strcmp(symmetry, "symmetric") == 0) {
+        header->symmetry = MTX_SYMMETRIC;
+    } else if (strcmp(symmetry, "skew-symmetric") == 0) {
+        header->symmetry = MTX_SKEW_SYMMETRIC;
+    } else {
+        return -1;
+    }
+
+    if (header->pattern && !header->coordinate) {
+        return -1;
+    }
+
+    do {
+        if (fgets(line, sizeof(line), f) == NULL) {
+            return -1;
+        }
+    } while (line[0] == '%' || line[strspn(line, " \t\r\n")] == '\0');
+
+    if (header->coordinate) {
+        if (sscanf(line, "%llu %llu %llu", &rows, &columns, &entries) != 3) {
+            return -1;
+        }
+    } else {
+        if (sscanf(line, "%llu %llu", &rows, &columns) != 2) {
+            return -1;
+        }
+        if (columns != 0 && rows > SIZE_MAX / columns) {
+            return -1;
+        }
+        /* symmetric arrays list only the lower triangle; rows == columns there, so rows * (rows + 1) fits */
+        entries = header->symmetry == MTX_GENERAL ? rows * columns :
+                  header->symmetry == MTX_SYMMETRIC ? rows * (rows + 1) / 2 : rows * (rows - (rows > 0)) / 2;
+    }
+
+    if (rows > SIZE_MAX || columns > SIZE_MAX || entries > SIZE_MAX / sizeof(double) - 1) {
+        return -1;
+    }
+
+    if (header->symmetry != MTX_GENERAL && rows != columns) {
+        return -1;
+    }
+
+    header->rows = (size_t) rows;
+    header->columns = (size_t) columns;
+    header->entries = (size_t) entries;
+
+    return 0;
+}
+
+/** Uma linha com dados: nem vazia, nem comentário. **/
+static int mtx_is_data_line(const char *line)
+{
+    const char *p = mtx_skip_blanks(line);
+    return *p != '\n' && *p != '%';
+}
+
+/**
+ *  Conta as linhas com dados em [begin, end), que termina em '\n'.
+ */
+static size_t mtx_count_entries(const char *begin, const char *end)
+{
+    size_t count = 0;
+
+    while (begin < end) {
+        const char *newline = (const char *) memchr(begin, '\n', (size_t) (end - begin));
+        count += mtx_is_data_line(begin);
+        begin = newline + 1;
+    }
+
+    return count;
+}
+
+/**
+ *  Lê as entradas de [begin, end), que termina em '\n', para a posição first de entries.
+ *  @return 0, ou -1 caso alguma linha seja inválida.
+ */
+static int mtx_parse_chunk(const mtx_header_t *header, const char *begin, const char *end,
+                           mtx_entries_t *entries, size_t first)
+{
+    size_t at = first;
+
+    while (begin < end) {
+        const char *newline = (const char *) memchr(begin, '\n', (size_t) (end - begin));
+        const char *p = begin;
+
+        if (mtx_is_data_line(p)) {
+            if (header->coordinate) {
+                if (mtx_parse_index(&p, header->rows, &entries->row[at]) != 0 ||
+                    mtx_parse_index(&p, header->columns, &entries->column[at]) != 0) {
+                    return -1;
+                }
+            }
+
+            if (header->pattern) {
+                entries->values[at] = 1;
+            } else if (mtx_parse_double(&p, &entries->values[at]) != 0) {
+                return -1;
+            }
+
+            at++;
+        }
+
+        begin = newline + 1;
+    }
+
+    return 0;
+}
+
+/**
+ *  Lê, em paralelo, as entradas de um trecho do arquivo que termina em '\n'.
+ *  @return 0, ou -1 caso o trecho seja inválido ou tenha mais entradas que o anunciado.
+ */
+static int mtx_parse_region(const mtx_header_t *header, const char *region, size_t length, mtx_entries_t *entries)
+{
+    size_t chunks = (size_t) parallel_threads() * MTX_CHUNKS_PER_THREAD;
+    size_t *bounds = (size_t *) malloc(sizeof(size_t) * (chunks + 1));
+    size_t *offsets = (size_t *) malloc(sizeof(size_t) * (chunks + 1));
+    int *failed = (int *) calloc(chunks, sizeof(int));
+    int status = 0;
+    size_t c;
+
+    if (bounds == NULL || offsets == NULL || failed == NULL) {
+        free(bounds);
+        free(offsets);
+        free(failed);
+        return -1;
+    }
+
+    /* cut at the first line break after each even split point */
+    bounds[0] = 0;
+    for (c = 1; c < chunks; ++c) {
+        size_t at = length / chunks * c;
+        const char *newline;
+
+        if (at < bounds[c - 1]) {
+            at = bounds[c - 1];
+        }
+        newline = at < length ? (const char *) memchr(region + at, '\n', length - at) : NULL;
+        bounds[c] = newline != NULL ? (size_t) (newline - region) + 1 : length;
+    }
+    bounds[chunks] = length;
+
+    PARALLEL_FOR
+    for (c = 0; c < chunks; ++c) {
+        offsets[c + 1] = mtx_count_entries(region + bounds[c], region + bounds[c + 1]);
+    }
+
+    offsets[0] = entries->count;
+    for (c = 0; c < chunks; ++c) {
+        offsets[c + 1] += offsets[c];
+    }
+
+    if (offsets[chunks] > header->entries) {
+        status = -1;
+    } else {
+        PARALLEL_FOR
+        for (c = 0; c < chunks; ++c) {
+            failed[c] = mtx_parse_chunk(header, region + bounds[c], region + bounds[c + 1], entries, offsets[c]);
+        }
+
+        for (c = 0; c < chunks; ++c) {
+            if (failed[c]) {
+                status = -1;
+            }
+        }
+
+        entries->count = offsets[chunks];
+    }
+
+    free(bounds);
+    free(offsets);
+    free(failed);
+
+    return status;
+}
+
+/**
+ *  Lê o corpo de f em blocos de MTX_BLOCK bytes.
+ *  @return 0, ou -1 caso o corpo seja inválido ou falte memória.
+ */
+static int mtx_read_entries(FILE *f, const mtx_header_t *header, mtx_entries_t *entries)
+{
+    size_t capacity = MTX_BLOCK;
+    size_t carry = 0;
+    char *buffer;
+    int status = 0;
+
+    entries->count = 0;
+    entries->row = NULL;
+    entries->column = NULL;
+    entries->values = NULL;
+
+    /* the count comes from the file, so it must not wrap the byte sizes below */
+    if (header->entries > SIZE_MAX / sizeof(size_t) - 1 || header->entries > SIZE_MAX / sizeof(double) - 1) {
+        return -1;
+    }
+
+    entries->row = header->coordinate ? (size_t *) malloc(sizeof(size_t) * (header->entries + 1)) : NULL;
+    entries->column = header->coordinate ? (size_t *) malloc(sizeof(size_t) * (header->entries + 1)) : NULL;
+    entries->values = (double *) malloc(sizeof(double) * (header->entries + 1));
+    buffer = (char *) malloc(capacity + 1);
+
+    if (buffer == NULL || entries->values == NULL || (header->coordinate && (entries->row == NULL || entries->column == NULL))) {
+        status = -1;
+    }
+
+    while (status == 0) {
+        size_t wanted = capacity - carry;
+        size_t got = fread(buffer + carry, 1, wanted, f);
+        size_t total = carry + got;
+        int eof = got < wanted;
+        size_t region;
+
+        if (total == 0) {
+            break;
+        }
+
+        if (eof) {
+            /* the last line may lack its line break */
+            if (buffer[total - 1] != '\n') {
+                buffer[total++] = '\n';
+            }
+            region = total;
+        } else {
+            char *last = buffer + total;
+            while (last > buffer && last[-1] != '\n') {
+                --last;
+            }
+            region = (size_t) (last - buffer);
+
+            if (region == 0) {
+                /* a single line longer than the buffer */
+                char *bigger = (char *) realloc(buffer, capacity * 2 + 1);
+                if (bigger == NULL) {
+                    status = -1;
+                    break;
+                }
+                buffer = bigger;
+                carry = total;
+                capacity *= 2;
+                continue;
+            }
+        }
+
+        status = mtx_parse_region(header, buffer, region, entries);
+
+        carry = total - region;
+        memmove(buffer, buffer + region, carry);
+
+        if (eof) {
+            break;
+        }
+    }
+
+    free(buffer);
+
+    if (status == 0 && entries->count != header->entries) {
+        status = -1;
+    }
+
+    if (status != 0) {
+        free(entries->row);
+        free(entries->column);
+        free(entries->values);
+        entries->row = entries->column = NULL;
+        entries->values = NULL;
+    }
+
+    return status;
+}
+
+/**
+ *  Lê um arquivo Matrix Market real como matriz esparsa CSR. <br>
+ *  Matrizes simétricas e antissimétricas são expandidas; arquivos array viram CSR sem os zeros.
+ *  @return A matriz, ou NULL caso o arquivo não possa ser lido.
+ */
+static sparse_t *mtx_read_sparse(const char *path)
+{
+    mtx_header_t header;
+    mtx_entries_t entries;
+    sparse_t *sp = NULL;
+    FILE *f = fopen(path, "rb");
+
+    if (f == NULL) {
+        return NULL;
+    }
+
+    if (mtx_read_header(f, &header) != 0 || mtx_read_entries(f, &header, &entries) != 0) {
+        fclose(f);
+        return NULL;
+    }
+    fclose(f);
+
+    if (!header.coordinate) {
+        matrix_t *dense;
+        size_t i, j, k = 0;
+
+        dense = matrix_new(header.rows, header.columns);
+        if (dense != NULL) {
+            for (j = 0; j < header.columns; ++j) {
+                for (i = header.symmetry == MTX_GENERAL ? 0 : j + (header.symmetry == MTX_SKEW_SYMMETRIC); i < header.rows; ++i) {
+                    dense->elements[i * header.columns + j] = entries.values[k];
+                    if (header.symmetry != MTX_GENERAL) {
+                        dense->elements[j * header.columns + i] =
+                            header.symmetry == MTX_SYMMETRIC ? entries.values[k] : -entries.values[k];
+                    }
+                    k++;
+                }
+                if (header.symmetry == MTX_SKEW_SYMMETRIC) {
+                    dense->elements[j * header.columns + j] = 0;
+                }
+            }
+            sp = sparse_from_matrix(dense);
+            matrix_free(dense);
+        }
+    } else if (header.symmetry == MTX_GENERAL) {
+        sp = sparse_from_triplets(header.rows, header.columns, entries.count, entries.row, entries.column, entries.values);
+    } else {
+        /* append the mirror image of every off-diagonal entry */
+        size_t mirrored = 0, total, i;
+        size_t *row, *column;
+        double *values;
+
+        for (i = 0; i < entries.count; ++i) {
+            mirrored += entries.row[i] != entries.column[i];
+        }
+
+        total = entries.count + mirrored;
+        row = (size_t *) realloc(entries.row, sizeof(size_t) * (total ? total : 1));
+        column = row != NULL ? (size_t *) realloc(entries.column, sizeof(size_t) * (total ? total : 1)) : NULL;
+        values = column != NULL ? (double *) realloc(entries.values, sizeof(double) * (total ? total : 1)) : NULL;
+
+        if (row != NULL) {
+            entries.row = row;
+        }
+        if (column != NULL) {
+            entries.column = column;
+        }
+        if (values != NULL) {
+            entries.values = values;
+        }
+
+        if (values != NULL) {
+            size_t at = entries.count;
+            for (i = 0; i < entries.count; ++i) {
+                if (row[i] != column[i]) {
+                    row[at] = column[i];
+                    column[at] = row[i];
+                    values[at] = header.symmetry == MTX_SYMMETRIC ? values[i] : -values[i];
+                    at++;
+                }
+            }
+            sp = sparse_from_triplets(header.rows, header.columns, total, row, column, values);
+        }
+    }
+
+    free(entries.row);
+    free(entries.column);
+    free(entries.values);
+
+    return sp;
+}
+
+/**
+ *  Lê um arquivo Matrix Market real como matriz densa. <br>
+ *  Arquivos array general são lidos direto para uma matriz MATRIX_COLUMN_MAJOR, sem reordenar.
+ *  @return A matriz, ou NULL caso o arquivo não possa ser lido.
+ */
+static matrix_t *mtx_read_dense(const char *path)
+{
+    mtx_header_t header;
+    mtx_entries_t entries;
+    matrix_t *mat;
+    sparse_t *sp;
+    FILE *f = fopen(path, "rb");
+
+    if (f == NULL) {
+        return NULL;
+    }
+
+    if (mtx_read_header(f, &header) != 0) {
+        fclose(f);
+        return NULL;
+    }
+
+    if (!header.coordinate && header.symmetry == MTX_GENERAL) {
+        if (mtx_read_entries(f, &header, &entries) != 0) {
+            fclose(f);
+            return NULL;
+        }
+        fclose(f);
+
+        mat = (matrix_t *) malloc(sizeof(matrix_t));
+        if (mat == NULL) {
+            free(entries.values);
+            return NULL;
+        }
+
+        /* the file is already in column-major order: adopt the parsed values as they are */
+        matrix_wrap_init(mat, entries.values, header.rows, header.columns, 0, MATRIX_COLUMN_MAJOR);
+        mat->borrowed = 0;
+
+        return mat;
+    }
+
+    fclose(f);
+
+    sp = mtx_read_sparse(path);
+    if (sp == NULL) {
+        return NULL;
+    }
+
+    mat = sparse_to_matrix(sp);
+    sparse_free(sp);
+
+    return mat;
+}
+
+/**
+ *  Escreve em buffer a representação mais curta de value que, lida de volta, dá o mesmo double.
+ */
+static void mtx_format_double(char *buffer, size_t size, double value)
+{
+    int precision;
+
+    for (precision = 15; precision < 17; ++precision) {
+        snprintf(buffer, size, "%.*g", precision, value);
+        if (strtod(buffer, NULL) == value) {
+            return;
+        }
+    }
+
+    snprintf(buffer, size, "%.17g", value);
+}
+
+/**
+ *  Grava mat em path no formato Matrix Market array real general.
+ *  @return 0, ou -1 caso a escrita falhe.
+ */
+static int mtx_write_dense(const matrix_t *mat, const char *path)
+{
+    char number[32];
+    size_t i, j;
+    int ok;
+    FILE *f = fopen(path, "wb");
+
+    if (f == NULL) {
+        return -1;
+    }
+
+    setvbuf(f, NULL, _IOFBF, 1 << 20);
+
+    ok = fprintf(f, "%%%%MatrixMarket matrix array real general\n%zu %zu\n", mat->rows, mat->columns) > 0;
+
+    /* the array format lists the matrix column by column */
+    for (j = 0; ok && j < mat->columns; ++j) {
+        for (i = 0; i < mat->rows; ++i) {
+            mtx_format_double(number, sizeof(number), matrix_get_at(mat, i, j));
+            fputs(number, f);
+            fputc('\n', f);
+        }
+        ok = !ferror(f);
+    }
+
+    if (fclose(f) != 0) {
+        ok = 0;
+    }
+
+    return ok ? 0 : -1;
+}
+
+/**
+ *  Grava sp em path no formato Matrix Market coordinate real general.
+ *  @return 0, ou -1 caso a escrita falhe.
+ */
+static int mtx_write_sparse(const sparse_t *sp, const char *path)
+{
+    char number[32];
+    size_t i;
+    int ok;
+    FILE *f = fopen(path, "wb");
+
+    if (f == NULL) {
+        return -1;
+    }
+
+    setvbuf(f, NULL, _IOFBF, 1 << 20);
+
+    ok = fprintf(f, "%%%%MatrixMarket matrix coordinate real general\n%zu %zu %zu\n",
+                 sp->rows, sp->columns, sp->nonzeros) > 0;
+
+    for (i = 0; ok && i < sp->rows; ++i) {
+        size_t k;
+        for (k = sp->row_start[i]; k < sp->row_start[i + 1]; ++k) {
+            mtx_format_double(number, sizeof(number), sp->values[k]);
+            fprintf(f, "%zu %zu %s\n", i + 1, sp->column[k] + 1, number);
+        }
+        ok = !ferror(f);
+    }
+
+    if (fclose(f) != 0) {
+        ok = 0;
+    }
+
+    return ok ? 0 : -1;
+}
+
+#endif
@@ -27,84 +27,430 @@
 #define MATRIX_NORMS_H
 
 #include "matrix.h"
+#include "workspace.h"
+#include "parallel.h"
+#include "lu.h"
+#include "cholesky.h"
+#include "operator.h"
 
 /**
- *  Calcula a norma de frobenius de mat
- *  @author Andrei Parente
+ *  Quantidade máxima padrão de iterações de operator_norm2_estimate_ctx.
  */
-static double frobenius_norm(const matrix_t *mat)
+#ifndef NORM2_ESTIMATE_ITERATIONS
+#define NORM2_ESTIMATE_ITERATIONS 1000
+#endif
+
+/**
+ *  Acumuladores independentes dos laços de norma, que o compilador leva a registradores SIMD.
+ */
+#ifndef NORM_LANES
+#define NORM_LANES 4
+#endif
+
+/**
+ *  Colunas somadas de uma vez quando as somas cruzam as linhas da memória, com as somas na pilha.
+ */
+#ifndef NORM_BLOCK
+#define NORM_BLOCK 256
+#endif
+
+/*
+ * Blue's thresholds and scale factors for double, as in LAPACK's la_constants:
+ * squares of values between NORM_TSML and NORM_TBIG neither overflow nor
+ * underflow, and the scaled squares of the values outside that range don't either.
+ */
+#define NORM_TSML 1.4916681462400413e-154
+#define NORM_TBIG 1.997919072202235e+146
+#define NORM_SSML 4.4989137945431964e+161
+#define NORM_SBIG 1.1113793747425387e-162
+
+/**
+ *  Soma de quadrados em três faixas de magnitude, pelo algoritmo de Blue (como o DNRM2 do LAPACK 3.10). <br>
+ *  Não transborda nem perde precisão por underflow, e, ao contrário do escalonamento do DLASSQ,
+ *  não divide a cada elemento nem depende da ordem deles.
+ */
+typedef struct {
+    double small;
+    double medium;
+    double big;
+} norm_sumsq_t;
+
+static void norm_sumsq_init(norm_sumsq_t *acc)
 {
-    double norm = 0;
+    acc->small = 0;
+    acc->medium = 0;
+    acc->big = 0;
+}
 
-    size_t i;
-    for (i = 0; i < mat->rows; ++i) {
-        size_t j;
-        for (j = 0; j < mat->columns; ++j) {
-            norm += pow(matrix_get_at(mat, i, j), 2);
+static void norm_sumsq_element(double ax, double *small, double *medium, double *big)
+{
+    double s = ax * NORM_SSML;
+    double b = ax * NORM_SBIG;
+
+    /* selects instead of branches, so the lanes vectorize; NaN fails both tests and lands in medium */
+    *small += ax < NORM_TSML ? s * s : 0;
+    *big += ax > NORM_TBIG ? b * b : 0;
+    *medium += ax < NORM_TSML || ax > NORM_TBIG ? 0 : ax * ax;
+}
+
+/**
+ *  Acumula em acc os quadrados de n elementos de x, a stride elementos um do outro.
+ */
+static void norm_sumsq_add(norm_sumsq_t *acc, size_t n, const double *x, size_t stride)
+{
+    double small[NORM_LANES] = {0}, medium[NORM_LANES] = {0}, big[NORM_LANES] = {0};
+    size_t i, l;
+
+    for (i = 0; i + NORM_LANES <= n; i += NORM_LANES) {
+        for (l = 0; l < NORM_LANES; ++l) {
+            norm_sumsq_element(fabs(x[(i + l) * stride]), &small[l], &medium[l], &big[l]);
+        }
+    }
+    for (; i < n; ++i) {
+        norm_sumsq_element(fabs(x[i * stride]), &small[0], &medium[0], &big[0]);
+    }
+
+    for (l = 0; l < NORM_LANES; ++l) {
+        acc->small += small[l];
+        acc->medium += medium[l];
+        acc->big += big[l];
+    }
+}
+
+/**
+ *  @return A raiz da soma de quadrados acumulada em acc.
+ */
+static double norm_sumsq_result(const norm_sumsq_t *acc)
+{
+    double small = acc->small, medium = acc->medium;
+
+    if (acc->big > 0) {
+        /* the medium values can only matter through rounding next to the big ones */
+        return sqrt(acc->big + medium * NORM_SBIG * NORM_SBIG) / NORM_SBIG;
+    }
+
+    if (small > 0) {
+        if (medium > 0 || medium != medium) {
+            double ymin, ymax;
+
+            medium = sqrt(medium);
+            small = sqrt(small) / NORM_SSML;
+            ymin = small < medium ? small : medium;
+            ymax = small < medium ? medium : small;
+
+            return ymax * sqrt(1 + (ymin / ymax) * (ymin / ymax));
         }
+
+        return sqrt(small) / NORM_SSML;
     }
 
-    return sqrt(norm);
+    return sqrt(medium);
 }
 
 /**
- *  Calcula a norma linha de mat
- *  @author Andrei Parente
+ *  Calcula a norma euclidiana de n elementos de x, a stride elementos um do outro, sem overflow nem underflow.
  */
-static double row_norm(const matrix_t *mat)
+static double norm2_strided(size_t n, const double *x, size_t stride)
 {
-    double sum = 0,
-           norm = 0;
+    norm_sumsq_t acc;
 
-    size_t i;
-    for (i = 0; i < mat->rows; ++i) {
-        size_t j;
-        for (j = 0; j < mat->columns; ++j) {
-            if (matrix_get_at(mat, i, j) >= 0) {
-                sum += matrix_get_at(mat, i, j);
-            } else {
-                sum -= matrix_get_at(mat, i, j);
+    norm_sumsq_init(&acc);
+    norm_sumsq_add(&acc, n, x, stride);
+
+    return norm_sumsq_result(&acc);
+}
+
+/**
+ *  Calcula a norma euclidiana dos n elementos contíguos de x, sem overflow nem underflow.
+ */
+static double norm2_array(size_t n, const double *x)
+{
+    return norm2_strided(n, x, 1);
+}
+
+static void norm_sumsq_merge(norm_sumsq_t *acc, const norm_sumsq_t *other)
+{
+    acc->small += other->small;
+    acc->medium += other->medium;
+    acc->big += other->big;
+}
+
+/**
+ *  Soma das magnitudes dos n elementos contíguos de x.
+ */
+static double norm_abs_sum(size_t n, const double *x)
+{
+    double sum[NORM_LANES] = {0};
+    double total = 0;
+    size_t i, l;
+
+    for (i = 0; i + NORM_LANES <= n; i += NORM_LANES) {
+        for (l = 0; l < NORM_LANES; ++l) {
+            sum[l] += fabs(x[i + l]);
+        }
+    }
+    for (; i < n; ++i) {
+        sum[0] += fabs(x[i]);
+    }
+
+    for (l = 0; l < NORM_LANES; ++l) {
+        total += sum[l];
+    }
+
+    return total;
+}
+
+/**
+ *  Maior soma de magnitudes entre lines trechos contíguos de length elementos, a ld elementos um do outro.
+ */
+static double norm_line_sums(size_t lines, size_t length, const double *a, size_t ld)
+{
+    double partial[PARALLEL_CHUNKS];
+    double norm = 0;
+    size_t c;
+
+    PARALLEL_FOR_IF(lines * length >= PARALLEL_MIN_WORK)
+    for (c = 0; c < PARALLEL_CHUNKS; ++c) {
+        size_t k, end = parallel_chunk_start(lines, c + 1);
+
+        partial[c] = 0;
+        for (k = parallel_chunk_start(lines, c); k < end; ++k) {
+            double sum = norm_abs_sum(length, a + k * ld);
+            if (sum > partial[c]) {
+                partial[c] = sum;
             }
+        }
+    }
+
+    for (c = 0; c < PARALLEL_CHUNKS; ++c) {
+        if (partial[c] > norm) {
+            norm = partial[c];
+        }
+    }
+
+    return norm;
+}
 
-            if (sum > norm) {
-                norm = sum;
+/**
+ *  Maior soma de magnitudes na mesma posição de lines trechos contíguos de length elementos,
+ *  a ld elementos um do outro. <br>
+ *  Os trechos ainda são lidos em ordem, NORM_BLOCK posições por vez; blocos diferentes vão para threads diferentes.
+ */
+static double norm_cross_sums(size_t lines, size_t length, const double *a, size_t ld)
+{
+    size_t blocks = (length + NORM_BLOCK - 1) / NORM_BLOCK;
+    double partial[PARALLEL_CHUNKS];
+    double norm = 0;
+    size_t c;
+
+    PARALLEL_FOR_IF(lines * length >= PARALLEL_MIN_WORK)
+    for (c = 0; c < PARALLEL_CHUNKS; ++c) {
+        size_t block, end = parallel_chunk_start(blocks, c + 1);
+
+        partial[c] = 0;
+        for (block = parallel_chunk_start(blocks, c); block < end; ++block) {
+            size_t first = block * NORM_BLOCK;
+            size_t count = length - first < NORM_BLOCK ? length - first : NORM_BLOCK;
+            double sum[NORM_BLOCK];
+            size_t i, k;
+
+            memset(sum, 0, sizeof(double) * count);
+
+            for (k = 0; k < lines; ++k) {
+                const double *line = a + k * ld + first;
+                for (i = 0; i < count; ++i) {
+                    sum[i] += fabs(line[i]);
+                }
+            }
+
+            for (i = 0; i < count; ++i) {
+                if (sum[i] > partial[c]) {
+                    partial[c] = sum[i];
+                }
             }
         }
+    }
 
-        sum = 0;
+    for (c = 0; c < PARALLEL_CHUNKS; ++c) {
+        if (partial[c] > norm) {
+            norm = partial[c];
+        }
     }
 
     return norm;
 }
 
 /**
- *  Calcula a norma coluna de mat
+ *  Descreve a memória de mat como *lines trechos contíguos de *length elementos, matrix_ld(mat) um do outro.
+ *  @return Se os trechos são as linhas de mat; senão, são as colunas.
+ */
+static int norm_lines(const matrix_t *mat, size_t *lines, size_t *length)
+{
+    if (mat->order == MATRIX_COLUMN_MAJOR) {
+        *lines = mat->columns;
+        *length = mat->rows;
+    } else {
+        *lines = mat->rows;
+        *length = mat->columns;
+    }
+
+    return (mat->order == MATRIX_ROW_MAJOR) == !mat->transposed;
+}
+
+/**
+ *  Calcula a norma de frobenius de mat, sem overflow nem underflow. <br>
+ *  As linhas são divididas entre as threads, com o mesmo resultado para qualquer quantidade delas.
+ *  @author Andrei Parente
+ */
+static double frobenius_norm(const matrix_t *mat)
+{
+    size_t lines, length, c;
+    size_t ld = matrix_ld(mat);
+    norm_sumsq_t partial[PARALLEL_CHUNKS];
+    norm_sumsq_t acc;
+
+    norm_lines(mat, &lines, &length);
+
+    PARALLEL_FOR_IF(lines * length >= PARALLEL_MIN_WORK)
+    for (c = 0; c < PARALLEL_CHUNKS; ++c) {
+        size_t k, end = parallel_chunk_start(lines, c + 1);
+
+        norm_sumsq_init(&partial[c]);
+        for (k = parallel_chunk_start(lines, c); k < end; ++k) {
+            norm_sumsq_add(&partial[c], length, mat->elements + k * ld, 1);
+        }
+    }
+
+    norm_sumsq_init(&acc);
+    for (c = 0; c < PARALLEL_CHUNKS; ++c) {
+        norm_sumsq_merge(&acc, &partial[c]);
+    }
+
+    return norm_sumsq_result(&acc);
+}
+
+/**
+ *  Calcula a norma linha de mat
+ *  @author Andrei Parente
+ */
+static double row_norm(const matrix_t *mat)
+{
+    size_t lines, length;
+
+    if (norm_lines(mat, &lines, &length)) {
+        return norm_line_sums(lines, length, mat->elements, matrix_ld(mat));
+    }
+
+    return norm_cross_sums(lines, length, mat->elements, matrix_ld(mat));
+}
+
+/**
+ *  Calcula a norma coluna de mat, percorrendo a memória em ordem mesmo quando mat é linha a linha.
  *  @author Andrei Parente
  */
 static double column_norm(const matrix_t *mat)
 {
-    double sum = 0,
-           norm = 0;
-
-    size_t j;
-    for (j = 0; j < mat->columns; ++j) {
-        size_t i;
-        for (i = 0; i < mat->rows; ++i) {
-            if (matrix_get_at(mat, i, j) >= 0) {
-                sum += matrix_get_at(mat, i, j);
-            } else {
-                sum -= matrix_get_at(mat, i, j);
-            }
+    size_t lines, length;
+
+    if (norm_lines(mat, &lines, &length)) {
+        return norm_cross_sums(lines, length, mat->elements, matrix_ld(mat));
+    }
+
+    return norm_line_sums(lines, length, mat->elements, matrix_ld(mat));
+}
+
+/**
+ *  Normas de uma matriz, calculadas juntas por matrix_norms.
+ */
+typedef struct {
+    /** Norma coluna, a maior soma de magnitudes de uma coluna. **/
+    double one;
+    /** Norma linha, a maior soma de magnitudes de uma linha. **/
+    double infinity;
+    double frobenius;
+    /** Maior magnitude de um elemento. **/
+    double max;
+} matrix_norms_t;
+
+/**
+ *  Calcula as normas coluna, linha, de frobenius e máxima de mat em uma única passada pela memória.
+ *  @param ws Workspace de um double por elemento de um trecho contíguo de mat, ou NULL.
+ *  @return norms, ou NULL caso falte memória.
+ */
+static matrix_norms_t *matrix_norms_ws(const matrix_t *mat, matrix_norms_t *norms, workspace_t *ws)
+{
+    size_t mark = workspace_mark(ws);
+    size_t ld = matrix_ld(mat);
+    size_t lines, length, i, k;
+    int by_rows = norm_lines(mat, &lines, &length);
+    double *cross = (double *) workspace_alloc(ws, sizeof(double) * length);
+    double line_norm = 0, cross_norm = 0, max = 0;
+    norm_sumsq_t acc;
+
+    if (cross == NULL) {
+        workspace_release(ws, mark);
+        return NULL;
+    }
 
-            if (sum > norm) {
-                norm = sum;
+    memset(cross, 0, sizeof(double) * length);
+    norm_sumsq_init(&acc);
+
+    for (k = 0; k < lines; ++k) {
+        const double *line = mat->elements + k * ld;
+        double small[NORM_LANES] = {0}, medium[NORM_LANES] = {0}, big[NORM_LANES] = {0};
+        double sum[NORM_LANES] = {0}, peak[NORM_LANES] = {0};
+        double total = 0;
+        size_t l;
+
+        for (i = 0; i + NORM_LANES <= length; i += NORM_LANES) {
+            for (l = 0; l < NORM_LANES; ++l) {
+                double ax = fabs(line[i + l]);
+                sum[l] += ax;
+                cross[i + l] += ax;
+                peak[l] = ax > peak[l] ? ax : peak[l];
+                norm_sumsq_element(ax, &small[l], &medium[l], &big[l]);
             }
         }
+        for (; i < length; ++i) {
+            double ax = fabs(line[i]);
+            sum[0] += ax;
+            cross[i] += ax;
+            peak[0] = ax > peak[0] ? ax : peak[0];
+            norm_sumsq_element(ax, &small[0], &medium[0], &big[0]);
+        }
 
-        sum = 0;
+        for (l = 0; l < NORM_LANES; ++l) {
+            total += sum[l];
+            max = peak[l] > max ? peak[l] : max;
+            acc.small += small[l];
+            acc.medium += medium[l];
+            acc.big += big[l];
+        }
+        line_norm = total > line_norm ? total : line_norm;
     }
 
-    return norm;
+    for (i = 0; i < length; ++i) {
+        cross_norm = cross[i] > cross_norm ? cross[i] : cross_norm;
+    }
+
+    norms->one = by_rows ? cross_norm : line_norm;
+    norms->infinity = by_rows ? line_norm : cross_norm;
+    norms->frobenius = norm_sumsq_result(&acc);
+    norms->max = max;
+
+    workspace_dealloc(ws, cross);
+    workspace_release(ws, mark);
+
+    return norms;
+}
+
+/**
+ *  Calcula as normas coluna, linha, de frobenius e máxima de mat em uma única passada pela memória.
+ *  @see matrix_norms_ws
+ */
+static matrix_norms_t *matrix_norms(const matrix_t *mat, matrix_norms_t *norms)
+{
+    return matrix_norms_ws(mat, norms, NULL);
 }
 
 /**
@@ -118,23 +464,14 @@ static double column_norm(const matrix_t *mat)
  */
 static double vector_norm1(const matrix_t* vector)
 {
-    double accumulator = 0;
-
-    size_t i;
-
     assert(vector->rows == 1);
 
-    for(i = 0; i < vector->columns; i++)
-    {
-        accumulator += fabs(matrix_get_at(vector, 0, i));
-    }
-
-    return accumulator;
+    return row_norm(vector);
 }
 
 /**
  *  NORMA 2: Vetor
- *  Norma Euclideana
+ *  Norma Euclideana, sem overflow nem underflow
  *
  *  @param vector, Vetor numa matriz linha
  *  @return norma euclidiana
@@ -143,18 +480,9 @@ static double vector_norm1(const matrix_t* vector)
  */
 static double vector_norm2(const matrix_t* vector)
 {
-    double accumulator = 0;
-
-    size_t i;
-
     assert(vector->rows == 1);
 
-    for(i = 0; i < vector->columns; i++)
-    {
-        accumulator += pow(matrix_get_at(vector, 0, i), 2);
-    }
-
-    return sqrt(accumulator);
+    return frobenius_norm(vector);
 }
 
 /**
@@ -168,29 +496,258 @@ static double vector_norm2(const matrix_t* vector)
  */
 static double vector_infinityNorm(const matrix_t* vector)
 {
-    double max = 0;
+    assert(vector->rows == 1);
 
+    return column_norm(vector);
+}
+
+static void norm_scale(size_t n, double alpha, double *x)
+{
     size_t i;
+    for (i = 0; i < n; ++i) {
+        x[i] *= alpha;
+    }
+}
 
-    assert(vector->rows == 1);
+/**
+ *  Contexto de uma chamada a operator_norm2_estimate_ctx. <br>
+ *  Inicialize com norm2_estimate_context_init e preencha os campos de entrada desejados.
+ */
+typedef struct {
+    /** Entrada: precisão relativa desejada, 0 para 1e-6. **/
+    double tolerance;
+    /** Entrada: limite de iterações, 0 para NORM2_ESTIMATE_ITERATIONS. **/
+    size_t max_iterations;
+    /** Entrada: workspace opcional de op->rows + op->columns doubles. **/
+    workspace_t *workspace;
+
+    /** Saída: iterações executadas. **/
+    size_t iterations;
+    /** Saída: 1 se a precisão foi atingida, 0 se o limite de iterações interrompeu o método. **/
+    int converged;
+} norm2_estimate_context_t;
 
-    for(i = 0; i < vector->columns; i++)
-    {
-        double element;
-        element = matrix_get_at(vector, 0, i);
+/**
+ *  Inicializa ctx com os valores padrão.
+ */
+static void norm2_estimate_context_init(norm2_estimate_context_t *ctx)
+{
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+/**
+ *  Estima ||A||_2 pelo método da potência sobre A^T A, partindo de um vetor aleatório, como o normest do MATLAB. <br>
+ *  Cada iteração custa uma aplicação de A e uma de A^T, e o erro relativo cai com (s2 / s1)^2,
+ *  onde s1 e s2 são os dois maiores valores singulares de A. <br>
+ *  A iteração para quando o erro extrapolado da razão entre os dois últimos passos fica abaixo de ctx->tolerance,
+ *  ou quando se esgotam ctx->max_iterations, caso em que ctx->converged fica 0.
+ *  @param op Operador com apply_transpose.
+ *  @param ctx Contexto, veja norm2_estimate_context_t.
+ *  @return Uma estimativa por baixo de ||A||_2, ou NAN caso falte memória.
+ */
+static double operator_norm2_estimate_ctx(const operator_t *op, norm2_estimate_context_t *ctx)
+{
+    workspace_t *ws = ctx->workspace;
+    size_t mark = workspace_mark(ws);
+    size_t m = op->rows;
+    size_t n = op->columns;
+    size_t max_iterations = ctx->max_iterations ? ctx->max_iterations : NORM2_ESTIMATE_ITERATIONS;
+    double tolerance = ctx->tolerance > 0 ? ctx->tolerance : 1e-6;
+    unsigned long seed = 0x2545f491ul;
+    double estimate = 0, last_step = 0;
+    double *x, *y;
+    size_t iteration;
+    size_t i;
+
+    ctx->iterations = 0;
+    ctx->converged = 0;
+
+    if (m == 0 || n == 0) {
+        ctx->converged = 1;
+        return 0;
+    }
+
+    x = (double *) workspace_alloc(ws, sizeof(double) * n);
+    y = (double *) workspace_alloc(ws, sizeof(double) * m);
+
+    if (x == NULL || y == NULL) {
+        workspace_dealloc(ws, y);
+        workspace_dealloc(ws, x);
+        workspace_release(ws, mark);
+        return NAN;
+    }
 
-        if(element < 0)
-        {
-            element = fabs(element);
+    /* a random start has a component along the top right singular vector with probability 1 */
+    for (i = 0; i < n; ++i) {
+        seed = seed * 1103515245ul + 12345ul;
+        x[i] = (double) ((seed >> 16) & 0x7fff) / 0x7fff - 0.5;
+    }
+    norm_scale(n, 1 / norm2_array(n, x), x);
+
+    for (iteration = 0; iteration < max_iterations; ++iteration) {
+        double previous = estimate;
+        double norm, step;
+
+        ctx->iterations = iteration + 1;
+
+        operator_apply(op, x, y);
+        norm = norm2_array(m, y);
+
+        /* x in the null space of A, which for a random x means A = 0 */
+        if (norm == 0) {
+            ctx->converged = 1;
+            break;
         }
 
-        if(element > max)
-        {
-            max = element;
+        /* ||A^T y|| / ||y|| >= ||A x||, and the vectors stay near unit length, so neither norm can overflow */
+        norm_scale(m, 1 / norm, y);
+        operator_apply_transpose(op, y, x);
+        estimate = norm2_array(n, x);
+
+        /*
+         * the estimates grow geometrically towards ||A||_2, so the steps left add up to about
+         * step * q / (1 - q) for the last ratio q between steps
+         */
+        step = estimate - previous;
+        if (estimate == 0 || step <= 0) {
+            /* no growth left to find at this precision */
+            ctx->converged = 1;
+            break;
+        }
+        if (iteration > 0 && step < last_step &&
+            step * (step / last_step) / (1 - step / last_step) <= tolerance * estimate) {
+            ctx->converged = 1;
+            break;
         }
+        last_step = step;
+
+        norm_scale(n, 1 / estimate, x);
     }
 
-    return max;
+    workspace_dealloc(ws, y);
+    workspace_dealloc(ws, x);
+    workspace_release(ws, mark);
+
+    return estimate;
+}
+
+/**
+ *  Estima ||A||_2 para um operador, com os temporários tirados de ws. <br>
+ *  Não informa se a precisão foi atingida; para isso use operator_norm2_estimate_ctx.
+ *  @param tolerance Precisão relativa desejada, ou 0 para 1e-6.
+ *  @param ws Workspace de op->rows + op->columns doubles, ou NULL.
+ *  @see operator_norm2_estimate_ctx
+ */
+static double operator_norm2_estimate_ws(const operator_t *op, double tolerance, workspace_t *ws)
+{
+    norm2_estimate_context_t ctx;
+
+    norm2_estimate_context_init(&ctx);
+    ctx.tolerance = tolerance;
+    ctx.workspace = ws;
+
+    return operator_norm2_estimate_ctx(op, &ctx);
+}
+
+/**
+ *  Estima ||A||_2 para um operador.
+ *  @see operator_norm2_estimate_ctx
+ */
+static double operator_norm2_estimate(const operator_t *op, double tolerance)
+{
+    return operator_norm2_estimate_ws(op, tolerance, NULL);
+}
+
+/**
+ *  Estima ||A||_2 com algumas multiplicações por gemv, em vez de uma SVD.
+ *  @see operator_norm2_estimate_ctx
+ */
+static double norm2_estimate(const matrix_t *A, double tolerance)
+{
+    operator_t op;
+
+    return operator_norm2_estimate(operator_init_matrix(&op, A), tolerance);
+}
+
+/**
+ *  Estima ||A||_2 para uma matriz esparsa, com sparse_mv e sparse_mv_transpose.
+ *  @see operator_norm2_estimate_ctx
+ */
+static double sparse_norm2_estimate(const sparse_t *sp, double tolerance)
+{
+    operator_t op;
+
+    return operator_norm2_estimate(operator_init_sparse(&op, sp), tolerance);
+}
+
+typedef struct {
+    const matrix_t *LU;
+    const size_t *pivots;
+} norm_lu_inverse_t;
+
+static void norm_lu_inverse_apply(const void *data, const double *x, double *y)
+{
+    const norm_lu_inverse_t *lu = (const norm_lu_inverse_t *) data;
+
+    memcpy(y, x, sizeof(double) * lu->LU->rows);
+    lu_factor_apply(lu->LU, lu->pivots, y);
+}
+
+static void norm_lu_inverse_apply_transpose(const void *data, const double *x, double *y)
+{
+    const norm_lu_inverse_t *lu = (const norm_lu_inverse_t *) data;
+
+    memcpy(y, x, sizeof(double) * lu->LU->rows);
+    lu_factor_apply_transpose(lu->LU, lu->pivots, y);
+}
+
+/**
+ *  Estima ||A^-1||_2 a partir da fatoração de lu_factor, com soluções em O(n^2) contra A e A^T.
+ *  @see operator_norm2_estimate_ctx
+ */
+static double lu_inverse_norm2_estimate(const matrix_t * ALC_RESTRICT LU, const size_t * ALC_RESTRICT pivots, double tolerance)
+{
+    norm_lu_inverse_t lu;
+    operator_t op;
+
+    lu.LU = LU;
+    lu.pivots = pivots;
+
+    op.rows = LU->rows;
+    op.columns = LU->rows;
+    op.apply = norm_lu_inverse_apply;
+    op.apply_transpose = norm_lu_inverse_apply_transpose;
+    op.data = &lu;
+
+    return operator_norm2_estimate(&op, tolerance);
+}
+
+static void norm_cholesky_inverse_apply(const void *data, const double *x, double *y)
+{
+    const matrix_t *R = (const matrix_t *) data;
+
+    memcpy(y, x, sizeof(double) * R->rows);
+    cholesky_apply_array(R->rows, R->elements, matrix_ld(R), y);
+}
+
+/**
+ *  Estima ||A^-1||_2 a partir do fator de cholesky_factor, com soluções em O(n^2). <br>
+ *  A^-1 é simétrica, então serve de sua própria transposta.
+ *  @see operator_norm2_estimate_ctx
+ */
+static double cholesky_inverse_norm2_estimate(const matrix_t *R, double tolerance)
+{
+    operator_t op;
+
+    assert(R->order == MATRIX_ROW_MAJOR);
+
+    op.rows = R->rows;
+    op.columns = R->rows;
+    op.apply = norm_cholesky_inverse_apply;
+    op.apply_transpose = norm_cholesky_inverse_apply;
+    op.data = R;
+
+    return operator_norm2_estimate(&op, tolerance);
 }
 
 #endif
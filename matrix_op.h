@@ -28,15 +28,32 @@
 
 #include "matrix.h"
 #include "basic.h"
+#include "blas.h"
+#include "workspace.h"
 #include "vandermonde.h"
 #include "iterative.h"
 #include "gauss.h"
+#include "thomas.h"
 #include "lu.h"
 #include "cholesky.h"
+#include "ldlt.h"
 #include "matrix_norms.h"
 #include "matrix_angle.h"
 #include "matrix_properties.h"
 #include "matrix_inverse.h"
 #include "condest.h"
+#include "solve.h"
+#include "batched.h"
+#include "mixed.h"
+#include "matrix_io.h"
+#include "parallel.h"
+#include "sparse.h"
+#include "matrix_market.h"
+#include "tiled.h"
+#include "qr.h"
+#include "eigen.h"
+#include "svd.h"
+#include "operator.h"
+#include "krylov.h"
 
 #endif
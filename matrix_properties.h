@@ -30,6 +30,16 @@
 #include "cholesky.h"
 #include "matrix_norms.h"
 #include "vandermonde.h"
+#include "qr.h"
+#include "blas.h"
+
+/**
+ *  Tamanho dos blocos percorridos por matrix_analyze e pelas verificações de simetria, ortogonalidade
+ *  e dominância diagonal.
+ */
+#ifndef ANALYZE_BLOCK
+#define ANALYZE_BLOCK 64
+#endif
 
 /**
  *  Confere se mat é tridiagonal.
@@ -55,43 +65,115 @@ static int tridiagonal_check(const matrix_t *mat)
 }
 
 /**
- *  Confere se mat é ortogonal.
- *  @author Andrei Parente
+ *  Confere se mat é ortogonal, isto é, se |(mat^T mat - I)_ij| <= tolerance para todo i, j. <br>
+ *  As colunas são verificadas em blocos de ANALYZE_BLOCK contra as anteriores, com gemm, parando no primeiro
+ *  bloco que falha; antes de cada bloco, as normas das suas colunas são conferidas uma a uma, então uma
+ *  matriz que não é ortogonal costuma ser rejeitada em O(n), e nenhuma em mais que O(n^3).
+ *  @param tolerance Desvio aceito, ou negativo para n * EPSILON.
+ *  @return 1 caso mat seja ortogonal, 0 caso contrário.
  */
-static int orthogonal_check(const matrix_t *mat)
+static int orthogonal_tolerance_check(const matrix_t *mat, double tolerance)
 {
-    matrix_t *id = matrix_new(mat->rows, mat->columns);
-    id = matrix_load_identity(id);
+    size_t n = mat->rows;
+    size_t ld = matrix_ld(mat);
+    /* the storage holds mat or mat^T, and either is orthogonal exactly when the other is */
+    int by_rows = mat->order == MATRIX_ROW_MAJOR;
+    double gram[ANALYZE_BLOCK * ANALYZE_BLOCK];
+    size_t first;
 
-    matrix_t *transposed = matrix_transpose(mat);
+    if (mat->rows != mat->columns) {
+        return 0;
+    }
+
+    if (tolerance < 0) {
+        tolerance = n * EPSILON;
+    }
+
+    for (first = 0; first < n; first += ANALYZE_BLOCK) {
+        size_t width = n - first < ANALYZE_BLOCK ? n - first : ANALYZE_BLOCK;
+        size_t start, i, j;
 
-    matrix_t *mulled = matrix_mul_matrix(mat, transposed);
+        /* column norms first: the cheapest way to reject most matrices */
+        for (j = first; j < first + width; ++j) {
+            double norm = by_rows ? norm2_strided(n, mat->elements + j, ld) : norm2_array(n, mat->elements + j * ld);
+            if (!(fabs(norm * norm - 1) <= tolerance)) {
+                return 0;
+            }
+        }
 
-    int result = matrix_cmp(id, mulled);
+        /* then every block up to and including this one against it */
+        for (start = 0; start <= first; start += ANALYZE_BLOCK) {
+            size_t height = start == first ? width : ANALYZE_BLOCK;
 
-    matrix_free(transposed);
-    matrix_free(mulled);
+            if (by_rows) {
+                gemm(BLAS_TRANS, BLAS_NO_TRANS, height, width, n, 1, mat->elements + start, ld,
+                     mat->elements + first, ld, 0, gram, width);
+            } else {
+                gemm(BLAS_NO_TRANS, BLAS_TRANS, height, width, n, 1, mat->elements + start * ld, ld,
+                     mat->elements + first * ld, ld, 0, gram, width);
+            }
 
-    if (result == 1) {
-        return 1;
+            for (i = 0; i < height; ++i) {
+                for (j = 0; j < width; ++j) {
+                    double expected = start + i == first + j ? 1 : 0;
+                    if (!(fabs(gram[i * width + j] - expected) <= tolerance)) {
+                        return 0;
+                    }
+                }
+            }
+        }
     }
 
-    return 0;
+    return 1;
 }
 
 /**
- *  Confere se mat é simétrica.
+ *  Confere se mat é ortogonal, com tolerância EPSILON em cada elemento de mat^T mat - I.
+ *  @see orthogonal_tolerance_check
+ *  @author Andrei Parente
+ */
+static int orthogonal_check(const matrix_t *mat)
+{
+    return orthogonal_tolerance_check(mat, EPSILON);
+}
+
+/**
+ *  Confere se mat é simétrica, de acordo com doublecmp. <br>
+ *  Compara blocos espelhados (i, j) e (j, i) direto na memória de mat, sem criar a transposta,
+ *  e para no primeiro par diferente.
  *  @author Andrei Parente
  */
 static int symmetric_check(const matrix_t *mat)
 {
-    matrix_t *transposed = matrix_transpose(mat);
+    size_t n = mat->rows;
+    size_t ld = matrix_ld(mat);
+    const double *a = mat->elements;
+    size_t bi, bj;
+
+    if (mat->rows != mat->columns) {
+        return 0;
+    }
+
+    /* mat is symmetric exactly when its storage is, whatever the order */
+    for (bi = 0; bi < n; bi += ANALYZE_BLOCK) {
+        size_t iend = bi + ANALYZE_BLOCK < n ? bi + ANALYZE_BLOCK : n;
 
-    int result = matrix_cmp(mat, transposed);
+        for (bj = bi; bj < n; bj += ANALYZE_BLOCK) {
+            size_t jend = bj + ANALYZE_BLOCK < n ? bj + ANALYZE_BLOCK : n;
+            size_t i;
 
-    matrix_free(transposed);
+            for (i = bi; i < iend; ++i) {
+                size_t j;
+                for (j = (bj == bi ? i + 1 : bj); j < jend; ++j) {
+                    if (!doublecmp(a[i * ld + j], a[j * ld + i])) {
+                        return 0;
+                    }
+                }
+            }
+        }
+    }
 
-    return result;
+    return 1;
 }
 
 /**
@@ -111,35 +193,69 @@ static int positive_definite_check(const matrix_t *mat)
 }
 
 /**
- *  Verifica se a matriz é estritamente diagonal dominante
+ *  Verifica se a matriz é estritamente diagonal dominante pelas linhas, isto é, se |a_ii| > soma |a_ij|, j != i. <br>
+ *  As linhas são somadas direto na memória de A, ANALYZE_BLOCK por vez quando A é coluna a coluna,
+ *  e a verificação para na primeira linha que falha.
  *  @autor Pedro da Luz
  */
 static int strictly_dominant_diagonal_check(const matrix_t *A)
 {
-    matrix_t* singleRow;
-    singleRow = matrix_new(1, A->columns);
+    size_t n = A->rows;
+    size_t row_stride, column_stride;
+    double sums[ANALYZE_BLOCK];
+    size_t first;
 
-    size_t i, j;
-    for(i = 0; i < A->rows; i++)
-    {
-        for(j = 0; j < A->columns; j++)
-            matrix_set_at(singleRow, 0, j, matrix_get_at(A, i, j));
+    if (A->rows != A->columns) {
+        return 0;
+    }
+
+    matrix_strides(A, &row_stride, &column_stride);
 
-        double norm = vector_norm1(singleRow);
+    for (first = 0; first < n; first += ANALYZE_BLOCK) {
+        size_t height = n - first < ANALYZE_BLOCK ? n - first : ANALYZE_BLOCK;
+        size_t i, j;
 
-        for(j = 0; j < A->columns; j++)
-        {
-            if(fabs(matrix_get_at(A, i, j)) < norm)
+        if (row_stride == 1) {
+            for (i = 0; i < height; ++i) {
+                const double *row = A->elements + (first + i) * column_stride;
+                sums[i] = norm_abs_sum(first + i, row) + norm_abs_sum(n - first - i - 1, row + first + i + 1);
+            }
+        } else {
+            /* the rows are strided, so sum the block of rows a column segment at a time */
+            memset(sums, 0, sizeof(double) * height);
+            for (j = 0; j < n; ++j) {
+                const double *segment = A->elements + j * row_stride + first;
+                for (i = 0; i < height; ++i) {
+                    sums[i] += first + i == j ? 0 : fabs(segment[i]);
+                }
+            }
+        }
+
+        for (i = 0; i < height; ++i) {
+            if (!(fabs(A->elements[(first + i) * (row_stride + column_stride)]) > sums[i])) {
                 return 0;
+            }
         }
     }
-    matrix_free(singleRow);
+
     return 1;
 }
 
 /**
- *  Verifica se os vetores da matriz são lineramente independentes
- *  Pelo método da determinante em matrizes de ordem NxN
+ *  Verifica se as linhas de A são linearmente independentes, pelo posto numérico da QR com pivoteamento
+ *  de colunas; vale para qualquer quantidade de vetores, em O(mn min(m, n)).
+ *  @param tolerance Limite para |R_ii|, como em qr_rank; negativo para max(m, n) * EPSILON * |R_00|.
+ *  @return 1 caso sejam independentes, 0 caso contrário.
+ */
+static int vector_linear_independence_check(const matrix_t *A, double tolerance)
+{
+    return A->rows <= A->columns && qr_rank(A, tolerance) == A->rows;
+}
+
+/**
+ *  Verifica se os vetores da matriz são lineramente independentes. <br>
+ *  Mantida por compatibilidade: usa vector_linear_independence_check com a tolerância padrão,
+ *  em vez de comparar o determinante com zero.
  *
  *  @param A, matriz composta por vetores linha
  *
@@ -147,20 +263,145 @@ static int strictly_dominant_diagonal_check(const matrix_t *A)
  */
 static int vector_lineary_independence_det_check(const matrix_t* A)
 {
-    if(vandermonde_check(A) == 1)
-    {
-        if(vandermonde_determinant(A) != 0)
-            return 1;
-        else
-            return 0;
+    return vector_linear_independence_check(A, -1);
+}
+
+/**
+ *  Propriedades estruturais de uma matriz, calculadas por matrix_analyze.
+ */
+typedef struct {
+    size_t rows;
+    size_t columns;
+    int square;
+    /** Simétrica, de acordo com doublecmp. **/
+    int symmetric;
+    /** Todos os elementos acima da diagonal são nulos. **/
+    int lower_triangular;
+    /** Todos os elementos abaixo da diagonal são nulos. **/
+    int upper_triangular;
+    /** Largura de banda abaixo da diagonal (maior i - j com elemento não nulo). **/
+    size_t lower_bandwidth;
+    /** Largura de banda acima da diagonal (maior j - i com elemento não nulo). **/
+    size_t upper_bandwidth;
+    size_t nonzeros;
+    /** Fração de elementos nulos. **/
+    double sparsity;
+    /** Estritamente diagonal dominante pelas linhas. **/
+    int diagonally_dominant;
+    /** Todos os elementos da diagonal são positivos. **/
+    int positive_diagonal;
+    /** Algum elemento da diagonal é nulo. **/
+    int zero_diagonal;
+    /** Maior elemento em valor absoluto. **/
+    double max_abs;
+} matrix_structure_t;
+
+static void matrix_analyze_element(matrix_structure_t *info, double *row_sums, size_t i, size_t j, double value)
+{
+    if (value == 0) {
+        return;
+    }
+
+    info->nonzeros++;
+
+    if (fabs(value) > info->max_abs) {
+        info->max_abs = fabs(value);
     }
-    else
-    {
-        if(matrix_get_determinant(A) != 0)
-            return 1;
-        else
-            return 0;
+
+    if (i > j && i - j > info->lower_bandwidth) {
+        info->lower_bandwidth = i - j;
+    } else if (j > i && j - i > info->upper_bandwidth) {
+        info->upper_bandwidth = j - i;
+    }
+
+    if (i != j && row_sums != NULL) {
+        row_sums[i] += fabs(value);
     }
 }
 
+/**
+ *  Calcula as propriedades estruturais de mat em uma única passada. <br>
+ *  Matrizes quadradas são percorridas em pares de blocos espelhados (i, j) e (j, i), de forma que
+ *  a simetria é conferida sem criar a transposta e cada elemento é lido uma só vez.
+ */
+static void matrix_analyze(const matrix_t *mat, matrix_structure_t *info)
+{
+    size_t rows = mat->rows,
+           columns = mat->columns;
+    size_t diagonal = rows < columns ? rows : columns;
+    double *row_sums = NULL;
+    size_t i;
+
+    memset(info, 0, sizeof(*info));
+    info->rows = rows;
+    info->columns = columns;
+    info->square = rows == columns;
+    info->symmetric = info->square;
+    info->positive_diagonal = 1;
+
+    if (info->square) {
+        size_t bi;
+
+        row_sums = calloc(rows ? rows : 1, sizeof(double));
+
+        for (bi = 0; bi < rows; bi += ANALYZE_BLOCK) {
+            size_t iend = bi + ANALYZE_BLOCK < rows ? bi + ANALYZE_BLOCK : rows;
+            size_t bj;
+
+            for (bj = bi; bj < columns; bj += ANALYZE_BLOCK) {
+                size_t jend = bj + ANALYZE_BLOCK < columns ? bj + ANALYZE_BLOCK : columns;
+
+                for (i = bi; i < iend; ++i) {
+                    size_t j;
+                    for (j = (bj == bi ? i : bj); j < jend; ++j) {
+                        double upper = matrix_get_at(mat, i, j);
+
+                        matrix_analyze_element(info, row_sums, i, j, upper);
+
+                        if (i != j) {
+                            double lower = matrix_get_at(mat, j, i);
+
+                            matrix_analyze_element(info, row_sums, j, i, lower);
+
+                            if (info->symmetric && !doublecmp(upper, lower)) {
+                                info->symmetric = 0;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    } else {
+        for (i = 0; i < rows; ++i) {
+            size_t j;
+            for (j = 0; j < columns; ++j) {
+                matrix_analyze_element(info, NULL, i, j, matrix_get_at(mat, i, j));
+            }
+        }
+    }
+
+    info->lower_triangular = info->upper_bandwidth == 0;
+    info->upper_triangular = info->lower_bandwidth == 0;
+    info->sparsity = rows * columns == 0 ? 0 : 1 - (double) info->nonzeros / (rows * columns);
+    info->diagonally_dominant = info->square;
+
+    for (i = 0; i < diagonal; ++i) {
+        double d = matrix_get_at(mat, i, i);
+
+        if (d == 0) {
+            info->zero_diagonal = 1;
+        }
+
+        if (d <= 0) {
+            info->positive_diagonal = 0;
+        }
+
+        if (row_sums != NULL && fabs(d) <= row_sums[i]) {
+            info->diagonally_dominant = 0;
+        }
+    }
+
+    free(row_sums);
+}
+
 #endif
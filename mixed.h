@@ -0,0 +1,346 @@
+/**
+ *  @file
+ */
+/*
+ * Copyright (c) 2018 Victor Hermann "vitorhnn" Chiletto
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+**/
+
+#ifndef MIXED_H
+#define MIXED_H
+
+/*
+ * Single-precision storage and mixed-precision solvers.
+ *
+ * The O(n^3) factorization is done in float, which moves half the bytes and
+ * fits twice as many elements per vector register as double. The solution is
+ * then refined with residuals computed in double,
+ *
+ *     r = b - A x,   solve A d = r with the float factors,   x = x + d,
+ *
+ * which recovers double accuracy in a few O(n^2) steps whenever A is not too
+ * ill-conditioned (roughly cond(A) < 1 / FLT_EPSILON). When the float
+ * factorization fails or the refinement does not converge, the system is
+ * solved again entirely in double.
+ */
+
+#include <float.h>
+
+#include "matrix.h"
+#include "lu.h"
+#include "cholesky.h"
+#include "blas.h"
+
+/**
+ *  Quantidade máxima de passos de refinamento antes de desistir da precisão simples.
+ */
+#ifndef MIXED_MAX_REFINEMENTS
+#define MIXED_MAX_REFINEMENTS 30
+#endif
+
+/**
+ *  Matriz em precisão simples, com o mesmo layout de matrix_t.
+ */
+typedef struct {
+    float *elements;
+    size_t rows;
+    size_t columns;
+} matrixf_t;
+
+/**
+ *  Cria uma nova matriz em precisão simples.
+ *  @return A nova matriz, ou NULL caso falte memória.
+ */
+static matrixf_t *matrixf_new(size_t rows, size_t columns)
+{
+    matrixf_t *mat = (matrixf_t *) malloc(sizeof(matrixf_t));
+    if (!mat) {
+        return NULL;
+    }
+
+    mat->elements = (float *) malloc(sizeof(float) * (rows * columns));
+    if (!mat->elements) {
+        free(mat);
+        return NULL;
+    }
+
+    mat->rows = rows;
+    mat->columns = columns;
+
+    return mat;
+}
+
+/**
+ *  Libera uma matriz em precisão simples.
+ */
+static void matrixf_free(matrixf_t *mat)
+{
+    free(mat->elements);
+    free(mat);
+}
+
+/**
+ *  Converte mat para precisão simples.
+ *  @return A cópia em float, ou NULL caso algum elemento não caiba em um float.
+ */
+static matrixf_t *matrixf_from_matrix(const matrix_t *mat)
+{
+    matrixf_t *single = matrixf_new(mat->rows, mat->columns);
+    size_t i;
+
+    if (single == NULL) {
+        return NULL;
+    }
+
+    for (i = 0; i < mat->rows; ++i) {
+        size_t j;
+        for (j = 0; j < mat->columns; ++j) {
+            double value = matrix_get_at(mat, i, j);
+            if (fabs(value) > FLT_MAX) {
+                matrixf_free(single);
+                return NULL;
+            }
+            single->elements[i * mat->columns + j] = (float) value;
+        }
+    }
+
+    return single;
+}
+
+/**
+ *  Converte mat para precisão dupla.
+ */
+static matrix_t *matrix_from_matrixf(const matrixf_t *mat)
+{
+    matrix_t *result = matrix_new(mat->rows, mat->columns);
+    size_t i;
+
+    for (i = 0; i < mat->rows * mat->columns; ++i) {
+        result->elements[i] = mat->elements[i];
+    }
+
+    return result;
+}
+
+/** Resolve, em float e no próprio vetor, um sistema já fatorado. **/
+typedef void (*mixed_apply_t)(size_t n, const float *factor, const size_t *pivots, float *x);
+
+static void mixed_lu_apply(size_t n, const float *factor, const size_t *pivots, float *x)
+{
+    lu_apply_arrayf(n, factor, n, pivots, x);
+}
+
+static void mixed_cholesky_apply(size_t n, const float *factor, const size_t *pivots, float *x)
+{
+    (void) pivots;
+    cholesky_apply_arrayf(n, factor, n, x);
+}
+
+/**
+ *  Refina x a partir dos fatores em float até que ||b - Ax||_inf <= ||x||_inf ||A||_inf eps sqrt(n). <br>
+ *  Desiste quando um passo não reduz o resíduo ao menos pela metade, sinal de que A é mal condicionada demais para float.
+ *  @param work Vetor de n floats para a correção.
+ *  @return A quantidade de passos de refinamento, ou -1 caso não tenha convergido.
+ */
+static int mixed_refine(const matrix_t * ALC_RESTRICT A, const matrix_t * ALC_RESTRICT b,
+                        const float *factor, const size_t *pivots, mixed_apply_t apply,
+                        double * ALC_RESTRICT x, double * ALC_RESTRICT residual, float * ALC_RESTRICT work)
+{
+    size_t n = A->rows;
+    size_t ld = matrix_ld(A);
+    int trans = A->order == MATRIX_COLUMN_MAJOR ? BLAS_TRANS : BLAS_NO_TRANS;
+    double anorm = 0, last_rnorm = 0;
+    double tolerance;
+    size_t i, j;
+    int step;
+
+    /* ||A||_inf, accumulating row sums in residual so that column-major storage is read by columns too */
+    memset(residual, 0, sizeof(double) * n);
+    for (i = 0; i < n; ++i) {
+        const double *line = A->elements + i * ld;
+        if (trans) {
+            for (j = 0; j < n; ++j) {
+                residual[j] += fabs(line[j]);
+            }
+        } else {
+            for (j = 0; j < n; ++j) {
+                residual[i] += fabs(line[j]);
+            }
+        }
+    }
+    for (i = 0; i < n; ++i) {
+        anorm = fmax(anorm, residual[i]);
+    }
+
+    tolerance = anorm * EPSILON * sqrt((double) n);
+
+    for (i = 0; i < n; ++i) {
+        work[i] = (float) matrix_get_at(b, i, 0);
+    }
+    apply(n, factor, pivots, work);
+    for (i = 0; i < n; ++i) {
+        x[i] = work[i];
+    }
+
+    for (step = 0; step <= MIXED_MAX_REFINEMENTS; ++step) {
+        double rnorm = 0, xnorm = 0;
+
+        /* the residual is the one part that must be done in double */
+        for (i = 0; i < n; ++i) {
+            residual[i] = matrix_get_at(b, i, 0);
+        }
+        gemv(trans, n, n, -1, A->elements, ld, x, 1, residual);
+
+        for (i = 0; i < n; ++i) {
+            rnorm = fmax(rnorm, fabs(residual[i]));
+            xnorm = fmax(xnorm, fabs(x[i]));
+        }
+
+        if (rnorm <= xnorm * tolerance) {
+            return step;
+        }
+
+        /* refinement that stalls won't converge, so leave the rest to the double precision fallback */
+        if (step == MIXED_MAX_REFINEMENTS || (step > 0 && rnorm > 0.5 * last_rnorm)) {
+            break;
+        }
+        last_rnorm = rnorm;
+
+        for (i = 0; i < n; ++i) {
+            work[i] = (float) residual[i];
+        }
+        apply(n, factor, pivots, work);
+        for (i = 0; i < n; ++i) {
+            x[i] += work[i];
+        }
+    }
+
+    return -1;
+}
+
+/**
+ *  Resolve Ax = b fatorando A em precisão simples e refinando a solução em precisão dupla. <br>
+ *  Quando A é mal condicionada demais para float, recai em lu_factor e lu_factor_apply.
+ *  @param refinements Caso não seja NULL, recebe a quantidade de passos de refinamento,
+ *  ou -1 caso o sistema tenha sido resolvido inteiramente em precisão dupla.
+ *  @return O vetor x, ou NULL caso A seja singular.
+ */
+static matrix_t *lu_solve_mixed(const matrix_t * ALC_RESTRICT A, const matrix_t * ALC_RESTRICT b, int *refinements)
+{
+    size_t n = A->rows;
+    matrixf_t *single;
+    matrix_t *x, *LU;
+    size_t *pivots;
+    int steps = -1;
+
+    assert(A->rows == A->columns);
+    assert(b->rows == n && b->columns == 1);
+
+    x = matrix_new(n, 1);
+    pivots = (size_t *) malloc(sizeof(size_t) * (n ? n : 1));
+    single = matrixf_from_matrix(A);
+
+    if (single != NULL && lu_factor_arrayf(n, single->elements, n, pivots) == 0) {
+        double *residual = (double *) malloc(sizeof(double) * n);
+        float *work = (float *) malloc(sizeof(float) * n);
+
+        steps = mixed_refine(A, b, single->elements, pivots, mixed_lu_apply, x->elements, residual, work);
+
+        free(residual);
+        free(work);
+    }
+
+    if (single != NULL) {
+        matrixf_free(single);
+    }
+    free(pivots);
+
+    if (refinements != NULL) {
+        *refinements = steps;
+    }
+
+    if (steps >= 0) {
+        return x;
+    }
+
+    matrix_free(x);
+
+    LU = lu_factor(A, &pivots);
+    if (LU == NULL) {
+        return NULL;
+    }
+
+    x = lu_factor_solve(LU, pivots, b);
+
+    matrix_free(LU);
+    free(pivots);
+
+    return x;
+}
+
+/**
+ *  Resolve Ax = b, com A simétrica positiva definida, fatorando A em precisão simples
+ *  e refinando a solução em precisão dupla. <br>
+ *  Quando A é mal condicionada demais para float, recai em cholesky_solve.
+ *  @param refinements Caso não seja NULL, recebe a quantidade de passos de refinamento,
+ *  ou -1 caso o sistema tenha sido resolvido inteiramente em precisão dupla.
+ *  @return O vetor x, ou NULL caso A não seja positiva definida.
+ */
+static matrix_t *cholesky_solve_mixed(const matrix_t * ALC_RESTRICT A, const matrix_t * ALC_RESTRICT b, int *refinements)
+{
+    size_t n = A->rows;
+    matrixf_t *single;
+    matrix_t *x;
+    int steps = -1;
+
+    assert(A->rows == A->columns);
+    assert(b->rows == n && b->columns == 1);
+
+    x = matrix_new(n, 1);
+    single = matrixf_from_matrix(A);
+
+    if (single != NULL && cholesky_factor_arrayf(n, single->elements, n) == 0) {
+        double *residual = (double *) malloc(sizeof(double) * n);
+        float *work = (float *) malloc(sizeof(float) * n);
+
+        steps = mixed_refine(A, b, single->elements, NULL, mixed_cholesky_apply, x->elements, residual, work);
+
+        free(residual);
+        free(work);
+    }
+
+    if (single != NULL) {
+        matrixf_free(single);
+    }
+
+    if (refinements != NULL) {
+        *refinements = steps;
+    }
+
+    if (steps >= 0) {
+        return x;
+    }
+
+    matrix_free(x);
+
+    return cholesky_solve(A, b);
+}
+
+#endif
@@ -0,0 +1,136 @@
+/**
+ *  @file
+ */
+/*
+ * Copyright (c) 2018 Victor Hermann "vitorhnn" Chiletto
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+**/
+
+#ifndef OPERATOR_H
+#define OPERATOR_H
+
+/*
+ * Linear operators known only through y = A x, for methods that never look
+ * at the elements of A: dense and sparse matrices both fit, and so does
+ * anything the caller can apply, such as a matrix-free stencil.
+ */
+
+#include "matrix.h"
+#include "blas.h"
+#include "sparse.h"
+
+/**
+ *  Calcula y = A x para o operador descrito por data.
+ *  @param x Vetor de columns componentes.
+ *  @param y Vetor de rows componentes, que não sobrepõe x.
+ */
+typedef void (*operator_apply_t)(const void *data, const double *x, double *y);
+
+/**
+ *  Operador linear de rows x columns.
+ */
+typedef struct {
+    size_t rows;
+    size_t columns;
+    operator_apply_t apply;
+    /** Calcula y = A^T x; NULL se a transposta não está disponível. **/
+    operator_apply_t apply_transpose;
+    /** Repassado a apply e a apply_transpose. **/
+    const void *data;
+} operator_t;
+
+/**
+ *  Calcula y = A x.
+ */
+static void operator_apply(const operator_t *op, const double *x, double *y)
+{
+    op->apply(op->data, x, y);
+}
+
+/**
+ *  Calcula y = A^T x, com x de rows e y de columns componentes.
+ */
+static void operator_apply_transpose(const operator_t *op, const double *x, double *y)
+{
+    assert(op->apply_transpose != NULL);
+
+    op->apply_transpose(op->data, x, y);
+}
+
+static void operator_matrix_apply(const void *data, const double *x, double *y)
+{
+    const matrix_t *A = (const matrix_t *) data;
+
+    /* a column-major A is A^T row by row */
+    gemv(A->order == MATRIX_COLUMN_MAJOR ? BLAS_TRANS : BLAS_NO_TRANS, A->rows, A->columns, 1, A->elements,
+         matrix_ld(A), x, 0, y);
+}
+
+static void operator_matrix_apply_transpose(const void *data, const double *x, double *y)
+{
+    const matrix_t *A = (const matrix_t *) data;
+
+    gemv(A->order == MATRIX_COLUMN_MAJOR ? BLAS_NO_TRANS : BLAS_TRANS, A->columns, A->rows, 1, A->elements,
+         matrix_ld(A), x, 0, y);
+}
+
+static void operator_sparse_apply(const void *data, const double *x, double *y)
+{
+    sparse_mv((const sparse_t *) data, x, y);
+}
+
+static void operator_sparse_apply_transpose(const void *data, const double *x, double *y)
+{
+    sparse_mv_transpose((const sparse_t *) data, x, y);
+}
+
+/**
+ *  Descreve, em op, a matriz densa A, em qualquer layout. A deve viver mais que op.
+ *  @return op.
+ */
+static operator_t *operator_init_matrix(operator_t *op, const matrix_t *A)
+{
+    assert(!A->transposed);
+
+    op->rows = A->rows;
+    op->columns = A->columns;
+    op->apply = operator_matrix_apply;
+    op->apply_transpose = operator_matrix_apply_transpose;
+    op->data = A;
+
+    return op;
+}
+
+/**
+ *  Descreve, em op, a matriz esparsa sp, aplicada com sparse_mv e sparse_mv_transpose. sp deve viver mais que op.
+ *  @return op.
+ */
+static operator_t *operator_init_sparse(operator_t *op, const sparse_t *sp)
+{
+    op->rows = sp->rows;
+    op->columns = sp->columns;
+    op->apply = operator_sparse_apply;
+    op->apply_transpose = operator_sparse_apply_transpose;
+    op->data = sp;
+
+    return op;
+}
+
+#endif
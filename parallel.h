@@ -0,0 +1,97 @@
+/**
+ *  @file
+ */
+/*
+ * Copyright (c) 2018 Victor Hermann "vitorhnn" Chiletto
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+**/
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+/*
+ * Optional multithreading through OpenMP.
+ *
+ * Build with -fopenmp (or your compiler's equivalent) to run the annotated
+ * loops in parallel; without it the macros expand to nothing and the same
+ * code runs serially. Loops are written over independent iterations, so the
+ * results do not depend on the number of threads.
+ *
+ * Reductions keep that promise by splitting their iterations into
+ * PARALLEL_CHUNKS pieces that depend only on the iteration count: each piece
+ * reduces its own part serially, and the partial results are combined in
+ * piece order afterwards, so floating point sums come out the same, bit for
+ * bit, with one thread or many.
+ */
+
+/**
+ *  Quantidade de fatias de uma redução; bem maior que a de threads, para equilibrar a carga.
+ */
+#ifndef PARALLEL_CHUNKS
+#define PARALLEL_CHUNKS 256
+#endif
+
+/**
+ *  Elementos a partir dos quais vale a pena dividir uma redução entre as threads.
+ */
+#ifndef PARALLEL_MIN_WORK
+#define PARALLEL_MIN_WORK 32768
+#endif
+
+#include <stddef.h>
+
+#define PARALLEL_STRINGIFY(text) #text
+
+#ifdef _OPENMP
+#include <omp.h>
+
+/** Divide as iterações do laço for seguinte entre as threads, em fatias contíguas. **/
+#define PARALLEL_FOR _Pragma("omp parallel for schedule(static)")
+
+/** Como PARALLEL_FOR, mas só usa threads quando condition é verdadeira. **/
+#define PARALLEL_FOR_IF(condition) _Pragma(PARALLEL_STRINGIFY(omp parallel for schedule(static) if (condition)))
+
+/**
+ *  Quantidade de threads que um laço PARALLEL_FOR usará.
+ */
+static int parallel_threads(void)
+{
+    return omp_get_max_threads();
+}
+#else
+#define PARALLEL_FOR
+#define PARALLEL_FOR_IF(condition)
+
+static int parallel_threads(void)
+{
+    return 1;
+}
+#endif
+
+/**
+ *  Primeira iteração da fatia chunk quando n iterações são divididas em PARALLEL_CHUNKS fatias contíguas. <br>
+ *  A fatia chunk termina onde a fatia chunk + 1 começa.
+ */
+static size_t parallel_chunk_start(size_t n, size_t chunk)
+{
+    return n / PARALLEL_CHUNKS * chunk + (n % PARALLEL_CHUNKS) * chunk / PARALLEL_CHUNKS;
+}
+
+#endif
@@ -0,0 +1,940 @@
+/**
+ *  @file
+ */
+/*
+ * Copyright (c) 2018 Victor Hermann "vitorhnn" Chiletto
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+**/
+
+#ifndef QR_H
+#define QR_H
+
+/*
+ * Householder QR.
+ *
+ * A = QR with Q = H_0 H_1 ... H_{k-1}, H_j = I - tau_j v_j v_j^T, where v_j
+ * is zero above row j, one at row j, and stored below the diagonal of
+ * column j; R is stored on and above the diagonal. This is the layout of
+ * LAPACK's GEQRF, in row-major storage.
+ *
+ * The factorization works on panels of QR_BLOCK columns. Within a panel the
+ * reflectors are applied one at a time; the panel's reflectors are then
+ * gathered into the compact WY form H_0 ... H_{b-1} = I - V T V^T, with T
+ * upper triangular, and applied to the rest of the matrix with two gemm
+ * calls. Q and Q^T are applied to other matrices the same way.
+ *
+ * For least squares with many more rows than columns, the rows are split
+ * into blocks that are factored independently (in parallel, see parallel.h)
+ * and only their small R factors are combined (TSQR). The blocks do not
+ * depend on the number of threads, so neither do the results.
+ */
+
+#include "matrix.h"
+#include "basic.h"
+#include "blas.h"
+#include "parallel.h"
+
+/**
+ *  Largura dos painéis da fatoração QR em blocos.
+ */
+#ifndef QR_BLOCK
+#define QR_BLOCK 32
+#endif
+
+/**
+ *  Mínimo de linhas por bloco da TSQR.
+ */
+#ifndef QR_TSQR_ROWS
+#define QR_TSQR_ROWS 1024
+#endif
+
+/**
+ *  qr_least_squares usa a TSQR quando a matriz tem ao menos QR_TSQR_RATIO vezes mais linhas que colunas.
+ */
+#ifndef QR_TSQR_RATIO
+#define QR_TSQR_RATIO 8
+#endif
+
+/**
+ *  Norma euclidiana de n elementos de x separados por stride, sem overflow nem underflow intermediários.
+ */
+static double qr_norm2(size_t n, const double *x, size_t stride)
+{
+    double scale = 0, sum = 1;
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        double value = fabs(x[i * stride]);
+        if (value != 0) {
+            if (scale < value) {
+                sum = 1 + sum * (scale / value) * (scale / value);
+                scale = value;
+            } else {
+                sum += (value / scale) * (value / scale);
+            }
+        }
+    }
+
+    return scale * sqrt(sum);
+}
+
+/**
+ *  Gera o refletor H = I - tau v v^T com H [alpha; x] = [beta; 0], como a DLARFG. <br>
+ *  v[0] = 1 fica implícito; o restante de v substitui x.
+ *  @param alpha Primeiro elemento na entrada, beta na saída.
+ *  @return tau, ou 0 caso x já seja nulo.
+ */
+static double qr_householder(size_t n, double *alpha, double *x, size_t stride)
+{
+    double xnorm = qr_norm2(n, x, stride);
+    double beta, scale;
+    size_t i;
+
+    if (xnorm == 0) {
+        return 0;
+    }
+
+    beta = hypot(*alpha, xnorm);
+    if (*alpha > 0) {
+        beta = -beta;
+    }
+
+    scale = 1 / (*alpha - beta);
+    for (i = 0; i < n; ++i) {
+        x[i * stride] *= scale;
+    }
+
+    scale = (beta - *alpha) / beta;
+    *alpha = beta;
+
+    return scale;
+}
+
+/**
+ *  Copia para V (m x b, linha a linha) os refletores das colunas 0 .. b - 1 de a, com os uns e zeros
+ *  explícitos, e monta T (b x b) triangular superior tal que H_0 ... H_{b-1} = I - V T V^T.
+ */
+static void qr_block_reflector(size_t m, size_t b, const double *a, size_t lda, const double *tau,
+                               double * ALC_RESTRICT V, double * ALC_RESTRICT T)
+{
+    size_t i, j, r;
+
+    for (r = 0; r < m; ++r) {
+        const double *row = a + r * lda;
+        double *v = V + r * b;
+        for (j = 0; j < b; ++j) {
+            v[j] = r > j ? row[j] : (r == j ? 1 : 0);
+        }
+    }
+
+    /* T(0:i, i) = -tau_i T(0:i, 0:i) V(:, 0:i)^T v_i, with V(:, 0:i)^T v_i gathered in column i of T first */
+    for (i = 0; i < b; ++i) {
+        for (j = 0; j < i; ++j) {
+            T[j * b + i] = 0;
+        }
+        for (r = i; r < m; ++r) {
+            const double *v = V + r * b;
+            for (j = 0; j < i; ++j) {
+                T[j * b + i] += v[j] * v[i];
+            }
+        }
+
+        for (j = 0; j < i; ++j) {
+            double sum = 0;
+            size_t p;
+            for (p = j; p < i; ++p) {
+                sum += T[j * b + p] * T[p * b + i];
+            }
+            T[j * b + i] = -tau[i] * sum;
+        }
+
+        T[i * b + i] = tau[i];
+        for (j = i + 1; j < b; ++j) {
+            T[j * b + i] = 0;
+        }
+    }
+}
+
+/**
+ *  Calcula C = (I - V T V^T) C, ou C = (I - V T^T V^T) C com trans = BLAS_TRANS.
+ *  @param C Matriz m x n, linha a linha com leading dimension ldc.
+ *  @param W Espaço para b * n elementos.
+ */
+static void qr_apply_block(int trans, size_t m, size_t n, size_t b, const double *V, const double *T,
+                           double *C, size_t ldc, double *W)
+{
+    size_t i, p, j;
+
+    if (n == 0) {
+        return;
+    }
+
+    /* W = V^T C */
+    gemm(BLAS_TRANS, BLAS_NO_TRANS, b, n, m, 1, V, b, C, ldc, 0, W, n);
+
+    if (trans) {
+        /* W = T^T W; T^T is lower triangular, so go bottom up */
+        for (i = b; i-- > 0;) {
+            double *wi = W + i * n;
+            double t = T[i * b + i];
+
+            for (j = 0; j < n; ++j) {
+                wi[j] *= t;
+            }
+            for (p = 0; p < i; ++p) {
+                const double *wp = W + p * n;
+                t = T[p * b + i];
+                for (j = 0; j < n; ++j) {
+                    wi[j] += t * wp[j];
+                }
+            }
+        }
+    } else {
+        trmm_left_upper(b, n, T, b, W, n);
+    }
+
+    /* C -= V W */
+    gemm(BLAS_NO_TRANS, BLAS_NO_TRANS, m, n, b, -1, V, b, W, n, 1, C, ldc);
+}
+
+/**
+ *  Fatora a[0:m, 0:n] = QR no próprio vetor, como descrito no início do arquivo.
+ *  @param tau Vetor de min(m, n) posições para os fatores dos refletores.
+ *  @return 0, ou -1 caso falte memória.
+ */
+static int qr_factor_array(size_t m, size_t n, double *a, size_t lda, double *tau)
+{
+    size_t steps = m < n ? m : n;
+    double *V = (double *) malloc(sizeof(double) * (m ? m : 1) * QR_BLOCK);
+    double *T = (double *) malloc(sizeof(double) * QR_BLOCK * QR_BLOCK);
+    double *W = (double *) malloc(sizeof(double) * QR_BLOCK * (n ? n : 1));
+    double *w = (double *) malloc(sizeof(double) * QR_BLOCK);
+    size_t k;
+
+    if (V == NULL || T == NULL || W == NULL || w == NULL) {
+        free(V);
+        free(T);
+        free(W);
+        free(w);
+        return -1;
+    }
+
+    for (k = 0; k < steps; k += QR_BLOCK) {
+        size_t end = k + QR_BLOCK < steps ? k + QR_BLOCK : steps;
+        size_t b = end - k;
+        size_t j;
+
+        /* factor the panel a[k:m, k:end] one reflector at a time */
+        for (j = k; j < end; ++j) {
+            double *top = a + j * lda + j;
+            size_t r, c;
+
+            tau[j] = qr_householder(m - j - 1, top, top + lda, lda);
+            if (tau[j] == 0) {
+                continue;
+            }
+
+            /* w = v^T a[j:m, j+1:end], then a[j:m, j+1:end] -= tau v w^T */
+            for (c = j + 1; c < end; ++c) {
+                w[c - j - 1] = a[j * lda + c];
+            }
+            for (r = j + 1; r < m; ++r) {
+                const double *row = a + r * lda;
+                double v = row[j];
+                for (c = j + 1; c < end; ++c) {
+                    w[c - j - 1] += v * row[c];
+                }
+            }
+            for (c = j + 1; c < end; ++c) {
+                a[j * lda + c] -= tau[j] * w[c - j - 1];
+            }
+            for (r = j + 1; r < m; ++r) {
+                double *row = a + r * lda;
+                double v = tau[j] * row[j];
+                for (c = j + 1; c < end; ++c) {
+                    row[c] -= v * w[c - j - 1];
+                }
+            }
+        }
+
+        if (end < n) {
+            /* the rest of the matrix gets the whole panel at once: a[k:m, end:n] = (I - V T^T V^T) a[k:m, end:n] */
+            qr_block_reflector(m - k, b, a + k * lda + k, lda, tau + k, V, T);
+            qr_apply_block(BLAS_TRANS, m - k, n - end, b, V, T, a + k * lda + end, lda, W);
+        }
+    }
+
+    free(V);
+    free(T);
+    free(W);
+    free(w);
+
+    return 0;
+}
+
+/**
+ *  Calcula c = Q c, ou c = Q^T c com trans = BLAS_TRANS, a partir da fatoração de qr_factor_array.
+ *  @param m Linhas de a e de c.
+ *  @param k Quantidade de refletores, min(m, n) da fatoração.
+ *  @param c Matriz m x columns, linha a linha com leading dimension ldc.
+ *  @return 0, ou -1 caso falte memória.
+ */
+static int qr_apply_array(int trans, size_t m, size_t k, const double *a, size_t lda, const double *tau,
+                          double *c, size_t ldc, size_t columns)
+{
+    double *V = (double *) malloc(sizeof(double) * (m ? m : 1) * QR_BLOCK);
+    double *T = (double *) malloc(sizeof(double) * QR_BLOCK * QR_BLOCK);
+    double *W = (double *) malloc(sizeof(double) * QR_BLOCK * (columns ? columns : 1));
+    size_t blocks = (k + QR_BLOCK - 1) / QR_BLOCK;
+    size_t step;
+
+    if (V == NULL || T == NULL || W == NULL) {
+        free(V);
+        free(T);
+        free(W);
+        return -1;
+    }
+
+    /* Q^T = H_{k-1} ... H_0 applies the first block first; Q applies it last */
+    for (step = 0; step < blocks; ++step) {
+        size_t block = trans ? step : blocks - 1 - step;
+        size_t first = block * QR_BLOCK;
+        size_t b = k - first < QR_BLOCK ? k - first : QR_BLOCK;
+
+        qr_block_reflector(m - first, b, a + first * lda + first, lda, tau + first, V, T);
+        qr_apply_block(trans, m - first, columns, b, V, T, c + first * ldc, ldc, W);
+    }
+
+    free(V);
+    free(T);
+    free(W);
+
+    return 0;
+}
+
+/**
+ *  Resolve R x = c, no próprio c, com R (n x n) triangular superior.
+ *  @param c Matriz n x columns, linha a linha com leading dimension ldc.
+ *  @return 0, ou -1 caso R tenha um zero na diagonal.
+ */
+static int qr_solve_upper(size_t n, const double *r, size_t ldr, double *c, size_t ldc, size_t columns)
+{
+    size_t i, p, j;
+
+    for (i = n; i-- > 0;) {
+        const double *row = r + i * ldr;
+        double *ci = c + i * ldc;
+
+        if (row[i] == 0) {
+            return -1;
+        }
+
+        for (p = i + 1; p < n; ++p) {
+            const double *cp = c + p * ldc;
+            for (j = 0; j < columns; ++j) {
+                ci[j] -= row[p] * cp[j];
+            }
+        }
+        for (j = 0; j < columns; ++j) {
+            ci[j] /= row[i];
+        }
+    }
+
+    return 0;
+}
+
+/**
+ *  Fatora até nb colunas de a a partir da linha e coluna s, com pivoteamento de colunas, como a DLAQPS. <br>
+ *  As atualizações das colunas seguintes ficam acumuladas em F e só são aplicadas, com um gemm, ao fim do
+ *  painel; a linha corrente é atualizada a cada passo para que as normas das colunas possam ser rebaixadas.
+ *  O painel para antes caso alguma norma rebaixada tenha perdido precisão demais.
+ *  @param F Espaço para (n - s) * nb elementos.
+ *  @param work Espaço para 2 * max(m, n) + nb elementos.
+ *  @param stale Espaço para n marcas.
+ *  @return A quantidade de colunas fatoradas.
+ */
+static size_t qr_pivoted_panel(size_t m, size_t n, size_t s, size_t nb, double *a, size_t lda, double *tau,
+                               size_t *jpvt, double *vn1, double *vn2, double *F, double *work, char *stale)
+{
+    size_t longest = m > n ? m : n;
+    double *tmp = work;
+    double *v = work + longest;
+    double *aux = work + 2 * longest;
+    double tol3z = sqrt(EPSILON);
+    size_t last = m < n ? m : n;
+    size_t k, col, r;
+    int restart = 0;
+
+    for (k = 0; k < nb && !restart; ++k) {
+        size_t c = s + k;
+        size_t pvt = c;
+        double akk;
+
+        for (col = c + 1; col < n; ++col) {
+            if (vn1[col] > vn1[pvt]) {
+                pvt = col;
+            }
+        }
+
+        if (pvt != c) {
+            size_t swap_index;
+
+            for (r = 0; r < m; ++r) {
+                double swap = a[r * lda + c];
+                a[r * lda + c] = a[r * lda + pvt];
+                a[r * lda + pvt] = swap;
+            }
+            for (r = 0; r < k; ++r) {
+                double swap = F[(c - s) * nb + r];
+                F[(c - s) * nb + r] = F[(pvt - s) * nb + r];
+                F[(pvt - s) * nb + r] = swap;
+            }
+            swap_index = jpvt[c];
+            jpvt[c] = jpvt[pvt];
+            jpvt[pvt] = swap_index;
+            vn1[pvt] = vn1[c];
+            vn2[pvt] = vn2[c];
+        }
+
+        /* bring column c up to date with the reflectors of this panel: a[c:m, c] -= a[c:m, s:c] F[c, 0:k]^T */
+        if (k > 0) {
+            gemv(BLAS_NO_TRANS, m - c, k, 1, a + c * lda + s, lda, F + (c - s) * nb, 0, tmp);
+            for (r = c; r < m; ++r) {
+                a[r * lda + c] -= tmp[r - c];
+            }
+        }
+
+        tau[c] = c + 1 < m ? qr_householder(m - c - 1, a + c * lda + c, a + (c + 1) * lda + c, lda) : 0;
+        akk = a[c * lda + c];
+        a[c * lda + c] = 1;
+
+        for (r = c; r < m; ++r) {
+            v[r - c] = a[r * lda + c];
+        }
+
+        /* column k of F: tau a[c:m, c+1:n]^T v, minus the part already accounted for by the earlier columns */
+        if (c + 1 < n) {
+            gemv(BLAS_TRANS, n - c - 1, m - c, tau[c], a + c * lda + c + 1, lda, v, 0, tmp);
+        }
+        for (col = s; col < n; ++col) {
+            F[(col - s) * nb + k] = col > c ? tmp[col - c - 1] : 0;
+        }
+
+        if (k > 0) {
+            gemv(BLAS_TRANS, k, m - c, -tau[c], a + c * lda + s, lda, v, 0, aux);
+            for (col = s; col < n; ++col) {
+                double *f = F + (col - s) * nb;
+                double sum = 0;
+                for (r = 0; r < k; ++r) {
+                    sum += f[r] * aux[r];
+                }
+                f[k] += sum;
+            }
+        }
+
+        /* row c is final for this factorization: a[c, c+1:n] -= a[c, s:c+1] F[c+1:n, 0:k+1]^T */
+        if (c + 1 < n) {
+            gemv(BLAS_NO_TRANS, n - c - 1, k + 1, -1, F + (c + 1 - s) * nb, nb, a + c * lda + s, 1, a + c * lda + c + 1);
+        }
+
+        /* downdate the norms of the remaining columns with the row just removed from them */
+        if (c + 1 < last) {
+            for (col = c + 1; col < n; ++col) {
+                if (vn1[col] != 0) {
+                    double ratio = fabs(a[c * lda + col]) / vn1[col];
+                    double left = fmax(0, (1 + ratio) * (1 - ratio));
+                    double drift = left * (vn1[col] / vn2[col]) * (vn1[col] / vn2[col]);
+
+                    if (drift <= tol3z) {
+                        stale[col] = 1;
+                        restart = 1;
+                    } else {
+                        vn1[col] *= sqrt(left);
+                    }
+                }
+            }
+        }
+
+        a[c * lda + c] = akk;
+    }
+
+    /* the rows below the panel get all of its reflectors at once */
+    if (k < (n - s < m - s ? n - s : m - s)) {
+        size_t row = s + k;
+        gemm(BLAS_NO_TRANS, BLAS_TRANS, m - row, n - s - k, k, -1, a + row * lda + s, lda,
+             F + k * nb, nb, 1, a + row * lda + s + k, lda);
+    }
+
+    for (col = s + k; col < n; ++col) {
+        if (stale[col]) {
+            vn1[col] = s + k < m ? qr_norm2(m - s - k, a + (s + k) * lda + col, lda) : 0;
+            vn2[col] = vn1[col];
+            stale[col] = 0;
+        }
+    }
+
+    return k;
+}
+
+/**
+ *  Fatora a[0:m, 0:n] P = QR no próprio vetor, com pivoteamento de colunas, como a DGEQP3. <br>
+ *  A cada passo, a coluna de maior norma restante vai para a frente, de modo que |R_00| >= |R_11| >= ...,
+ *  e o posto numérico aparece na diagonal de R. Q e R ficam guardados como em qr_factor_array.
+ *  @param tau Vetor de min(m, n) posições para os fatores dos refletores.
+ *  @param jpvt Vetor de n posições; a coluna j de AP é a coluna jpvt[j] de A.
+ *  @return 0, ou -1 caso falte memória.
+ */
+static int qr_pivoted_factor_array(size_t m, size_t n, double *a, size_t lda, double *tau, size_t *jpvt)
+{
+    size_t steps = m < n ? m : n;
+    size_t longest = m > n ? m : n;
+    double *vn1 = (double *) malloc(sizeof(double) * (n + 1));
+    double *vn2 = (double *) malloc(sizeof(double) * (n + 1));
+    double *F = (double *) malloc(sizeof(double) * (n + 1) * QR_BLOCK);
+    double *work = (double *) malloc(sizeof(double) * (2 * longest + QR_BLOCK));
+    char *stale = (char *) calloc(n + 1, 1);
+    size_t j, s;
+
+    if (vn1 == NULL || vn2 == NULL || F == NULL || work == NULL || stale == NULL) {
+        free(vn1);
+        free(vn2);
+        free(F);
+        free(work);
+        free(stale);
+        return -1;
+    }
+
+    for (j = 0; j < n; ++j) {
+        jpvt[j] = j;
+        vn1[j] = vn2[j] = qr_norm2(m, a + j, lda);
+    }
+
+    for (s = 0; s < steps;) {
+        size_t nb = steps - s < QR_BLOCK ? steps - s : QR_BLOCK;
+        s += qr_pivoted_panel(m, n, s, nb, a, lda, tau, jpvt, vn1, vn2, F, work, stale);
+    }
+
+    free(vn1);
+    free(vn2);
+    free(F);
+    free(work);
+    free(stale);
+
+    return 0;
+}
+
+/**
+ *  Fatora AP = QR com pivoteamento de colunas.
+ *  @param tau Recebe um vetor de min(m, n) posições, a ser liberado com free.
+ *  @param jpvt Recebe um vetor de n posições, a ser liberado com free; a coluna j de AP é a coluna jpvt[j] de A.
+ *  @return A fatoração, guardada como em qr_factor, ou NULL caso falte memória.
+ */
+static matrix_t *qr_pivoted_factor(const matrix_t *A, double **tau, size_t **jpvt)
+{
+    size_t steps = A->rows < A->columns ? A->rows : A->columns;
+    matrix_t *QR = matrix_copy(A);
+    double *t = (double *) malloc(sizeof(double) * (steps ? steps : 1));
+    size_t *p = (size_t *) malloc(sizeof(size_t) * (A->columns ? A->columns : 1));
+
+    if (QR == NULL || t == NULL || p == NULL ||
+        qr_pivoted_factor_array(QR->rows, QR->columns, QR->elements, QR->columns, t, p) != 0) {
+        if (QR != NULL) {
+            matrix_free(QR);
+        }
+        free(t);
+        free(p);
+        *tau = NULL;
+        *jpvt = NULL;
+        return NULL;
+    }
+
+    *tau = t;
+    *jpvt = p;
+
+    return QR;
+}
+
+/**
+ *  Posto numérico de uma fatoração de qr_pivoted_factor: a quantidade de |R_ii| acima da tolerância.
+ *  @param tolerance Limite absoluto; se negativo, max(m, n) * EPSILON * |R_00|.
+ */
+static size_t qr_pivoted_rank(const matrix_t *QR, double tolerance)
+{
+    size_t steps = QR->rows < QR->columns ? QR->rows : QR->columns;
+    size_t longest = QR->rows > QR->columns ? QR->rows : QR->columns;
+    size_t rank = 0;
+
+    if (steps == 0) {
+        return 0;
+    }
+
+    if (tolerance < 0) {
+        tolerance = (double) longest * EPSILON * fabs(QR->elements[0]);
+    }
+
+    while (rank < steps && fabs(QR->elements[rank * QR->columns + rank]) > tolerance) {
+        rank++;
+    }
+
+    return rank;
+}
+
+/**
+ *  Calcula o posto numérico de A, em O(mn min(m, n)).
+ *  @param tolerance Limite para |R_ii| na QR com pivoteamento; se negativo, max(m, n) * EPSILON * |R_00|.
+ *  @return O posto, ou (size_t) -1 caso falte memória.
+ */
+static size_t qr_rank(const matrix_t *A, double tolerance)
+{
+    double *tau;
+    size_t *jpvt;
+    matrix_t *QR = qr_pivoted_factor(A, &tau, &jpvt);
+    size_t rank;
+
+    if (QR == NULL) {
+        return (size_t) -1;
+    }
+
+    rank = qr_pivoted_rank(QR, tolerance);
+
+    matrix_free(QR);
+    free(tau);
+    free(jpvt);
+
+    return rank;
+}
+
+/**
+ *  Calcula uma base ortonormal do núcleo de A (m x n), os x com Ax = 0, a partir da QR com pivoteamento
+ *  de A^T: as últimas n - posto colunas de Q são ortogonais a todas as linhas de A.
+ *  @param tolerance Como em qr_rank.
+ *  @return Matriz n x (n - posto) com a base nas colunas, ou NULL caso o núcleo seja trivial ou falte memória.
+ */
+static matrix_t *qr_null_space(const matrix_t *A, double tolerance)
+{
+    size_t m = A->rows, n = A->columns;
+    size_t steps = m < n ? m : n;
+    matrix_t *At = matrix_new(n, m);
+    matrix_t *basis = NULL;
+    double *tau = (double *) malloc(sizeof(double) * (steps + 1));
+    size_t *jpvt = (size_t *) malloc(sizeof(size_t) * (m + 1));
+    size_t i, j;
+
+    if (At != NULL && tau != NULL && jpvt != NULL) {
+        for (i = 0; i < m; ++i) {
+            for (j = 0; j < n; ++j) {
+                At->elements[j * m + i] = matrix_get_at(A, i, j);
+            }
+        }
+
+        if (qr_pivoted_factor_array(n, m, At->elements, m, tau, jpvt) == 0) {
+            size_t rank = qr_pivoted_rank(At, tolerance);
+            size_t nullity = n - rank;
+
+            basis = nullity > 0 ? matrix_new(n, nullity) : NULL;
+            if (basis != NULL) {
+                memset(basis->elements, 0, sizeof(double) * n * nullity);
+                for (i = 0; i < nullity; ++i) {
+                    basis->elements[(rank + i) * nullity + i] = 1;
+                }
+
+                if (qr_apply_array(BLAS_NO_TRANS, n, steps, At->elements, m, tau, basis->elements, nullity, nullity) != 0) {
+                    matrix_free(basis);
+                    basis = NULL;
+                }
+            }
+        }
+    }
+
+    if (At != NULL) {
+        matrix_free(At);
+    }
+    free(tau);
+    free(jpvt);
+
+    return basis;
+}
+
+/**
+ *  Fatora A = QR. <br>
+ *  R fica no triângulo superior da matriz devolvida e os refletores que formam Q, abaixo da diagonal.
+ *  @param tau Recebe um vetor de min(m, n) posições, a ser liberado com free.
+ *  @return A fatoração, ou NULL caso falte memória.
+ */
+static matrix_t *qr_factor(const matrix_t *A, double **tau)
+{
+    size_t steps = A->rows < A->columns ? A->rows : A->columns;
+    matrix_t *QR = matrix_copy(A);
+    double *t = (double *) malloc(sizeof(double) * (steps ? steps : 1));
+
+    if (QR == NULL || t == NULL || qr_factor_array(QR->rows, QR->columns, QR->elements, QR->columns, t) != 0) {
+        if (QR != NULL) {
+            matrix_free(QR);
+        }
+        free(t);
+        *tau = NULL;
+        return NULL;
+    }
+
+    *tau = t;
+
+    return QR;
+}
+
+/**
+ *  Calcula Q C, ou Q^T C com trans = BLAS_TRANS, a partir da fatoração de qr_factor.
+ *  @return Uma nova matriz, ou NULL caso falte memória.
+ */
+static matrix_t *qr_apply(int trans, const matrix_t * ALC_RESTRICT QR, const double * ALC_RESTRICT tau,
+                          const matrix_t * ALC_RESTRICT C)
+{
+    size_t steps = QR->rows < QR->columns ? QR->rows : QR->columns;
+    matrix_t *result;
+
+    assert(C->rows == QR->rows);
+    assert(matrix_is_dense(QR));
+
+    result = matrix_copy(C);
+    if (result == NULL) {
+        return NULL;
+    }
+
+    if (qr_apply_array(trans, QR->rows, steps, QR->elements, QR->columns, tau,
+                       result->elements, result->columns, result->columns) != 0) {
+        matrix_free(result);
+        return NULL;
+    }
+
+    return result;
+}
+
+/**
+ *  Monta explicitamente as min(m, n) primeiras colunas de Q, a partir da fatoração de qr_factor.
+ *  @return A matriz m x min(m, n), ou NULL caso falte memória.
+ */
+static matrix_t *qr_q(const matrix_t * ALC_RESTRICT QR, const double * ALC_RESTRICT tau)
+{
+    size_t steps = QR->rows < QR->columns ? QR->rows : QR->columns;
+    matrix_t *Q = matrix_new(QR->rows, steps);
+    size_t i;
+
+    if (Q == NULL) {
+        return NULL;
+    }
+
+    memset(Q->elements, 0, sizeof(double) * QR->rows * steps);
+    for (i = 0; i < steps; ++i) {
+        Q->elements[i * steps + i] = 1;
+    }
+
+    if (qr_apply_array(BLAS_NO_TRANS, QR->rows, steps, QR->elements, QR->columns, tau, Q->elements, steps, steps) != 0) {
+        matrix_free(Q);
+        return NULL;
+    }
+
+    return Q;
+}
+
+/**
+ *  Copia o fator R (min(m, n) x n) da fatoração de qr_factor.
+ */
+static matrix_t *qr_r(const matrix_t *QR)
+{
+    size_t steps = QR->rows < QR->columns ? QR->rows : QR->columns;
+    matrix_t *R = matrix_new(steps, QR->columns);
+    size_t i, j;
+
+    if (R == NULL) {
+        return NULL;
+    }
+
+    for (i = 0; i < steps; ++i) {
+        for (j = 0; j < QR->columns; ++j) {
+            R->elements[i * QR->columns + j] = j < i ? 0 : QR->elements[i * QR->columns + j];
+        }
+    }
+
+    return R;
+}
+
+/**
+ *  Reduz A (m x n, m >= n) e B (m x p) a R (n x n) e C (n x p) com Q^T [A B] = [R C; 0 D], pela TSQR: os
+ *  blocos de linhas são fatorados em paralelo e os seus fatores R, empilhados, fatorados de novo.
+ *  @param B Pode ser NULL, e então C também.
+ *  @return 0, ou -1 caso falte memória.
+ */
+static int qr_tsqr_reduce(const matrix_t * ALC_RESTRICT A, const matrix_t * ALC_RESTRICT B, double *R, double *C)
+{
+    size_t m = A->rows, n = A->columns;
+    size_t p = B != NULL ? B->columns : 0;
+    size_t height = 2 * n > QR_TSQR_ROWS ? 2 * n : QR_TSQR_ROWS;
+    size_t blocks = m / height > 1 ? m / height : 1;
+    size_t stacked = blocks * n;
+    double *a = (double *) malloc(sizeof(double) * (m * n + 1));
+    double *b = (double *) malloc(sizeof(double) * (m * p + 1));
+    double *tau = (double *) malloc(sizeof(double) * (n ? n : 1) * (blocks + 1));
+    double *sa = (double *) malloc(sizeof(double) * (stacked * n + 1));
+    double *sb = (double *) malloc(sizeof(double) * (stacked * p + 1));
+    int *failed = (int *) calloc(blocks, sizeof(int));
+    int status = 0;
+    size_t block, i, j;
+
+    if (a == NULL || b == NULL || tau == NULL || sa == NULL || sb == NULL || failed == NULL) {
+        status = -1;
+    } else {
+        matrix_pack(A, a, n);
+        if (B != NULL) {
+            matrix_pack(B, b, p);
+        }
+
+        /* rows [block * m / blocks, (block + 1) * m / blocks), each with at least n of them */
+        PARALLEL_FOR
+        for (block = 0; block < blocks; ++block) {
+            size_t first = block * m / blocks;
+            size_t rows = (block + 1) * m / blocks - first;
+            double *ab = a + first * n;
+            double *t = tau + block * n;
+
+            failed[block] = qr_factor_array(rows, n, ab, n, t) != 0 ||
+                            (p > 0 && qr_apply_array(BLAS_TRANS, rows, n, ab, n, t, b + first * p, p, p) != 0);
+        }
+
+        for (block = 0; block < blocks; ++block) {
+            size_t first = block * m / blocks;
+
+            if (failed[block]) {
+                status = -1;
+            }
+
+            for (i = 0; i < n; ++i) {
+                for (j = 0; j < n; ++j) {
+                    sa[(block * n + i) * n + j] = j < i ? 0 : a[(first + i) * n + j];
+                }
+                memcpy(sb + (block * n + i) * p, b + (first + i) * p, sizeof(double) * p);
+            }
+        }
+    }
+
+    if (status == 0) {
+        double *t = tau + blocks * n;
+
+        if (qr_factor_array(stacked, n, sa, n, t) != 0 ||
+            (p > 0 && qr_apply_array(BLAS_TRANS, stacked, n, sa, n, t, sb, p, p) != 0)) {
+            status = -1;
+        } else {
+            for (i = 0; i < n; ++i) {
+                for (j = 0; j < n; ++j) {
+                    R[i * n + j] = j < i ? 0 : sa[i * n + j];
+                }
+            }
+            if (C != NULL) {
+                memcpy(C, sb, sizeof(double) * n * p);
+            }
+        }
+    }
+
+    free(a);
+    free(b);
+    free(tau);
+    free(sa);
+    free(sb);
+    free(failed);
+
+    return status;
+}
+
+/**
+ *  Calcula o fator R (n x n) de A (m x n, m >= n) pela TSQR, sem guardar Q. <br>
+ *  Útil para matrizes muito mais altas que largas.
+ *  @return R, ou NULL caso falte memória.
+ */
+static matrix_t *qr_tsqr(const matrix_t *A)
+{
+    matrix_t *R;
+
+    assert(A->rows >= A->columns);
+
+    R = matrix_new(A->columns, A->columns);
+    if (R == NULL) {
+        return NULL;
+    }
+
+    if (qr_tsqr_reduce(A, NULL, R->elements, NULL) != 0) {
+        matrix_free(R);
+        return NULL;
+    }
+
+    return R;
+}
+
+/**
+ *  Resolve o problema de mínimos quadrados min ||A X - B||_2, com A (m x n, m >= n) de posto completo,
+ *  sem formar A^T A. <br>
+ *  Matrizes com ao menos QR_TSQR_RATIO vezes mais linhas que colunas usam a TSQR.
+ *  @param B Matriz m x p; cada coluna é um lado direito.
+ *  @return X (n x p), ou NULL caso R tenha um zero na diagonal ou falte memória.
+ */
+static matrix_t *qr_least_squares(const matrix_t * ALC_RESTRICT A, const matrix_t * ALC_RESTRICT B)
+{
+    size_t m = A->rows, n = A->columns, p = B->columns;
+    matrix_t *X;
+    int status;
+
+    assert(m >= n);
+    assert(B->rows == m);
+
+    X = matrix_new(n, p);
+    if (X == NULL) {
+        return NULL;
+    }
+
+    if (m >= QR_TSQR_RATIO * n && m >= 2 * QR_TSQR_ROWS) {
+        double *R = (double *) malloc(sizeof(double) * (n * n + 1));
+
+        status = R == NULL || qr_tsqr_reduce(A, B, R, X->elements) != 0 ? -1 :
+                 qr_solve_upper(n, R, n, X->elements, p, p);
+
+        free(R);
+    } else {
+        double *tau;
+        matrix_t *QR = qr_factor(A, &tau);
+        matrix_t *C = QR != NULL ? qr_apply(BLAS_TRANS, QR, tau, B) : NULL;
+
+        status = -1;
+        if (C != NULL) {
+            memcpy(X->elements, C->elements, sizeof(double) * n * p);
+            status = qr_solve_upper(n, QR->elements, n, X->elements, p, p);
+            matrix_free(C);
+        }
+        if (QR != NULL) {
+            matrix_free(QR);
+            free(tau);
+        }
+    }
+
+    if (status != 0) {
+        matrix_free(X);
+        return NULL;
+    }
+
+    return X;
+}
+
+#endif
@@ -0,0 +1,195 @@
+/**
+ *  @file
+ */
+/*
+ * Copyright (c) 2018 Victor Hermann "vitorhnn" Chiletto
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+**/
+
+#ifndef SOLVE_H
+#define SOLVE_H
+
+#include "matrix.h"
+#include "basic.h"
+#include "thomas.h"
+#include "cholesky.h"
+#include "ldlt.h"
+#include "lu.h"
+#include "iterative.h"
+#include "matrix_properties.h"
+
+/**
+ *  Ordem mínima para que solve considere um método iterativo.
+ */
+#ifndef SOLVE_ITERATIVE_MIN_ORDER
+#define SOLVE_ITERATIVE_MIN_ORDER 256
+#endif
+
+/**
+ *  Fração mínima de zeros para que solve considere um método iterativo.
+ */
+#ifndef SOLVE_ITERATIVE_MIN_SPARSITY
+#define SOLVE_ITERATIVE_MIN_SPARSITY 0.9
+#endif
+
+/**
+ *  Tolerância relativa usada pelo método iterativo escolhido por solve.
+ */
+#ifndef SOLVE_ITERATIVE_TOLERANCE
+#define SOLVE_ITERATIVE_TOLERANCE 1e-12
+#endif
+
+/**
+ *  Métodos que solve pode escolher.
+ */
+typedef enum {
+    SOLVE_NONE,
+    SOLVE_FORWARDS_SUBSTITUTION,
+    SOLVE_BACKWARDS_SUBSTITUTION,
+    SOLVE_THOMAS,
+    SOLVE_CHOLESKY,
+    SOLVE_LDLT,
+    SOLVE_LU,
+    SOLVE_GAUSS_SEIDEL
+} solve_method_t;
+
+static matrix_t *solve_lu(const matrix_t * ALC_RESTRICT A, const matrix_t * ALC_RESTRICT b)
+{
+    size_t *pivots;
+    matrix_t *LU = lu_factor(A, &pivots);
+    matrix_t *x;
+
+    if (LU == NULL) {
+        return NULL;
+    }
+
+    x = lu_factor_solve(LU, pivots, b);
+
+    matrix_free(LU);
+    free(pivots);
+
+    return x;
+}
+
+static matrix_t *solve_iterative(const matrix_t * ALC_RESTRICT A, const matrix_t * ALC_RESTRICT b, double max_abs)
+{
+    solver_context_t ctx;
+    double tolerance = 0;
+    matrix_t *x;
+    size_t i;
+
+    for (i = 0; i < b->rows; ++i) {
+        if (fabs(matrix_get_at(b, i, 0)) > tolerance) {
+            tolerance = fabs(matrix_get_at(b, i, 0));
+        }
+    }
+
+    /* past n / 8 dense sweeps the O(n^3 / 3) factorization is cheaper anyway */
+    solver_context_init(&ctx);
+    ctx.max_iterations = A->rows / 8;
+
+    x = gauss_seidel_solve_ctx(A, b, tolerance / max_abs * SOLVE_ITERATIVE_TOLERANCE, &ctx);
+
+    if (!ctx.converged) {
+        matrix_free(x);
+        return NULL;
+    }
+
+    return x;
+}
+
+/**
+ *  Resolve o sistema Ax = b escolhendo o método mais barato que se aplica a A. <br>
+ *  A estrutura de A é obtida por matrix_analyze, e os métodos são tentados nesta ordem:
+ *  substituição para triangulares, Thomas para tridiagonais diagonal dominantes ou positivas definidas, Cholesky para simétricas,
+ *  LDLt para simétricas diagonal dominantes, Gauss-Seidel para matrizes grandes, esparsas e diagonal dominantes e, por fim, LU com pivoteamento.
+ *  Se um método falhar (pivô nulo, matriz não positiva definida, falta de convergência), o próximo é usado.
+ *  @param method Recebe o método usado, pode ser NULL.
+ *  @return O vetor x, ou NULL caso A não seja quadrada ou seja singular.
+ */
+static matrix_t *solve(const matrix_t * ALC_RESTRICT A, const matrix_t * ALC_RESTRICT b, solve_method_t *method)
+{
+    matrix_structure_t info;
+    solve_method_t used = SOLVE_NONE;
+    matrix_t *x = NULL;
+
+    assert(b->rows == A->rows);
+
+    matrix_analyze(A, &info);
+
+    if (!info.square || info.rows == 0) {
+        if (method != NULL) {
+            *method = SOLVE_NONE;
+        }
+        return NULL;
+    }
+
+    if (!info.zero_diagonal && info.lower_triangular) {
+        x = forwards_substitution(A, b);
+        used = SOLVE_FORWARDS_SUBSTITUTION;
+    } else if (!info.zero_diagonal && info.upper_triangular) {
+        x = backwards_substitution(A, b);
+        used = SOLVE_BACKWARDS_SUBSTITUTION;
+    }
+
+    /* Thomas doesn't pivot, so it is only used where that is stable; other tridiagonals go on to LU */
+    if (x == NULL && info.lower_bandwidth <= 1 && info.upper_bandwidth <= 1) {
+        if (info.diagonally_dominant) {
+            x = thomas_solve(A, b);
+            used = SOLVE_THOMAS;
+        } else if (info.symmetric && info.positive_diagonal) {
+            x = thomas_positive_definite_solve(A, b);
+            used = SOLVE_THOMAS;
+        }
+    }
+
+    if (x == NULL && info.symmetric && info.positive_diagonal) {
+        x = cholesky_solve(A, b);
+        used = SOLVE_CHOLESKY;
+    }
+
+    /*
+     * LDLt doesn't pivot either: without diagonal dominance, which elimination preserves, small
+     * pivots make it unstable, so symmetric indefinite matrices go on to LU like any other
+     */
+    if (x == NULL && info.symmetric && info.diagonally_dominant) {
+        x = ldlt_solve(A, b);
+        used = SOLVE_LDLT;
+    }
+
+    if (x == NULL && info.diagonally_dominant && info.rows >= SOLVE_ITERATIVE_MIN_ORDER &&
+            info.sparsity >= SOLVE_ITERATIVE_MIN_SPARSITY) {
+        x = solve_iterative(A, b, info.max_abs);
+        used = SOLVE_GAUSS_SEIDEL;
+    }
+
+    if (x == NULL) {
+        x = solve_lu(A, b);
+        used = x != NULL ? SOLVE_LU : SOLVE_NONE;
+    }
+
+    if (method != NULL) {
+        *method = used;
+    }
+
+    return x;
+}
+
+#endif
@@ -0,0 +1,236 @@
+/**
+ *  @file
+ */
+/*
+ * Copyright (c) 2018 Victor Hermann "vitorhnn" Chiletto
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+**/
+
+#ifndef SPARSE_H
+#define SPARSE_H
+
+/*
+ * Sparse matrices in compressed sparse row (CSR) form: the nonzeros of row i
+ * are values[row_start[i] .. row_start[i + 1]), in the columns given by the
+ * same range of column.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "matrix.h"
+#include "parallel.h"
+
+/**
+ *  Matriz esparsa no formato CSR.
+ */
+typedef struct {
+    size_t rows;
+    size_t columns;
+    size_t nonzeros;
+    /** rows + 1 posições; a linha i ocupa [row_start[i], row_start[i + 1]). **/
+    size_t *row_start;
+    size_t *column;
+    double *values;
+} sparse_t;
+
+/**
+ *  Libera uma matriz esparsa.
+ */
+static void sparse_free(sparse_t *sp)
+{
+    free(sp->row_start);
+    free(sp->column);
+    free(sp->values);
+    free(sp);
+}
+
+/**
+ *  Cria uma matriz esparsa com espaço para nonzeros elementos, com row_start zerado.
+ *  @return A nova matriz, ou NULL caso falte memória.
+ */
+static sparse_t *sparse_new(size_t rows, size_t columns, size_t nonzeros)
+{
+    sparse_t *sp = (sparse_t *) malloc(sizeof(sparse_t));
+
+    if (sp == NULL) {
+        return NULL;
+    }
+
+    sp->rows = rows;
+    sp->columns = columns;
+    sp->nonzeros = nonzeros;
+    sp->row_start = (size_t *) calloc(rows + 1, sizeof(size_t));
+    sp->column = (size_t *) malloc(sizeof(size_t) * (nonzeros ? nonzeros : 1));
+    sp->values = (double *) malloc(sizeof(double) * (nonzeros ? nonzeros : 1));
+
+    if (sp->row_start == NULL || sp->column == NULL || sp->values == NULL) {
+        sparse_free(sp);
+        return NULL;
+    }
+
+    return sp;
+}
+
+/**
+ *  Monta uma matriz CSR a partir de triplas (linha, coluna, valor), em qualquer ordem. <br>
+ *  A ordem relativa das triplas de uma mesma linha é mantida; duplicatas não são somadas.
+ *  @return A nova matriz, ou NULL caso falte memória.
+ */
+static sparse_t *sparse_from_triplets(size_t rows, size_t columns, size_t count,
+                                      const size_t *row, const size_t *column, const double *values)
+{
+    sparse_t *sp = sparse_new(rows, columns, count);
+    size_t *next;
+    size_t i;
+
+    if (sp == NULL) {
+        return NULL;
+    }
+
+    /* counting sort by row */
+    for (i = 0; i < count; ++i) {
+        assert(row[i] < rows && column[i] < columns);
+        sp->row_start[row[i] + 1]++;
+    }
+    for (i = 0; i < rows; ++i) {
+        sp->row_start[i + 1] += sp->row_start[i];
+    }
+
+    next = (size_t *) malloc(sizeof(size_t) * (rows ? rows : 1));
+    if (next == NULL) {
+        sparse_free(sp);
+        return NULL;
+    }
+    memcpy(next, sp->row_start, sizeof(size_t) * rows);
+
+    for (i = 0; i < count; ++i) {
+        size_t at = next[row[i]]++;
+        sp->column[at] = column[i];
+        sp->values[at] = values[i];
+    }
+
+    free(next);
+
+    return sp;
+}
+
+/**
+ *  Converte mat para CSR, guardando só os elementos não nulos.
+ */
+static sparse_t *sparse_from_matrix(const matrix_t *mat)
+{
+    size_t count = 0;
+    size_t i, j;
+    sparse_t *sp;
+
+    for (i = 0; i < mat->rows; ++i) {
+        for (j = 0; j < mat->columns; ++j) {
+            count += matrix_get_at(mat, i, j) != 0;
+        }
+    }
+
+    sp = sparse_new(mat->rows, mat->columns, count);
+    if (sp == NULL) {
+        return NULL;
+    }
+
+    count = 0;
+    for (i = 0; i < mat->rows; ++i) {
+        for (j = 0; j < mat->columns; ++j) {
+            double value = matrix_get_at(mat, i, j);
+            if (value != 0) {
+                sp->column[count] = j;
+                sp->values[count] = value;
+                count++;
+            }
+        }
+        sp->row_start[i + 1] = count;
+    }
+
+    return sp;
+}
+
+/**
+ *  Converte sp para uma matriz densa.
+ */
+static matrix_t *sparse_to_matrix(const sparse_t *sp)
+{
+    matrix_t *mat = matrix_new(sp->rows, sp->columns);
+    size_t i;
+
+    if (mat == NULL) {
+        return NULL;
+    }
+
+    memset(mat->elements, 0, sizeof(double) * sp->rows * sp->columns);
+
+    for (i = 0; i < sp->rows; ++i) {
+        size_t k;
+        for (k = sp->row_start[i]; k < sp->row_start[i + 1]; ++k) {
+            mat->elements[i * sp->columns + sp->column[k]] += sp->values[k];
+        }
+    }
+
+    return mat;
+}
+
+/**
+ *  Calcula y = A x, com A esparsa.
+ *  @param x Vetor de sp->columns componentes.
+ *  @param y Vetor de sp->rows componentes, que não pode sobrepor x.
+ */
+static void sparse_mv(const sparse_t * ALC_RESTRICT sp, const double * ALC_RESTRICT x, double * ALC_RESTRICT y)
+{
+    size_t i;
+
+    PARALLEL_FOR
+    for (i = 0; i < sp->rows; ++i) {
+        double sum = 0;
+        size_t k;
+        for (k = sp->row_start[i]; k < sp->row_start[i + 1]; ++k) {
+            sum += sp->values[k] * x[sp->column[k]];
+        }
+        y[i] = sum;
+    }
+}
+
+/**
+ *  Calcula y = A^T x, com A esparsa, sem transpor sp.
+ *  @param x Vetor de sp->rows componentes.
+ *  @param y Vetor de sp->columns componentes, que não pode sobrepor x.
+ */
+static void sparse_mv_transpose(const sparse_t * ALC_RESTRICT sp, const double * ALC_RESTRICT x, double * ALC_RESTRICT y)
+{
+    size_t i;
+
+    memset(y, 0, sizeof(double) * sp->columns);
+
+    /* each row scatters into y, so the rows can't be split between threads */
+    for (i = 0; i < sp->rows; ++i) {
+        double xi = x[i];
+        size_t k;
+        for (k = sp->row_start[i]; k < sp->row_start[i + 1]; ++k) {
+            y[sp->column[k]] += sp->values[k] * xi;
+        }
+    }
+}
+
+#endif
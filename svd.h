@@ -0,0 +1,939 @@
+/**
+ *  @file
+ */
+/*
+ * Copyright (c) 2018 Victor Hermann "vitorhnn" Chiletto
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+**/
+
+#ifndef SVD_H
+#define SVD_H
+
+/*
+ * Singular value decomposition A = U S V^T.
+ *
+ * The general driver reduces A (m >= n; wide matrices go through A^T) to an
+ * upper bidiagonal B = Q^T A P with Householder reflectors from both sides.
+ * As in LAPACK's DGEBRD/DLABRD, each panel of SVD_BLOCK rows and columns is
+ * accumulated in X and Y, and the rest of the matrix receives it with two
+ * gemm calls (A -= V Y^T + X U^T). Matrices much taller than wide are first
+ * reduced to their n x n R factor by the blocked QR of qr.h.
+ *
+ * B is then diagonalized by implicit QR sweeps with the shift of LAPACK's
+ * DBDSQR, accumulating the rotations only when the singular vectors are
+ * wanted, and those are taken back through Q and P with compact WY blocks.
+ *
+ * svd_jacobi is one-sided Jacobi (Hestenes): plane rotations orthogonalize
+ * the columns of A until every pair is orthogonal to working precision. It is
+ * slower, but computes even tiny singular values to high relative accuracy,
+ * so it is the choice for small or graded matrices.
+ */
+
+#include "matrix.h"
+#include "basic.h"
+#include "blas.h"
+#include "qr.h"
+#include "eigen.h"
+
+/**
+ *  Largura dos painéis da bidiagonalização.
+ */
+#ifndef SVD_BLOCK
+#define SVD_BLOCK 32
+#endif
+
+/**
+ *  Máximo de varreduras do QR implícito na bidiagonal, por valor singular.
+ */
+#ifndef SVD_MAX_ITERATIONS
+#define SVD_MAX_ITERATIONS 30
+#endif
+
+/**
+ *  Máximo de varreduras do Jacobi unilateral.
+ */
+#ifndef SVD_JACOBI_SWEEPS
+#define SVD_JACOBI_SWEEPS 60
+#endif
+
+/**
+ *  Capacidade, em varreduras, da fila de rotações adiadas do QR na bidiagonal.
+ */
+#ifndef SVD_QUEUED_SWEEPS
+#define SVD_QUEUED_SWEEPS 16
+#endif
+
+/**
+ *  Largura das faixas de colunas em que as rotações adiadas são aplicadas.
+ */
+#ifndef SVD_ROTATION_COLUMNS
+#define SVD_ROTATION_COLUMNS 32
+#endif
+
+/**
+ *  A partir de quantas vezes mais linhas que colunas a bidiagonalização é feita sobre o R de uma QR.
+ */
+#ifndef SVD_QR_RATIO
+#define SVD_QR_RATIO 2
+#endif
+
+/**
+ *  Reduz a[0:m, 0:n], m >= n, a uma bidiagonal superior B = Q^T A P. <br>
+ *  Q = H_0 ... H_{n-1} fica como na qr_factor_array (v_j abaixo da diagonal, na coluna j) e
+ *  P = G_0 ... G_{n-3} como na eigen_tridiagonalize_array (u_j em a[j, j + 2:n]).
+ *  @param d Recebe a diagonal de B (n posições).
+ *  @param e Recebe a superdiagonal de B (n - 1 posições).
+ *  @param tauq Recebe os fatores dos refletores de Q (n posições).
+ *  @param taup Recebe os fatores dos refletores de P (n posições).
+ *  @return 0, ou -1 caso falte memória.
+ */
+static int svd_bidiagonalize_array(size_t m, size_t n, double *a, size_t lda, double *d, double *e,
+                                   double *tauq, double *taup)
+{
+    double *X = (double *) malloc(sizeof(double) * (m + 1) * SVD_BLOCK);
+    double *Y = (double *) malloc(sizeof(double) * (n + 1) * SVD_BLOCK);
+    double *v = (double *) malloc(sizeof(double) * (m + 1));
+    double *x = (double *) malloc(sizeof(double) * (m + 1));
+    double *y = (double *) malloc(sizeof(double) * (n + 1));
+    double *t = (double *) malloc(sizeof(double) * (SVD_BLOCK + 1));
+    size_t i;
+
+    assert(m >= n);
+
+    if (X == NULL || Y == NULL || v == NULL || x == NULL || y == NULL || t == NULL) {
+        free(X);
+        free(Y);
+        free(v);
+        free(x);
+        free(y);
+        free(t);
+        return -1;
+    }
+
+    for (i = 0; i < n; i += SVD_BLOCK) {
+        size_t nb = n - i < SVD_BLOCK ? n - i : SVD_BLOCK;
+        size_t mm = m - i, nn = n - i;
+        double *p = a + i * lda + i;
+        size_t k, r;
+
+        /* panel coordinates: p is a[i:m, i:n], X holds its rows and Y its columns, nb apiece */
+        for (k = 0; k < nb; ++k) {
+            double *row = p + k * lda;
+
+            /* column k still misses the panel's earlier updates: a[k:mm, k] -= V Y(k, :)^T + X U(:, k) */
+            for (r = k; r < mm; ++r) {
+                v[r - k] = p[r * lda + k];
+            }
+            if (k > 0) {
+                for (r = 0; r < k; ++r) {
+                    t[r] = p[r * lda + k];
+                }
+                gemv(BLAS_NO_TRANS, mm - k, k, -1, row, lda, Y + k * nb, 1, v);
+                gemv(BLAS_NO_TRANS, mm - k, k, -1, X + k * nb, nb, t, 1, v);
+            }
+
+            tauq[i + k] = qr_householder(mm - k - 1, v, v + 1, 1);
+            d[i + k] = v[0];
+            v[0] = 1;
+            for (r = k; r < mm; ++r) {
+                p[r * lda + k] = v[r - k];
+            }
+
+            if (k + 1 == nn) {
+                taup[i + k] = 0;
+                break;
+            }
+
+            /* Y(k+1:nn, k) = tauq (A^T v - Y V^T v - U^T X^T v) */
+            gemv(BLAS_TRANS, nn - k - 1, mm - k, 1, row + k + 1, lda, v, 0, y);
+            if (k > 0) {
+                gemv(BLAS_TRANS, k, mm - k, 1, row, lda, v, 0, t);
+                gemv(BLAS_NO_TRANS, nn - k - 1, k, -1, Y + (k + 1) * nb, nb, t, 1, y);
+                gemv(BLAS_TRANS, k, mm - k, 1, X + k * nb, nb, v, 0, t);
+                gemv(BLAS_TRANS, nn - k - 1, k, -1, p + k + 1, lda, t, 1, y);
+            }
+            for (r = 0; r < nn - k - 1; ++r) {
+                Y[(k + 1 + r) * nb + k] = tauq[i + k] * y[r];
+            }
+
+            /* row k gets the panel so far, this reflector included: a[k, k+1:nn] -= Y V(k, :)^T + U^T X(k, :)^T */
+            gemv(BLAS_NO_TRANS, nn - k - 1, k + 1, -1, Y + (k + 1) * nb, nb, row, 1, row + k + 1);
+            if (k > 0) {
+                gemv(BLAS_TRANS, nn - k - 1, k, -1, p + k + 1, lda, X + k * nb, 1, row + k + 1);
+            }
+
+            taup[i + k] = qr_householder(nn - k - 2, row + k + 1, row + k + 2, 1);
+            e[i + k] = row[k + 1];
+            row[k + 1] = 1;
+
+            /* X(k+1:mm, k) = taup (A u - V Y^T u - X U u) */
+            gemv(BLAS_NO_TRANS, mm - k - 1, nn - k - 1, 1, p + (k + 1) * lda + k + 1, lda, row + k + 1, 0, x);
+            gemv(BLAS_TRANS, k + 1, nn - k - 1, 1, Y + (k + 1) * nb, nb, row + k + 1, 0, t);
+            gemv(BLAS_NO_TRANS, mm - k - 1, k + 1, -1, p + (k + 1) * lda, lda, t, 1, x);
+            if (k > 0) {
+                gemv(BLAS_NO_TRANS, k, nn - k - 1, 1, p + k + 1, lda, row + k + 1, 0, t);
+                gemv(BLAS_NO_TRANS, mm - k - 1, k, -1, X + (k + 1) * nb, nb, t, 1, x);
+            }
+            for (r = 0; r < mm - k - 1; ++r) {
+                X[(k + 1 + r) * nb + k] = taup[i + k] * x[r];
+            }
+        }
+
+        /* the trailing matrix gets the whole panel: A22 -= V Y^T + X U */
+        if (nb < nn) {
+            gemm(BLAS_NO_TRANS, BLAS_TRANS, mm - nb, nn - nb, nb, -1, p + nb * lda, lda, Y + nb * nb, nb,
+                 1, p + nb * lda + nb, lda);
+            gemm(BLAS_NO_TRANS, BLAS_NO_TRANS, mm - nb, nn - nb, nb, -1, X + nb * nb, nb, p + nb, lda,
+                 1, p + nb * lda + nb, lda);
+        }
+
+        /* put back the bidiagonal over the implicit ones */
+        for (k = 0; k < nb; ++k) {
+            p[k * lda + k] = d[i + k];
+            if (i + k + 1 < n) {
+                p[k * lda + k + 1] = e[i + k];
+            }
+        }
+    }
+
+    free(X);
+    free(Y);
+    free(v);
+    free(x);
+    free(y);
+    free(t);
+
+    return 0;
+}
+
+/**
+ *  Calcula x = c x + s y e y = c y - s x, com n elementos.
+ */
+static void svd_rotate(size_t n, double * ALC_RESTRICT x, double * ALC_RESTRICT y, double c, double s)
+{
+    size_t j;
+
+    for (j = 0; j < n; ++j) {
+        double t = x[j];
+        x[j] = c * t + s * y[j];
+        y[j] = c * y[j] - s * t;
+    }
+}
+
+/**
+ *  Rotação adiada das linhas first e second: first = c first + s second, second = c second - s first.
+ */
+typedef struct {
+    size_t first;
+    size_t second;
+    double c;
+    double s;
+} svd_rotation_t;
+
+/**
+ *  Aplica às linhas de Zt (n colunas, leading dimension ldz) as count rotações da fila, em ordem. <br>
+ *  Cada coluna só depende de si mesma, então a fila inteira passa por uma faixa de colunas antes da próxima,
+ *  que fica na cache durante todas as rotações em vez de ser relida a cada varredura.
+ */
+static void svd_apply_rotations(size_t count, const svd_rotation_t *queue, size_t n, double *Zt, size_t ldz)
+{
+    size_t column, r;
+
+    for (column = 0; column < n; column += SVD_ROTATION_COLUMNS) {
+        size_t width = n - column < SVD_ROTATION_COLUMNS ? n - column : SVD_ROTATION_COLUMNS;
+
+        for (r = 0; r < count; ++r) {
+            svd_rotate(width, Zt + queue[r].first * ldz + column, Zt + queue[r].second * ldz + column,
+                       queue[r].c, queue[r].s);
+        }
+    }
+}
+
+/**
+ *  Põe uma rotação na fila, caso ela exista.
+ */
+static void svd_queue_rotation(svd_rotation_t *queue, size_t *count, size_t first, size_t second, double c, double s)
+{
+    if (queue != NULL) {
+        queue[*count].first = first;
+        queue[*count].second = second;
+        queue[*count].c = c;
+        queue[*count].s = s;
+        (*count)++;
+    }
+}
+
+/**
+ *  Menor valor singular da triangular superior [f g; 0 h], sem overflow, como a DLAS2.
+ */
+static double svd_smallest_2x2(double f, double g, double h)
+{
+    double fa = fabs(f), ga = fabs(g), ha = fabs(h);
+    double fhmin = fmin(fa, ha), fhmax = fmax(fa, ha);
+    double as, at, au;
+
+    if (fhmin == 0) {
+        return 0;
+    }
+
+    as = 1 + fhmin / fhmax;
+    at = (fhmax - fhmin) / fhmax;
+
+    if (ga < fhmax) {
+        au = (ga / fhmax) * (ga / fhmax);
+        return fhmin * (2 / (sqrt(as * as + au) + sqrt(at * at + au)));
+    }
+
+    au = fhmax / ga;
+    if (au == 0) {
+        return (fhmin * fhmax) / ga;
+    }
+
+    return 2 * (fhmin / (sqrt(1 + (as * au) * (as * au)) + sqrt(1 + (at * au) * (at * au)))) * au;
+}
+
+/**
+ *  Diagonaliza a bidiagonal superior (d, e) por QR implícito, com os valores singulares em ordem decrescente
+ *  em d. <br>
+ *  Caso Ut e Vt não sejam NULL, as rotações são acumuladas nas suas linhas: se entram como a identidade, a linha
+ *  i de Ut (de Vt) sai como o vetor singular à esquerda (à direita) de d[i].
+ *  @param e Superdiagonal, com n - 1 posições; é destruída.
+ *  @param Ut Matriz n x n, linha a linha com leading dimension ldu, ou NULL.
+ *  @param Vt Matriz n x n, linha a linha com leading dimension ldv, ou NULL.
+ *  @return 0, ou -1 caso falte memória ou o QR não convirja.
+ */
+static int svd_bidiagonal_qr(size_t n, double *d, double *e, double *Ut, size_t ldu, double *Vt, size_t ldv)
+{
+    /* a sweep queues at most n rotations per side; they are applied in column strips once the queue fills */
+    size_t capacity = SVD_QUEUED_SWEEPS * n + 1;
+    svd_rotation_t *uqueue = Ut != NULL ? (svd_rotation_t *) malloc(sizeof(svd_rotation_t) * capacity) : NULL;
+    svd_rotation_t *vqueue = Vt != NULL ? (svd_rotation_t *) malloc(sizeof(svd_rotation_t) * capacity) : NULL;
+    size_t ucount = 0, vcount = 0;
+    size_t iterations = 0;
+    size_t hi = n ? n - 1 : 0;
+    double tolerance = 0;
+    int status = 0;
+    size_t i, j;
+
+    if ((Ut != NULL && uqueue == NULL) || (Vt != NULL && vqueue == NULL)) {
+        free(uqueue);
+        free(vqueue);
+        return -1;
+    }
+
+    for (i = 0; i < n; ++i) {
+        tolerance = fmax(tolerance, fabs(d[i]) + (i + 1 < n ? fabs(e[i]) : 0));
+    }
+    tolerance *= EPSILON;
+
+    while (hi > 0) {
+        double shift, y, z, c, s, r;
+        size_t lo;
+
+        if (ucount + n >= capacity) {
+            svd_apply_rotations(ucount, uqueue, n, Ut, ldu);
+            ucount = 0;
+        }
+        if (vcount + n >= capacity) {
+            svd_apply_rotations(vcount, vqueue, n, Vt, ldv);
+            vcount = 0;
+        }
+
+        if (fabs(e[hi - 1]) <= EPSILON * (fabs(d[hi - 1]) + fabs(d[hi]))) {
+            e[hi - 1] = 0;
+            hi--;
+            continue;
+        }
+
+        /* d[lo .. hi] is the unreduced block at the bottom */
+        lo = hi - 1;
+        while (lo > 0 && fabs(e[lo - 1]) > EPSILON * (fabs(d[lo - 1]) + fabs(d[lo]))) {
+            lo--;
+        }
+        if (lo > 0) {
+            e[lo - 1] = 0;
+        }
+
+        if (iterations++ == SVD_MAX_ITERATIONS * n) {
+            status = -1;
+            break;
+        }
+
+        for (i = lo; i <= hi; ++i) {
+            if (fabs(d[i]) <= tolerance) {
+                break;
+            }
+        }
+
+        if (i < hi) {
+            /* a zero on the diagonal: chase e[i] along row i with rotations from the left, splitting the block */
+            double f = e[i];
+
+            d[i] = 0;
+            e[i] = 0;
+            for (j = i + 1; j <= hi && f != 0; ++j) {
+                r = hypot(d[j], f);
+                c = d[j] / r;
+                s = f / r;
+                d[j] = r;
+                if (j < hi) {
+                    f = -s * e[j];
+                    e[j] *= c;
+                }
+                svd_queue_rotation(uqueue, &ucount, j, i, c, s);
+            }
+            continue;
+        }
+
+        if (i == hi) {
+            /* the zero is the last one: chase e[hi - 1] up column hi with rotations from the right */
+            double f = e[hi - 1];
+
+            d[hi] = 0;
+            e[hi - 1] = 0;
+            for (j = hi; j-- > lo && f != 0;) {
+                r = hypot(d[j], f);
+                c = d[j] / r;
+                s = f / r;
+                d[j] = r;
+                if (j > lo) {
+                    f = -s * e[j - 1];
+                    e[j - 1] *= c;
+                }
+                svd_queue_rotation(vqueue, &vcount, j, hi, c, s);
+            }
+            continue;
+        }
+
+        /* shift by the smallest singular value of the trailing 2 x 2 block, as DBDSQR; y and z come scaled by 1 / d[lo] */
+        shift = svd_smallest_2x2(d[hi - 1], e[hi - 1], d[hi]);
+        if ((shift / fabs(d[lo])) * (shift / fabs(d[lo])) < EPSILON) {
+            shift = 0;
+        }
+        y = (fabs(d[lo]) - shift) * ((d[lo] < 0 ? -1 : 1) + shift / d[lo]);
+        z = e[lo];
+
+        for (j = lo; j < hi; ++j) {
+            /* from the right, on columns j and j + 1: zero z against y, leaving a bulge below the diagonal */
+            r = hypot(y, z);
+            c = y / r;
+            s = z / r;
+            if (j > lo) {
+                e[j - 1] = r;
+            }
+            y = c * d[j] + s * e[j];
+            e[j] = c * e[j] - s * d[j];
+            z = s * d[j + 1];
+            d[j + 1] *= c;
+            svd_queue_rotation(vqueue, &vcount, j, j + 1, c, s);
+
+            /* from the left, on rows j and j + 1: zero the bulge, leaving another one right of the superdiagonal */
+            r = hypot(y, z);
+            c = y / r;
+            s = z / r;
+            d[j] = r;
+            y = c * e[j] + s * d[j + 1];
+            d[j + 1] = c * d[j + 1] - s * e[j];
+            if (j + 1 < hi) {
+                z = s * e[j + 1];
+                e[j + 1] *= c;
+            }
+            svd_queue_rotation(uqueue, &ucount, j, j + 1, c, s);
+        }
+        e[hi - 1] = y;
+    }
+
+    if (Ut != NULL) {
+        svd_apply_rotations(ucount, uqueue, n, Ut, ldu);
+    }
+    if (Vt != NULL) {
+        svd_apply_rotations(vcount, vqueue, n, Vt, ldv);
+    }
+    free(uqueue);
+    free(vqueue);
+
+    if (status != 0) {
+        return status;
+    }
+
+    for (i = 0; i < n; ++i) {
+        if (d[i] < 0) {
+            d[i] = -d[i];
+            if (Vt != NULL) {
+                for (j = 0; j < n; ++j) {
+                    Vt[i * ldv + j] = -Vt[i * ldv + j];
+                }
+            }
+        }
+    }
+
+    /* selection sort, so that each singular vector moves at most once */
+    for (i = 0; i + 1 < n; ++i) {
+        size_t largest = i;
+        for (j = i + 1; j < n; ++j) {
+            if (d[j] > d[largest]) {
+                largest = j;
+            }
+        }
+        if (largest != i) {
+            double swap = d[i];
+            d[i] = d[largest];
+            d[largest] = swap;
+            for (j = 0; j < n; ++j) {
+                if (Ut != NULL) {
+                    swap = Ut[i * ldu + j];
+                    Ut[i * ldu + j] = Ut[largest * ldu + j];
+                    Ut[largest * ldu + j] = swap;
+                }
+                if (Vt != NULL) {
+                    swap = Vt[i * ldv + j];
+                    Vt[i * ldv + j] = Vt[largest * ldv + j];
+                    Vt[largest * ldv + j] = swap;
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ *  Calcula a SVD de a[0:m, 0:n], m >= n, destruindo a.
+ *  @param s Recebe os n valores singulares, em ordem decrescente.
+ *  @param U Recebe os vetores singulares à esquerda nas colunas: m x n, linha a linha com leading dimension ldu.
+ *  Pode ser NULL.
+ *  @param V Recebe os vetores singulares à direita nas colunas: n x n, linha a linha com leading dimension ldv.
+ *  Pode ser NULL.
+ *  @return 0, ou -1 caso falte memória ou o QR não convirja.
+ */
+static int svd_array(size_t m, size_t n, double *a, size_t lda, double *s, double *U, size_t ldu, double *V, size_t ldv)
+{
+    double *e, *tauq, *taup, *Ut, *Vt;
+    int status = 0;
+    size_t i, j;
+
+    assert(m >= n);
+
+    if (n == 0) {
+        return 0;
+    }
+
+    if (m >= SVD_QR_RATIO * n) {
+        /* A = QR, and the SVD of R gives U = Q [U_R; 0] */
+        double *tau = (double *) malloc(sizeof(double) * n);
+        double *r = (double *) calloc(n * n, sizeof(double));
+
+        if (tau == NULL || r == NULL) {
+            status = -1;
+        }
+
+        if (status == 0) {
+            status = qr_factor_array(m, n, a, lda, tau);
+        }
+
+        if (status == 0) {
+            for (i = 0; i < n; ++i) {
+                for (j = i; j < n; ++j) {
+                    r[i * n + j] = a[i * lda + j];
+                }
+            }
+            status = svd_array(n, n, r, n, s, U, ldu, V, ldv);
+        }
+
+        if (status == 0 && U != NULL) {
+            for (i = n; i < m; ++i) {
+                memset(U + i * ldu, 0, sizeof(double) * n);
+            }
+            status = qr_apply_array(BLAS_NO_TRANS, m, n, a, lda, tau, U, ldu, n);
+        }
+
+        free(tau);
+        free(r);
+
+        return status;
+    }
+
+    e = (double *) malloc(sizeof(double) * n);
+    tauq = (double *) malloc(sizeof(double) * n);
+    taup = (double *) malloc(sizeof(double) * n);
+    Ut = U != NULL ? (double *) calloc(n * n, sizeof(double)) : NULL;
+    Vt = V != NULL ? (double *) calloc(n * n, sizeof(double)) : NULL;
+
+    if (e == NULL || tauq == NULL || taup == NULL || (U != NULL && Ut == NULL) || (V != NULL && Vt == NULL)) {
+        status = -1;
+    }
+
+    if (status == 0) {
+        for (i = 0; i < n; ++i) {
+            if (Ut != NULL) {
+                Ut[i * n + i] = 1;
+            }
+            if (Vt != NULL) {
+                Vt[i * n + i] = 1;
+            }
+        }
+
+        status = svd_bidiagonalize_array(m, n, a, lda, s, e, tauq, taup);
+        if (status == 0) {
+            status = svd_bidiagonal_qr(n, s, e, Ut, n, Vt, n);
+        }
+    }
+
+    /* the singular vectors of B are the rows of Ut and Vt; those of A are Q and P times them, as columns */
+    if (status == 0 && U != NULL) {
+        for (i = 0; i < m; ++i) {
+            for (j = 0; j < n; ++j) {
+                U[i * ldu + j] = i < n ? Ut[j * n + i] : 0;
+            }
+        }
+        status = qr_apply_array(BLAS_NO_TRANS, m, n, a, lda, tauq, U, ldu, n);
+    }
+
+    if (status == 0 && V != NULL) {
+        for (i = 0; i < n; ++i) {
+            for (j = 0; j < n; ++j) {
+                V[i * ldv + j] = Vt[j * n + i];
+            }
+        }
+        status = eigen_apply_q(n, a, lda, taup, V, ldv, n);
+    }
+
+    free(e);
+    free(tauq);
+    free(taup);
+    free(Ut);
+    free(Vt);
+
+    return status;
+}
+
+/**
+ *  Calcula a SVD de n vetores de m elementos, as linhas de g, por Jacobi unilateral, destruindo g. <br>
+ *  As linhas são rotacionadas até ficarem ortogonais duas a duas; normalizadas, são os vetores singulares à
+ *  esquerda, e as rotações acumuladas em Vt dão os vetores singulares à direita.
+ *  @param g Matriz n x m: as colunas de A, linha a linha com leading dimension ldg. Recebe os vetores
+ *  singulares à esquerda nas linhas; os de valores singulares nulos ficam nulos.
+ *  @param s Recebe os n valores singulares, em ordem decrescente.
+ *  @param Vt Recebe os vetores singulares à direita nas linhas: n x n, com leading dimension ldv.
+ *  @return 0, ou -1 caso o método não convirja.
+ */
+static int svd_jacobi_array(size_t n, size_t m, double *g, size_t ldg, double *s, double *Vt, size_t ldv)
+{
+    int sweep, rotated = 1;
+    size_t i, j, p;
+
+    for (i = 0; i < n; ++i) {
+        for (j = 0; j < n; ++j) {
+            Vt[i * ldv + j] = i == j;
+        }
+    }
+
+    for (sweep = 0; rotated && sweep < SVD_JACOBI_SWEEPS; ++sweep) {
+        rotated = 0;
+
+        for (i = 0; i + 1 < n; ++i) {
+            for (j = i + 1; j < n; ++j) {
+                double *gi = g + i * ldg;
+                double *gj = g + j * ldg;
+                double alpha = 0, beta = 0, gamma = 0;
+                double zeta, t, c;
+
+                for (p = 0; p < m; ++p) {
+                    alpha += gi[p] * gi[p];
+                    beta += gj[p] * gj[p];
+                    gamma += gi[p] * gj[p];
+                }
+
+                /* stop only when the pair is orthogonal relative to its own norms */
+                if (fabs(gamma) <= EPSILON * sqrt(alpha) * sqrt(beta)) {
+                    continue;
+                }
+                rotated = 1;
+
+                zeta = (beta - alpha) / (2 * gamma);
+                t = (zeta < 0 ? -1 : 1) / (fabs(zeta) + hypot(1, zeta));
+                c = 1 / sqrt(1 + t * t);
+
+                svd_rotate(m, gi, gj, c, -c * t);
+                svd_rotate(n, Vt + i * ldv, Vt + j * ldv, c, -c * t);
+            }
+        }
+    }
+
+    if (rotated) {
+        return -1;
+    }
+
+    for (i = 0; i < n; ++i) {
+        double *gi = g + i * ldg;
+
+        s[i] = qr_norm2(m, gi, 1);
+        if (s[i] != 0) {
+            for (p = 0; p < m; ++p) {
+                gi[p] /= s[i];
+            }
+        }
+    }
+
+    for (i = 0; i + 1 < n; ++i) {
+        size_t largest = i;
+        for (j = i + 1; j < n; ++j) {
+            if (s[j] > s[largest]) {
+                largest = j;
+            }
+        }
+        if (largest != i) {
+            double swap = s[i];
+            s[i] = s[largest];
+            s[largest] = swap;
+            for (p = 0; p < m; ++p) {
+                swap = g[i * ldg + p];
+                g[i * ldg + p] = g[largest * ldg + p];
+                g[largest * ldg + p] = swap;
+            }
+            for (p = 0; p < n; ++p) {
+                swap = Vt[i * ldv + p];
+                Vt[i * ldv + p] = Vt[largest * ldv + p];
+                Vt[largest * ldv + p] = swap;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ *  Calcula a SVD fina A = U S V^T de A (m x n), com k = min(m, n).
+ *  @param U Caso não seja NULL, recebe a matriz m x k com os vetores singulares à esquerda nas colunas.
+ *  @param V Caso não seja NULL, recebe a matriz n x k com os vetores singulares à direita nas colunas. <br>
+ *  Com os dois NULL só os valores singulares são calculados, em O(mn min(m, n)) sem o custo das rotações.
+ *  @return Os valores singulares em ordem decrescente (k x 1), ou NULL caso falte memória ou o QR não convirja.
+ */
+static matrix_t *svd(const matrix_t *A, matrix_t **U, matrix_t **V)
+{
+    /* a wide A goes through A^T = V S U^T */
+    int wide = A->rows < A->columns;
+    size_t rows = wide ? A->columns : A->rows;
+    size_t k = wide ? A->rows : A->columns;
+    matrix_t **left = wide ? V : U;
+    matrix_t **right = wide ? U : V;
+    matrix_t *a = wide ? matrix_transpose(A) : matrix_copy(A);
+    matrix_t *values = matrix_new(k, 1);
+    matrix_t *L = left != NULL ? matrix_new(rows, k) : NULL;
+    matrix_t *R = right != NULL ? matrix_new(k, k) : NULL;
+    int status = 0;
+
+    if (a == NULL || values == NULL || (left != NULL && L == NULL) || (right != NULL && R == NULL)) {
+        status = -1;
+    }
+
+    if (status == 0) {
+        status = svd_array(rows, k, a->elements, k, values->elements, L != NULL ? L->elements : NULL, k,
+                           R != NULL ? R->elements : NULL, k);
+    }
+
+    if (a != NULL) {
+        matrix_free(a);
+    }
+
+    if (status != 0) {
+        if (values != NULL) {
+            matrix_free(values);
+        }
+        if (L != NULL) {
+            matrix_free(L);
+        }
+        if (R != NULL) {
+            matrix_free(R);
+        }
+        values = NULL;
+        L = NULL;
+        R = NULL;
+    }
+
+    if (left != NULL) {
+        *left = L;
+    }
+    if (right != NULL) {
+        *right = R;
+    }
+
+    return values;
+}
+
+/**
+ *  Calcula a SVD fina de A por Jacobi unilateral: mais lenta que a svd, mas com precisão relativa alta mesmo nos
+ *  menores valores singulares. Indicada para matrizes pequenas.
+ *  @param U Caso não seja NULL, recebe a matriz m x k com os vetores singulares à esquerda nas colunas; as
+ *  colunas de valores singulares nulos ficam nulas.
+ *  @param V Caso não seja NULL, recebe a matriz n x k com os vetores singulares à direita nas colunas.
+ *  @return Os valores singulares em ordem decrescente (k x 1), ou NULL caso falte memória ou o método não
+ *  convirja.
+ */
+static matrix_t *svd_jacobi(const matrix_t *A, matrix_t **U, matrix_t **V)
+{
+    /* the rows of g are the columns of A, or of A^T when A is wide */
+    int wide = A->rows < A->columns;
+    size_t length = wide ? A->columns : A->rows;
+    size_t k = wide ? A->rows : A->columns;
+    matrix_t **left = wide ? V : U;
+    matrix_t **right = wide ? U : V;
+    matrix_t *g = wide ? matrix_copy(A) : matrix_transpose(A);
+    matrix_t *values = matrix_new(k, 1);
+    matrix_t *Vt = matrix_new(k, k);
+    matrix_t *L = NULL, *R = NULL;
+    int status = 0;
+
+    if (g == NULL || values == NULL || Vt == NULL) {
+        status = -1;
+    }
+
+    if (status == 0) {
+        status = svd_jacobi_array(k, length, g->elements, length, values->elements, Vt->elements, k);
+    }
+
+    if (status == 0 && left != NULL) {
+        L = matrix_transpose(g);
+        status = L == NULL ? -1 : 0;
+    }
+
+    if (status == 0 && right != NULL) {
+        R = matrix_transpose(Vt);
+        status = R == NULL ? -1 : 0;
+    }
+
+    if (g != NULL) {
+        matrix_free(g);
+    }
+    if (Vt != NULL) {
+        matrix_free(Vt);
+    }
+
+    if (status != 0) {
+        if (values != NULL) {
+            matrix_free(values);
+        }
+        if (L != NULL) {
+            matrix_free(L);
+        }
+        if (R != NULL) {
+            matrix_free(R);
+        }
+        values = NULL;
+        L = NULL;
+        R = NULL;
+    }
+
+    if (left != NULL) {
+        *left = L;
+    }
+    if (right != NULL) {
+        *right = R;
+    }
+
+    return values;
+}
+
+/**
+ *  Calcula a norma 2 (espectral) de A: o seu maior valor singular.
+ *  @return ||A||_2, ou NAN caso falte memória.
+ */
+static double svd_norm2(const matrix_t *A)
+{
+    matrix_t *values = svd(A, NULL, NULL);
+    double norm;
+
+    if (values == NULL) {
+        return NAN;
+    }
+
+    norm = values->rows > 0 ? values->elements[0] : 0;
+    matrix_free(values);
+
+    return norm;
+}
+
+/**
+ *  Calcula o número condição na norma 2 de A: a razão entre o maior e o menor valor singular.
+ *  @return cond_2(A), INFINITY caso A não tenha posto completo, ou NAN caso falte memória.
+ */
+static double svd_cond2(const matrix_t *A)
+{
+    matrix_t *values = svd(A, NULL, NULL);
+    double largest, smallest;
+
+    if (values == NULL) {
+        return NAN;
+    }
+
+    largest = values->rows > 0 ? values->elements[0] : 0;
+    smallest = values->rows > 0 ? values->elements[values->rows - 1] : 0;
+    matrix_free(values);
+
+    return smallest == 0 ? INFINITY : largest / smallest;
+}
+
+/**
+ *  Calcula a pseudoinversa de Moore-Penrose A^+ = V S^+ U^T. <br>
+ *  Valores singulares até a tolerância são tratados como zero.
+ *  @param tolerance Limite absoluto; se negativo, max(m, n) * EPSILON * ||A||_2.
+ *  @return A^+ (n x m), ou NULL caso falte memória ou a SVD não convirja.
+ */
+static matrix_t *svd_pseudoinverse(const matrix_t *A, double tolerance)
+{
+    size_t m = A->rows, n = A->columns;
+    size_t k = m < n ? m : n;
+    size_t longest = m > n ? m : n;
+    matrix_t *U, *V;
+    matrix_t *values = svd(A, &U, &V);
+    matrix_t *P;
+    size_t i, j, rank = 0;
+
+    if (values == NULL) {
+        return NULL;
+    }
+
+    P = matrix_new(n, m);
+
+    if (P != NULL) {
+        if (tolerance < 0) {
+            tolerance = (double) longest * EPSILON * (k > 0 ? values->elements[0] : 0);
+        }
+        while (rank < k && values->elements[rank] > tolerance) {
+            rank++;
+        }
+
+        /* V(:, 0:rank) S^-1 U(:, 0:rank)^T, with S^-1 folded into the columns of V */
+        for (i = 0; i < n; ++i) {
+            for (j = 0; j < rank; ++j) {
+                V->elements[i * k + j] /= values->elements[j];
+            }
+        }
+        gemm(BLAS_NO_TRANS, BLAS_TRANS, n, m, rank, 1, V->elements, k, U->elements, k, 0, P->elements, m);
+    }
+
+    matrix_free(values);
+    matrix_free(U);
+    matrix_free(V);
+
+    return P;
+}
+
+#endif
@@ -0,0 +1,99 @@
+/**
+ *  @file
+ */
+/*
+ * Copyright (c) 2018 Victor Hermann "vitorhnn" Chiletto
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+**/
+
+#ifndef THOMAS_H
+#define THOMAS_H
+
+#include "matrix.h"
+
+static matrix_t *thomas_solve_pivots(const matrix_t * ALC_RESTRICT A, const matrix_t * ALC_RESTRICT b, int positive)
+{
+    size_t n = A->rows;
+    size_t i;
+    double *upper;
+    matrix_t *x;
+
+    assert(A->rows == A->columns);
+    assert(b->rows == n);
+
+    if (n == 0) {
+        return matrix_new(0, 1);
+    }
+
+    x = matrix_new(n, 1);
+    upper = malloc(sizeof(double) * n);
+
+    for (i = 0; i < n; ++i) {
+        double pivot = matrix_get_at(A, i, i);
+        double rhs = matrix_get_at(b, i, 0);
+
+        if (i > 0) {
+            double lower = matrix_get_at(A, i, i - 1);
+            pivot -= lower * upper[i - 1];
+            rhs -= lower * matrix_get_at(x, i - 1, 0);
+        }
+
+        if (pivot == 0 || (positive && !(pivot > 0))) {
+            free(upper);
+            matrix_free(x);
+            return NULL;
+        }
+
+        upper[i] = i + 1 < n ? matrix_get_at(A, i, i + 1) / pivot : 0;
+        matrix_set_at(x, i, 0, rhs / pivot);
+    }
+
+    for (i = n - 1; i-- > 0;) {
+        matrix_set_at(x, i, 0, matrix_get_at(x, i, 0) - upper[i] * matrix_get_at(x, i + 1, 0));
+    }
+
+    free(upper);
+
+    return x;
+}
+
+/**
+ *  Resolve o sistema tridiagonal Ax = b pelo algoritmo de Thomas, em O(n). <br>
+ *  Somente as três diagonais centrais de A são lidas.
+ *  \warning Não há pivoteamento; é estável para matrizes diagonal dominantes ou positivas definidas.
+ *  @return O vetor x, ou NULL caso um pivô seja nulo.
+ */
+static matrix_t *thomas_solve(const matrix_t * ALC_RESTRICT A, const matrix_t * ALC_RESTRICT b)
+{
+    return thomas_solve_pivots(A, b, 0);
+}
+
+/**
+ *  Resolve o sistema tridiagonal simétrico Ax = b pelo algoritmo de Thomas, em O(n), só se A for positiva definida. <br>
+ *  Para A simétrica, os pivôs de Thomas são os de LDL^T, e A é positiva definida exatamente quando todos são positivos;
+ *  então a própria eliminação confirma o caso em que ela é estável.
+ *  @return O vetor x, ou NULL caso algum pivô não seja positivo.
+ */
+static matrix_t *thomas_positive_definite_solve(const matrix_t * ALC_RESTRICT A, const matrix_t * ALC_RESTRICT b)
+{
+    return thomas_solve_pivots(A, b, 1);
+}
+
+#endif
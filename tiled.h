@@ -0,0 +1,1240 @@
+/**
+ *  @file
+ */
+/*
+ * Copyright (c) 2018 Victor Hermann "vitorhnn" Chiletto
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+**/
+
+#ifndef TILED_H
+#define TILED_H
+
+/*
+ * Out-of-core matrices, for problems that do not fit in memory.
+ *
+ * A tiled matrix lives in a file as a grid of square tiles of tile x tile
+ * doubles, each stored row-major and contiguously; edge tiles are padded
+ * with zeros to the full size. Only up to cache_tiles tiles are in memory
+ * at once. A tile is used between tiled_acquire and tiled_release, during
+ * which it cannot be evicted; when the cache is full, the least recently
+ * used free tile is written back (if it changed) and its slot reused.
+ *
+ * The GEMM, LU and Cholesky below work tile by tile, with the same kernels
+ * as the in-memory versions. Their loops sweep back and forth (serpentine
+ * order) so that the tiles used last by one sweep are the first ones used
+ * by the next, which is what an LRU cache keeps. While a tile is being
+ * computed on, the next one is announced with tiled_prefetch, which asks
+ * the kernel to start reading it in the background.
+ *
+ * The file starts with a 64-byte header:
+ *
+ *     offset  size  field
+ *          0     8  magic "ALCTILED"
+ *          8     4  byte_order, 0x01020304 as written by the producer
+ *         12     4  version, TILED_FILE_VERSION
+ *         16     8  rows
+ *         24     8  columns
+ *         32     8  tile
+ *         40     8  data_offset, a multiple of TILED_FILE_ALIGNMENT
+ *         48    16  reserved, zero
+ *
+ * Tile (i, j) is at data_offset + (i * tile_columns + j) * tile * tile * 8.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "matrix.h"
+#include "blas.h"
+#include "cholesky.h"
+
+/* fileno, pread, pwrite and ftruncate, when declared; otherwise the stdio fallbacks below */
+#if MATRIX_POSIX
+#include <fcntl.h>
+#include <sys/types.h>
+#include <unistd.h>
+#define TILED_POSIX 1
+#else
+#define TILED_POSIX 0
+#endif
+
+/** Versão do formato escrita por tiled_create. **/
+#define TILED_FILE_VERSION 1
+
+/**
+ *  Alinhamento, em bytes, do início dos blocos no arquivo.
+ */
+#ifndef TILED_FILE_ALIGNMENT
+#define TILED_FILE_ALIGNMENT 4096
+#endif
+
+/**
+ *  Menor cache aceito, em blocos: a LU usa até quatro blocos ao mesmo tempo.
+ */
+#define TILED_MIN_CACHE 4
+
+/** O conteúdo do bloco será lido. **/
+#define TILED_READ 1
+/** O bloco será alterado e gravado de volta ao sair do cache. **/
+#define TILED_WRITE 2
+
+/** Retorno de tiled_lu e tiled_cholesky quando a leitura ou a escrita de um bloco falha. **/
+#define TILED_IO_ERROR ((size_t) -1)
+
+/** Posição de slot_of para blocos fora do cache. **/
+#define TILED_NONE ((size_t) -1)
+
+typedef struct {
+    char magic[8];
+    uint32_t byte_order;
+    uint32_t version;
+    uint64_t rows;
+    uint64_t columns;
+    uint64_t tile;
+    uint64_t data_offset;
+    uint64_t reserved[2];
+} tiled_file_header_t;
+
+/**
+ *  Um lugar no cache de blocos.
+ */
+typedef struct {
+    /** Bloco guardado aqui, como i * tile_columns + j, ou TILED_NONE. **/
+    size_t index;
+    /** Quantidade de tiled_acquire ainda sem tiled_release. **/
+    unsigned pins;
+    int dirty;
+    /** Instante do último uso, para o LRU. **/
+    unsigned long last_use;
+} tiled_slot_t;
+
+/**
+ *  Matriz guardada em disco, em blocos quadrados, com um cache LRU de blocos em memória.
+ */
+typedef struct {
+    size_t rows;
+    size_t columns;
+    /** Lado dos blocos. **/
+    size_t tile;
+    size_t tile_rows;
+    size_t tile_columns;
+    uint64_t data_offset;
+    FILE *file;
+
+    /** cache_tiles blocos de tile * tile elementos. **/
+    double *cache;
+    tiled_slot_t *slots;
+    size_t cache_tiles;
+    /** Para cada bloco, o lugar que ele ocupa no cache, ou TILED_NONE. **/
+    size_t *slot_of;
+    unsigned long clock;
+
+    /** Estatísticas: acessos que encontraram o bloco no cache, que precisaram lê-lo, e blocos gravados. **/
+    size_t hits;
+    size_t misses;
+    size_t writes;
+    /** Diferente de zero depois de uma falha de leitura ou escrita. **/
+    int error;
+} tiled_t;
+
+/** Linhas (ou colunas) do bloco index de uma dimensão com total elementos. **/
+static size_t tiled_extent(size_t total, size_t tile, size_t index)
+{
+    size_t start = index * tile;
+    return total - start < tile ? total - start : tile;
+}
+
+static uint64_t tiled_tile_offset(const tiled_t *t, size_t index)
+{
+    return t->data_offset + (uint64_t) index * t->tile * t->tile * sizeof(double);
+}
+
+static int tiled_read_at(tiled_t *t, void *dst, size_t bytes, uint64_t offset)
+{
+#if TILED_POSIX
+    char *p = (char *) dst;
+    int fd = fileno(t->file);
+
+    while (bytes > 0) {
+        ssize_t got = pread(fd, p, bytes, (off_t) offset);
+        if (got <= 0) {
+            return -1;
+        }
+        p += got;
+        bytes -= (size_t) got;
+        offset += (uint64_t) got;
+    }
+    return 0;
+#else
+    if (fseek(t->file, (long) offset, SEEK_SET) != 0 || fread(dst, 1, bytes, t->file) != bytes) {
+        return -1;
+    }
+    return 0;
+#endif
+}
+
+static int tiled_write_at(tiled_t *t, const void *src, size_t bytes, uint64_t offset)
+{
+#if TILED_POSIX
+    const char *p = (const char *) src;
+    int fd = fileno(t->file);
+
+    while (bytes > 0) {
+        ssize_t put = pwrite(fd, p, bytes, (off_t) offset);
+        if (put <= 0) {
+            return -1;
+        }
+        p += put;
+        bytes -= (size_t) put;
+        offset += (uint64_t) put;
+    }
+    return 0;
+#else
+    if (fseek(t->file, (long) offset, SEEK_SET) != 0 || fwrite(src, 1, bytes, t->file) != bytes) {
+        return -1;
+    }
+    return 0;
+#endif
+}
+
+/**
+ *  Libera a memória de t sem gravar nada.
+ */
+static void tiled_discard(tiled_t *t)
+{
+    if (t->file != NULL) {
+        fclose(t->file);
+    }
+    free(t->cache);
+    free(t->slots);
+    free(t->slot_of);
+    free(t);
+}
+
+/**
+ *  Monta um tiled_t para um arquivo já aberto.
+ */
+static tiled_t *tiled_init(FILE *f, size_t rows, size_t columns, size_t tile, uint64_t data_offset, size_t cache_tiles)
+{
+    tiled_t *t = (tiled_t *) calloc(1, sizeof(tiled_t));
+    size_t count, i;
+
+    if (t == NULL) {
+        fclose(f);
+        return NULL;
+    }
+
+    if (cache_tiles < TILED_MIN_CACHE) {
+        cache_tiles = TILED_MIN_CACHE;
+    }
+
+    t->rows = rows;
+    t->columns = columns;
+    t->tile = tile;
+    t->tile_rows = (rows + tile - 1) / tile;
+    t->tile_columns = (columns + tile - 1) / tile;
+    t->data_offset = data_offset;
+    t->file = f;
+    t->cache_tiles = cache_tiles;
+
+    count = t->tile_rows * t->tile_columns;
+    t->cache = (double *) malloc(sizeof(double) * tile * tile * cache_tiles);
+    t->slots = (tiled_slot_t *) calloc(cache_tiles, sizeof(tiled_slot_t));
+    t->slot_of = (size_t *) malloc(sizeof(size_t) * (count ? count : 1));
+
+    if (t->cache == NULL || t->slots == NULL || t->slot_of == NULL) {
+        tiled_discard(t);
+        return NULL;
+    }
+
+    for (i = 0; i < cache_tiles; ++i) {
+        t->slots[i].index = TILED_NONE;
+    }
+    for (i = 0; i < count; ++i) {
+        t->slot_of[i] = TILED_NONE;
+    }
+
+    return t;
+}
+
+/**
+ *  Cria em path uma matriz em blocos, zerada.
+ *  @param tile Lado dos blocos; tile * tile * 8 bytes por bloco, de preferência um múltiplo de 4096.
+ *  @param cache_tiles Quantidade de blocos mantidos em memória, no mínimo TILED_MIN_CACHE.
+ *  @return A matriz, ou NULL caso o arquivo não possa ser criado.
+ */
+static tiled_t *tiled_create(const char *path, size_t rows, size_t columns, size_t tile, size_t cache_tiles)
+{
+    tiled_file_header_t header;
+    static const char padding[TILED_FILE_ALIGNMENT];
+    uint64_t length;
+    FILE *f;
+    int ok;
+
+    assert(tile > 0);
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "ALCTILED", 8);
+    header.byte_order = 0x01020304u;
+    header.version = TILED_FILE_VERSION;
+    header.rows = rows;
+    header.columns = columns;
+    header.tile = tile;
+    header.data_offset = TILED_FILE_ALIGNMENT;
+
+    length = header.data_offset +
+             (uint64_t) ((rows + tile - 1) / tile) * ((columns + tile - 1) / tile) * tile * tile * sizeof(double);
+
+    f = fopen(path, "w+b");
+    if (f == NULL) {
+        return NULL;
+    }
+
+    ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+         fwrite(padding, 1, sizeof(padding) - sizeof(header), f) == sizeof(padding) - sizeof(header) &&
+         fflush(f) == 0;
+
+#if TILED_POSIX
+    /* the blocks read back as zeros without being written */
+    ok = ok && ftruncate(fileno(f), (off_t) length) == 0;
+#else
+    {
+        uint64_t at;
+        for (at = header.data_offset; ok && at < length; at += sizeof(padding)) {
+            ok = fwrite(padding, 1, sizeof(padding), f) == sizeof(padding);
+        }
+        ok = ok && fflush(f) == 0;
+    }
+#endif
+
+    if (!ok) {
+        fclose(f);
+        return NULL;
+    }
+
+    return tiled_init(f, rows, columns, tile, header.data_offset, cache_tiles);
+}
+
+/**
+ *  Abre uma matriz em blocos criada por tiled_create.
+ *  @param cache_tiles Quantidade de blocos mantidos em memória, no mínimo TILED_MIN_CACHE.
+ *  @return A matriz, ou NULL caso o arquivo não possa ser aberto ou tenha sido escrito com outra ordem de bytes.
+ */
+static tiled_t *tiled_open(const char *path, size_t cache_tiles)
+{
+    tiled_file_header_t header;
+    FILE *f = fopen(path, "r+b");
+
+    if (f == NULL) {
+        return NULL;
+    }
+
+    if (fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, "ALCTILED", 8) != 0 ||
+        header.byte_order != 0x01020304u || header.version != TILED_FILE_VERSION ||
+        header.tile == 0 || header.data_offset < sizeof(header)) {
+        fclose(f);
+        return NULL;
+    }
+
+    return tiled_init(f, (size_t) header.rows, (size_t) header.columns, (size_t) header.tile,
+                      header.data_offset, cache_tiles);
+}
+
+/**
+ *  Grava de volta ao arquivo o bloco do lugar slot, se ele foi alterado.
+ */
+static int tiled_write_back(tiled_t *t, size_t slot)
+{
+    tiled_slot_t *s = t->slots + slot;
+
+    if (s->index == TILED_NONE || !s->dirty) {
+        return 0;
+    }
+
+    if (tiled_write_at(t, t->cache + slot * t->tile * t->tile, sizeof(double) * t->tile * t->tile,
+                       tiled_tile_offset(t, s->index)) != 0) {
+        t->error = 1;
+        return -1;
+    }
+
+    s->dirty = 0;
+    t->writes++;
+    return 0;
+}
+
+/**
+ *  Grava no arquivo todos os blocos alterados que estão no cache.
+ *  @return 0, ou -1 caso alguma escrita falhe.
+ */
+static int tiled_flush(tiled_t *t)
+{
+    size_t slot;
+    int status = 0;
+
+    for (slot = 0; slot < t->cache_tiles; ++slot) {
+        if (tiled_write_back(t, slot) != 0) {
+            status = -1;
+        }
+    }
+
+    if (fflush(t->file) != 0) {
+        status = -1;
+    }
+
+    return status;
+}
+
+/**
+ *  Grava os blocos alterados, fecha o arquivo e libera t.
+ *  @return 0, ou -1 caso alguma escrita tenha falhado.
+ */
+static int tiled_close(tiled_t *t)
+{
+    int status = tiled_flush(t) != 0 || t->error ? -1 : 0;
+
+    if (fclose(t->file) != 0) {
+        status = -1;
+    }
+    t->file = NULL;
+
+    tiled_discard(t);
+
+    return status;
+}
+
+/**
+ *  Pede ao sistema que comece a ler o bloco (i, j) em segundo plano, caso ele não esteja no cache. <br>
+ *  Não faz nada em sistemas sem posix_fadvise.
+ */
+static void tiled_prefetch(tiled_t *t, size_t i, size_t j)
+{
+#if TILED_POSIX && defined(POSIX_FADV_WILLNEED)
+    size_t index = i * t->tile_columns + j;
+
+    if (i < t->tile_rows && j < t->tile_columns && t->slot_of[index] == TILED_NONE) {
+        posix_fadvise(fileno(t->file), (off_t) tiled_tile_offset(t, index),
+                      (off_t) (sizeof(double) * t->tile * t->tile), POSIX_FADV_WILLNEED);
+    }
+#else
+    (void) t;
+    (void) i;
+    (void) j;
+#endif
+}
+
+/**
+ *  Traz o bloco (i, j) para o cache e o fixa lá até tiled_release. <br>
+ *  O bloco tem tile x tile elementos, por linhas, com tile como leading dimension; o que passa da borda
+ *  da matriz é zero e deve continuar zero.
+ *  @param mode TILED_READ, TILED_WRITE ou ambos. Só com TILED_WRITE, o bloco não é lido do arquivo
+ *  e chega zerado.
+ *  @return Os elementos do bloco, ou NULL caso todos os lugares do cache estejam fixados ou a leitura falhe.
+ */
+static double *tiled_acquire(tiled_t *t, size_t i, size_t j, int mode)
+{
+    size_t index = i * t->tile_columns + j;
+    size_t elements = t->tile * t->tile;
+    size_t slot = t->slot_of[index];
+    double *data;
+
+    assert(i < t->tile_rows && j < t->tile_columns);
+
+    if (slot != TILED_NONE) {
+        t->hits++;
+    } else {
+        size_t candidate;
+
+        /* an empty slot if there is one, else the least recently used one that is not pinned */
+        for (candidate = 0; candidate < t->cache_tiles; ++candidate) {
+            const tiled_slot_t *s = t->slots + candidate;
+
+            if (s->pins > 0) {
+                continue;
+            }
+            if (s->index == TILED_NONE) {
+                slot = candidate;
+                break;
+            }
+            if (slot == TILED_NONE || s->last_use < t->slots[slot].last_use) {
+                slot = candidate;
+            }
+        }
+
+        if (slot == TILED_NONE || tiled_write_back(t, slot) != 0) {
+            return NULL;
+        }
+
+        if (t->slots[slot].index != TILED_NONE) {
+            t->slot_of[t->slots[slot].index] = TILED_NONE;
+            t->slots[slot].index = TILED_NONE;
+        }
+
+        data = t->cache + slot * elements;
+        if (mode & TILED_READ) {
+            if (tiled_read_at(t, data, sizeof(double) * elements, tiled_tile_offset(t, index)) != 0) {
+                t->error = 1;
+                return NULL;
+            }
+        } else {
+            memset(data, 0, sizeof(double) * elements);
+        }
+
+        t->misses++;
+        t->slots[slot].index = index;
+        t->slot_of[index] = slot;
+    }
+
+    t->slots[slot].pins++;
+    t->slots[slot].last_use = ++t->clock;
+    if (mode & TILED_WRITE) {
+        t->slots[slot].dirty = 1;
+    }
+
+    return t->cache + slot * elements;
+}
+
+/**
+ *  Desfaz um tiled_acquire do bloco (i, j), que volta a poder sair do cache.
+ */
+static void tiled_release(tiled_t *t, size_t i, size_t j)
+{
+    size_t slot = t->slot_of[i * t->tile_columns + j];
+
+    assert(slot != TILED_NONE && t->slots[slot].pins > 0);
+
+    t->slots[slot].pins--;
+}
+
+/**
+ *  Copia mat para uma nova matriz em blocos em path.
+ *  @return A matriz em blocos, ou NULL caso o arquivo não possa ser criado.
+ */
+static tiled_t *tiled_from_matrix(const matrix_t *mat, const char *path, size_t tile, size_t cache_tiles)
+{
+    tiled_t *t = tiled_create(path, mat->rows, mat->columns, tile, cache_tiles);
+    size_t ti, tj;
+
+    if (t == NULL) {
+        return NULL;
+    }
+
+    for (ti = 0; ti < t->tile_rows; ++ti) {
+        size_t rows = tiled_extent(t->rows, tile, ti);
+
+        for (tj = 0; tj < t->tile_columns; ++tj) {
+            size_t columns = tiled_extent(t->columns, tile, tj);
+            double *data = tiled_acquire(t, ti, tj, TILED_WRITE);
+            size_t i, j;
+
+            if (data == NULL) {
+                tiled_discard(t);
+                return NULL;
+            }
+
+            for (i = 0; i < rows; ++i) {
+                for (j = 0; j < columns; ++j) {
+                    data[i * tile + j] = matrix_get_at(mat, ti * tile + i, tj * tile + j);
+                }
+            }
+
+            tiled_release(t, ti, tj);
+        }
+    }
+
+    return t;
+}
+
+/**
+ *  Copia uma matriz em blocos para a memória.
+ *  @return A matriz, ou NULL caso falte memória ou a leitura falhe.
+ */
+static matrix_t *tiled_to_matrix(tiled_t *t)
+{
+    matrix_t *mat = matrix_new(t->rows, t->columns);
+    size_t ti, tj;
+
+    if (mat == NULL) {
+        return NULL;
+    }
+
+    for (ti = 0; ti < t->tile_rows; ++ti) {
+        size_t rows = tiled_extent(t->rows, t->tile, ti);
+
+        for (tj = 0; tj < t->tile_columns; ++tj) {
+            size_t columns = tiled_extent(t->columns, t->tile, tj);
+            const double *data = tiled_acquire(t, ti, tj, TILED_READ);
+            size_t i;
+
+            if (data == NULL) {
+                matrix_free(mat);
+                return NULL;
+            }
+
+            for (i = 0; i < rows; ++i) {
+                memcpy(mat->elements + (ti * t->tile + i) * t->columns + tj * t->tile,
+                       data + i * t->tile, sizeof(double) * columns);
+            }
+
+            tiled_release(t, ti, tj);
+        }
+    }
+
+    return mat;
+}
+
+/** Índice da etapa step de uma varredura de count posições a partir de first, indo e voltando a cada pass. **/
+static size_t tiled_serpentine(size_t first, size_t count, size_t pass, size_t step)
+{
+    return pass % 2 == 0 ? first + step : first + count - 1 - step;
+}
+
+/**
+ *  Calcula C = alpha * A * B + beta * C, com as três matrizes em blocos do mesmo tamanho. <br>
+ *  Cada bloco de C fica no cache enquanto os blocos de A e B que o afetam passam por ele; os blocos de A
+ *  de uma linha são reaproveitados de uma coluna de C para a outra quando o cache comporta a linha.
+ *  @return 0, ou -1 caso a leitura ou a escrita de algum bloco falhe.
+ */
+static int tiled_gemm(double alpha, tiled_t *A, tiled_t *B, double beta, tiled_t *C)
+{
+    size_t tile = C->tile;
+    size_t K = A->tile_columns;
+    size_t pass = 0;
+    size_t i, jj;
+
+    assert(A != C && B != C);
+    assert(A->tile == tile && B->tile == tile);
+    assert(A->rows == C->rows && B->columns == C->columns && A->columns == B->rows);
+
+    for (i = 0; i < C->tile_rows; ++i) {
+        size_t m = tiled_extent(C->rows, tile, i);
+
+        for (jj = 0; jj < C->tile_columns; ++jj) {
+            size_t j = tiled_serpentine(0, C->tile_columns, i, jj);
+            size_t n = tiled_extent(C->columns, tile, j);
+            double *c = tiled_acquire(C, i, j, beta == 0 ? TILED_WRITE : TILED_READ | TILED_WRITE);
+            size_t kk;
+
+            if (c == NULL) {
+                return -1;
+            }
+
+            if (beta != 1) {
+                size_t e;
+                for (e = 0; e < tile * tile; ++e) {
+                    c[e] *= beta;
+                }
+            }
+
+            for (kk = 0; kk < K; ++kk, ++pass) {
+                size_t k = tiled_serpentine(0, K, pass / K, kk);
+                const double *a, *b;
+
+                if (kk + 1 < K) {
+                    size_t next = tiled_serpentine(0, K, pass / K, kk + 1);
+                    tiled_prefetch(A, i, next);
+                    tiled_prefetch(B, next, j);
+                } else if (jj + 1 < C->tile_columns) {
+                    tiled_prefetch(C, i, tiled_serpentine(0, C->tile_columns, i, jj + 1));
+                }
+
+                a = tiled_acquire(A, i, k, TILED_READ);
+                b = a != NULL ? tiled_acquire(B, k, j, TILED_READ) : NULL;
+
+                if (b == NULL) {
+                    if (a != NULL) {
+                        tiled_release(A, i, k);
+                    }
+                    tiled_release(C, i, j);
+                    return -1;
+                }
+
+                gemm(BLAS_NO_TRANS, BLAS_NO_TRANS, m, n, tiled_extent(A->columns, tile, k),
+                     alpha, a, tile, b, tile, 1, c, tile);
+
+                tiled_release(A, i, k);
+                tiled_release(B, k, j);
+            }
+
+            tiled_release(C, i, j);
+        }
+    }
+
+    return A->error || B->error || C->error ? -1 : 0;
+}
+
+/**
+ *  Troca, nas colunas de blocos diferentes de skip, as linhas k0 .. k0 + count - 1 com as de pivots, em ordem. <br>
+ *  As trocas são antes compostas numa permutação, de modo que cada coluna de blocos fixa o bloco das linhas
+ *  k0 .. k0 + count - 1 e traz cada outro bloco tocado pelos pivôs uma única vez.
+ *  @param scratch Espaço para count * tile elementos.
+ *  @return 0, ou -1 caso falte memória ou algum bloco não possa ser lido.
+ */
+static int tiled_swap_rows(tiled_t *A, size_t skip, size_t k0, size_t count, const size_t *pivots, double *scratch)
+{
+    size_t tile = A->tile;
+    size_t k = k0 / tile;
+    size_t end = k0 + count;
+    size_t *origin, *outside, *outside_origin, *outside_dest;
+    size_t outsiders = 0;
+    size_t i, j, r;
+    int status = 0;
+
+    /* origin[c]: the row whose contents end up in row k0 + c; the same for the rows below the block */
+    origin = (size_t *) malloc(sizeof(size_t) * 4 * (count ? count : 1));
+    if (origin == NULL) {
+        return -1;
+    }
+    outside = origin + count;
+    outside_origin = outside + count;
+    outside_dest = outside_origin + count;
+
+    for (r = 0; r < count; ++r) {
+        origin[r] = k0 + r;
+    }
+
+    for (r = k0; r < end; ++r) {
+        size_t p = pivots[r];
+        size_t swap, *slot;
+
+        if (p == r) {
+            continue;
+        }
+
+        if (p < end) {
+            slot = &origin[p - k0];
+        } else {
+            for (i = 0; i < outsiders && outside[i] != p; ++i) {
+            }
+            if (i == outsiders) {
+                outside[i] = p;
+                outside_origin[i] = p;
+                ++outsiders;
+            }
+            slot = &outside_origin[i];
+        }
+
+        swap = origin[r - k0];
+        origin[r - k0] = *slot;
+        *slot = swap;
+    }
+
+    /*
+     * a row below the block only ever trades with rows of the block, so its old contents land in
+     * exactly one row of the block, and its new contents come from one; sorted, they group by tile
+     */
+    for (i = 1; i < outsiders; ++i) {
+        size_t row = outside[i], from = outside_origin[i];
+        for (j = i; j > 0 && outside[j - 1] > row; --j) {
+            outside[j] = outside[j - 1];
+            outside_origin[j] = outside_origin[j - 1];
+        }
+        outside[j] = row;
+        outside_origin[j] = from;
+    }
+    for (i = 0; i < outsiders; ++i) {
+        for (r = 0; origin[r] != outside[i]; ++r) {
+        }
+        outside_dest[i] = r;
+    }
+
+    for (j = 0; status == 0 && j < A->tile_columns; ++j) {
+        size_t width = tiled_extent(A->columns, tile, j);
+        double *top;
+
+        if (j == skip) {
+            continue;
+        }
+
+        top = tiled_acquire(A, k, j, TILED_READ | TILED_WRITE);
+        if (top == NULL) {
+            status = -1;
+            break;
+        }
+
+        for (r = 0; r < count; ++r) {
+            memcpy(scratch + r * width, top + r * tile, sizeof(double) * width);
+        }
+
+        for (i = 0; i < outsiders;) {
+            size_t other_tile = outside[i] / tile;
+            double *other = tiled_acquire(A, other_tile, j, TILED_READ | TILED_WRITE);
+
+            if (other == NULL) {
+                status = -1;
+                break;
+            }
+
+            for (; i < outsiders && outside[i] / tile == other_tile; ++i) {
+                double *row = other + (outside[i] % tile) * tile;
+                memcpy(top + outside_dest[i] * tile, row, sizeof(double) * width);
+                memcpy(row, scratch + (outside_origin[i] - k0) * width, sizeof(double) * width);
+            }
+
+            tiled_release(A, other_tile, j);
+        }
+
+        for (r = 0; r < count; ++r) {
+            if (origin[r] < end && origin[r] != k0 + r) {
+                memcpy(top + r * tile, scratch + (origin[r] - k0) * width, sizeof(double) * width);
+            }
+        }
+
+        tiled_release(A, k, j);
+    }
+
+    free(origin);
+
+    return status;
+}
+
+/**
+ *  Fatora A em PA = LU, no próprio arquivo e com pivoteamento parcial, como lu_factor_array. <br>
+ *  Cada painel de uma coluna de blocos é fatorado em memória, o que exige (n - k) * tile elementos
+ *  além do cache; o restante da matriz é atualizado bloco a bloco com trsm e gemm.
+ *  @param pivots Vetor de n posições; na etapa i, a linha i foi trocada com a linha pivots[i].
+ *  @return 0 em caso de sucesso, k + 1 caso o k-ésimo pivô seja nulo, ou TILED_IO_ERROR.
+ */
+static size_t tiled_lu(tiled_t *A, size_t *pivots)
+{
+    size_t tile = A->tile;
+    size_t n = A->rows;
+    size_t T = A->tile_rows;
+    double *panel;
+    size_t k;
+
+    assert(A->rows == A->columns);
+
+    panel = (double *) malloc(sizeof(double) * (n ? n : 1) * tile);
+    if (panel == NULL) {
+        return TILED_IO_ERROR;
+    }
+
+    for (k = 0; k < T; ++k) {
+        size_t k0 = k * tile;
+        size_t b = tiled_extent(n, tile, k);
+        size_t m = n - k0;
+        size_t i, j, jj;
+
+        /* gather the panel A[k0:n, k0:k0+b] */
+        for (i = k; i < T; ++i) {
+            const double *data = tiled_acquire(A, i, k, TILED_READ);
+            size_t r;
+
+            if (data == NULL) {
+                free(panel);
+                return TILED_IO_ERROR;
+            }
+            tiled_prefetch(A, i + 1, k);
+
+            for (r = 0; r < tiled_extent(n, tile, i); ++r) {
+                memcpy(panel + (i * tile + r - k0) * b, data + r * tile, sizeof(double) * b);
+            }
+            tiled_release(A, i, k);
+        }
+
+        /* unblocked LU with partial pivoting of the m x b panel */
+        for (j = 0; j < b; ++j) {
+            size_t p = j;
+            double biggest = fabs(panel[j * b + j]);
+            double *row_j = panel + j * b;
+
+            for (i = j + 1; i < m; ++i) {
+                if (fabs(panel[i * b + j]) > biggest) {
+                    biggest = fabs(panel[i * b + j]);
+                    p = i;
+                }
+            }
+
+            if (biggest == 0) {
+                free(panel);
+                return k0 + j + 1;
+            }
+
+            pivots[k0 + j] = k0 + p;
+
+            if (p != j) {
+                double *row_p = panel + p * b;
+                size_t c;
+                for (c = 0; c < b; ++c) {
+                    double swap = row_j[c];
+                    row_j[c] = row_p[c];
+                    row_p[c] = swap;
+                }
+            }
+
+            for (i = j + 1; i < m; ++i) {
+                double *row_i = panel + i * b;
+                double l = row_i[j] / row_j[j];
+                size_t c;
+
+                row_i[j] = l;
+                for (c = j + 1; c < b; ++c) {
+                    row_i[c] -= l * row_j[c];
+                }
+            }
+        }
+
+        /* scatter it back */
+        for (i = k; i < T; ++i) {
+            double *data = tiled_acquire(A, i, k, TILED_READ | TILED_WRITE);
+            size_t r;
+
+            if (data == NULL) {
+                free(panel);
+                return TILED_IO_ERROR;
+            }
+
+            for (r = 0; r < tiled_extent(n, tile, i); ++r) {
+                memcpy(data + r * tile, panel + (i * tile + r - k0) * b, sizeof(double) * b);
+            }
+            tiled_release(A, i, k);
+        }
+
+        /* the panel is back in the file, so its buffer serves as scratch for the swaps */
+        if (tiled_swap_rows(A, k, k0, b, pivots, panel) != 0) {
+            free(panel);
+            return TILED_IO_ERROR;
+        }
+
+        /* U(k, j) = L(k, k)^-1 A(k, j), then A(i, j) -= L(i, k) U(k, j), sweeping i back and forth */
+        for (jj = k + 1; jj < T; ++jj) {
+            size_t width = tiled_extent(n, tile, jj);
+            const double *l;
+            double *u;
+            size_t ii;
+
+            l = tiled_acquire(A, k, k, TILED_READ);
+            u = l != NULL ? tiled_acquire(A, k, jj, TILED_READ | TILED_WRITE) : NULL;
+            if (u == NULL) {
+                if (l != NULL) {
+                    tiled_release(A, k, k);
+                }
+                free(panel);
+                return TILED_IO_ERROR;
+            }
+
+            trsm_left_lower_unit(b, width, l, tile, u, tile);
+            tiled_release(A, k, k);
+
+            for (ii = 0; ii < T - k - 1; ++ii) {
+                size_t i = tiled_serpentine(k + 1, T - k - 1, jj - k - 1, ii);
+                const double *below;
+                double *target;
+
+                if (ii + 1 < T - k - 1) {
+                    size_t next = tiled_serpentine(k + 1, T - k - 1, jj - k - 1, ii + 1);
+                    tiled_prefetch(A, next, k);
+                    tiled_prefetch(A, next, jj);
+                }
+
+                below = tiled_acquire(A, i, k, TILED_READ);
+                target = below != NULL ? tiled_acquire(A, i, jj, TILED_READ | TILED_WRITE) : NULL;
+                if (target == NULL) {
+                    if (below != NULL) {
+                        tiled_release(A, i, k);
+                    }
+                    tiled_release(A, k, jj);
+                    free(panel);
+                    return TILED_IO_ERROR;
+                }
+
+                gemm(BLAS_NO_TRANS, BLAS_NO_TRANS, tiled_extent(n, tile, i), width, b,
+                     -1, below, tile, u, tile, 1, target, tile);
+
+                tiled_release(A, i, k);
+                tiled_release(A, i, jj);
+            }
+
+            tiled_release(A, k, jj);
+        }
+    }
+
+    free(panel);
+
+    return A->error ? TILED_IO_ERROR : 0;
+}
+
+/**
+ *  Fatora A = R^T R, no próprio arquivo, com R triangular superior, como cholesky_factor_array. <br>
+ *  Só os blocos do triângulo superior são lidos e escritos.
+ *  @return 0 em caso de sucesso, k + 1 caso o k-ésimo pivô não seja positivo, ou TILED_IO_ERROR.
+ */
+static size_t tiled_cholesky(tiled_t *A)
+{
+    size_t tile = A->tile;
+    size_t n = A->rows;
+    size_t T = A->tile_rows;
+    size_t k;
+
+    assert(A->rows == A->columns);
+
+    for (k = 0; k < T; ++k) {
+        size_t b = tiled_extent(n, tile, k);
+        double *diagonal = tiled_acquire(A, k, k, TILED_READ | TILED_WRITE);
+        size_t failed, i, jj;
+
+        if (diagonal == NULL) {
+            return TILED_IO_ERROR;
+        }
+
+        failed = cholesky_factor_array(b, diagonal, tile);
+        if (failed != 0) {
+            tiled_release(A, k, k);
+            return k * tile + failed;
+        }
+
+        /* R(k, j) = R(k, k)^-T A(k, j) */
+        for (jj = k + 1; jj < T; ++jj) {
+            double *r = tiled_acquire(A, k, jj, TILED_READ | TILED_WRITE);
+
+            if (r == NULL) {
+                tiled_release(A, k, k);
+                return TILED_IO_ERROR;
+            }
+            tiled_prefetch(A, k, jj + 1);
+
+            trsm_left_upper_trans(b, tiled_extent(n, tile, jj), diagonal, tile, r, tile);
+            tiled_release(A, k, jj);
+        }
+        tiled_release(A, k, k);
+
+        /* A(i, j) -= R(k, i)^T R(k, j) for the upper tiles, sweeping j back and forth along each row */
+        for (i = k + 1; i < T; ++i) {
+            size_t rows = tiled_extent(n, tile, i);
+            const double *left = tiled_acquire(A, k, i, TILED_READ);
+
+            if (left == NULL) {
+                return TILED_IO_ERROR;
+            }
+
+            for (jj = 0; jj < T - i; ++jj) {
+                size_t j = tiled_serpentine(i, T - i, i - k - 1, jj);
+                const double *right;
+                double *target;
+
+                if (jj + 1 < T - i) {
+                    size_t next = tiled_serpentine(i, T - i, i - k - 1, jj + 1);
+                    tiled_prefetch(A, k, next);
+                    tiled_prefetch(A, i, next);
+                }
+
+                right = tiled_acquire(A, k, j, TILED_READ);
+                target = right != NULL ? tiled_acquire(A, i, j, TILED_READ | TILED_WRITE) : NULL;
+                if (target == NULL) {
+                    if (right != NULL) {
+                        tiled_release(A, k, j);
+                    }
+                    tiled_release(A, k, i);
+                    return TILED_IO_ERROR;
+                }
+
+                gemm(BLAS_TRANS, BLAS_NO_TRANS, rows, tiled_extent(n, tile, j), b,
+                     -1, left, tile, right, tile, 1, target, tile);
+
+                tiled_release(A, k, j);
+                tiled_release(A, i, j);
+            }
+
+            tiled_release(A, k, i);
+        }
+    }
+
+    return A->error ? TILED_IO_ERROR : 0;
+}
+
+/**
+ *  Resolve Ax = b a partir da fatoração de tiled_lu; b e x ficam em memória.
+ *  @return O vetor x, ou NULL caso a leitura de algum bloco falhe.
+ */
+static matrix_t *tiled_lu_solve(tiled_t *LU, const size_t *pivots, const matrix_t *b)
+{
+    size_t tile = LU->tile;
+    size_t n = LU->rows;
+    size_t T = LU->tile_rows;
+    matrix_t *x;
+    double *v;
+    size_t i, k;
+
+    assert(b->rows == n && b->columns == 1);
+
+    x = matrix_copy(b);
+    if (x == NULL) {
+        return NULL;
+    }
+    v = x->elements;
+
+    for (i = 0; i < n; ++i) {
+        if (pivots[i] != i) {
+            double swap = v[i];
+            v[i] = v[pivots[i]];
+            v[pivots[i]] = swap;
+        }
+    }
+
+    /* L y = P b, one row of tiles at a time */
+    for (i = 0; i < T; ++i) {
+        size_t rows = tiled_extent(n, tile, i);
+        double *vi = v + i * tile;
+        const double *d;
+        size_t r, c;
+
+        for (k = 0; k <= i; ++k) {
+            d = tiled_acquire(LU, i, k, TILED_READ);
+            if (d == NULL) {
+                matrix_free(x);
+                return NULL;
+            }
+            tiled_prefetch(LU, i, k + 1);
+
+            if (k < i) {
+                gemv(BLAS_NO_TRANS, rows, tile, -1, d, tile, v + k * tile, 1, vi);
+            } else {
+                for (r = 1; r < rows; ++r) {
+                    for (c = 0; c < r; ++c) {
+                        vi[r] -= d[r * tile + c] * vi[c];
+                    }
+                }
+            }
+            tiled_release(LU, i, k);
+        }
+    }
+
+    /* U x = y, from the last row of tiles up */
+    for (i = T; i-- > 0;) {
+        size_t rows = tiled_extent(n, tile, i);
+        double *vi = v + i * tile;
+        const double *d;
+        size_t r, c;
+
+        for (k = T; k-- > i;) {
+            d = tiled_acquire(LU, i, k, TILED_READ);
+            if (d == NULL) {
+                matrix_free(x);
+                return NULL;
+            }
+            if (k > 0) {
+                tiled_prefetch(LU, i, k - 1);
+            }
+
+            if (k > i) {
+                gemv(BLAS_NO_TRANS, rows, tiled_extent(n, tile, k), -1, d, tile, v + k * tile, 1, vi);
+            } else {
+                for (r = rows; r-- > 0;) {
+                    double sum = vi[r];
+                    for (c = r + 1; c < rows; ++c) {
+                        sum -= d[r * tile + c] * vi[c];
+                    }
+                    vi[r] = sum / d[r * tile + r];
+                }
+            }
+            tiled_release(LU, i, k);
+        }
+    }
+
+    return x;
+}
+
+/**
+ *  Resolve R^T R x = b a partir da fatoração de tiled_cholesky; b e x ficam em memória.
+ *  @return O vetor x, ou NULL caso a leitura de algum bloco falhe.
+ */
+static matrix_t *tiled_cholesky_solve(tiled_t *R, const matrix_t *b)
+{
+    size_t tile = R->tile;
+    size_t n = R->rows;
+    size_t T = R->tile_rows;
+    matrix_t *x;
+    double *v;
+    size_t i, k;
+
+    assert(b->rows == n && b->columns == 1);
+
+    x = matrix_copy(b);
+    if (x == NULL) {
+        return NULL;
+    }
+    v = x->elements;
+
+    /* R^T y = b: column i of tiles of R, top to bottom */
+    for (i = 0; i < T; ++i) {
+        size_t columns = tiled_extent(n, tile, i);
+        double *vi = v + i * tile;
+        const double *d;
+        size_t r, c;
+
+        for (k = 0; k <= i; ++k) {
+            d = tiled_acquire(R, k, i, TILED_READ);
+            if (d == NULL) {
+                matrix_free(x);
+                return NULL;
+            }
+            tiled_prefetch(R, k + 1, i);
+
+            if (k < i) {
+                gemv(BLAS_TRANS, columns, tile, -1, d, tile, v + k * tile, 1, vi);
+            } else {
+                for (r = 0; r < columns; ++r) {
+                    vi[r] /= d[r * tile + r];
+                    for (c = r + 1; c < columns; ++c) {
+                        vi[c] -= d[r * tile + c] * vi[r];
+                    }
+                }
+            }
+            tiled_release(R, k, i);
+        }
+    }
+
+    /* R x = y */
+    for (i = T; i-- > 0;) {
+        size_t rows = tiled_extent(n, tile, i);
+        double *vi = v + i * tile;
+        const double *d;
+        size_t r, c;
+
+        for (k = T; k-- > i;) {
+            d = tiled_acquire(R, i, k, TILED_READ);
+            if (d == NULL) {
+                matrix_free(x);
+                return NULL;
+            }
+            if (k > 0) {
+                tiled_prefetch(R, i, k - 1);
+            }
+
+            if (k > i) {
+                gemv(BLAS_NO_TRANS, rows, tiled_extent(n, tile, k), -1, d, tile, v + k * tile, 1, vi);
+            } else {
+                for (r = rows; r-- > 0;) {
+                    double sum = vi[r];
+                    for (c = r + 1; c < rows; ++c) {
+                        sum -= d[r * tile + c] * vi[c];
+                    }
+                    vi[r] = sum / d[r * tile + r];
+                }
+            }
+            tiled_release(R, i, k);
+        }
+    }
+
+    return x;
+}
+
+#endif
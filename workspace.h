@@ -0,0 +1,259 @@
+/**
+ *  @file
+ */
+/*
+ * Copyright (c) 2018 Victor Hermann "vitorhnn" Chiletto
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+**/
+
+#ifndef WORKSPACE_H
+#define WORKSPACE_H
+
+/*
+ * Scratch memory for short-lived temporaries.
+ *
+ * A workspace is a stack allocator over one buffer that the caller sets up
+ * once and reuses across calls, so a routine that takes one does not touch
+ * malloc for its temporaries. Routines take a mark on entry and release back
+ * to it on exit; allocations are never freed one by one.
+ *
+ * The workspace is always optional: with NULL, or when the buffer is too
+ * small, workspace_alloc falls back to the heap, with the same alignment, and
+ * workspace_dealloc frees it, so the same code path serves both cases. The *_workspace_size functions of
+ * each routine report how many bytes make it allocation-free, and
+ * workspace_t::peak reports the most that was actually used.
+ *
+ * A workspace must not be shared between threads; give each thread its own.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "matrix.h"
+
+/**
+ *  Alinhamento, em bytes, de todos os blocos entregues pelo workspace.
+ */
+#ifndef WORKSPACE_ALIGNMENT
+#define WORKSPACE_ALIGNMENT 64
+#endif
+
+/**
+ *  Memória de rascunho para temporários, reaproveitada entre chamadas.
+ */
+typedef struct {
+    unsigned char *base;
+    size_t size;
+    /** Bytes em uso. **/
+    size_t used;
+    /** Maior valor atingido por used. **/
+    size_t peak;
+    /** Bloco alocado por workspace_new, NULL quando o buffer é do chamador. **/
+    void *allocation;
+} workspace_t;
+
+/**
+ *  Arredonda bytes para o alinhamento do workspace.
+ */
+static size_t workspace_bytes(size_t bytes)
+{
+    return (bytes + WORKSPACE_ALIGNMENT - 1) / WORKSPACE_ALIGNMENT * WORKSPACE_ALIGNMENT;
+}
+
+/**
+ *  Bytes ocupados por uma matriz alocada com workspace_matrix.
+ */
+static size_t workspace_matrix_bytes(size_t rows, size_t columns)
+{
+    return workspace_bytes(sizeof(matrix_t)) + workspace_bytes(sizeof(double) * rows * columns);
+}
+
+/**
+ *  Inicializa um workspace sobre um buffer do chamador, que continua sendo dono dele.
+ *  @param size Tamanho do buffer, em bytes.
+ */
+static void workspace_init(workspace_t *ws, void *buffer, size_t size)
+{
+    uintptr_t start = (uintptr_t) buffer;
+    size_t skip = (size_t) (workspace_bytes(start) - start);
+
+    ws->base = (unsigned char *) buffer + (skip < size ? skip : size);
+    ws->size = skip < size ? size - skip : 0;
+    ws->used = 0;
+    ws->peak = 0;
+    ws->allocation = NULL;
+}
+
+/**
+ *  Cria um workspace de size bytes.
+ *  @return O workspace, ou NULL caso falte memória.
+ */
+static workspace_t *workspace_new(size_t size)
+{
+    workspace_t *ws = (workspace_t *) malloc(sizeof(workspace_t));
+    void *buffer;
+
+    if (ws == NULL) {
+        return NULL;
+    }
+
+    /* one extra alignment unit, so that size bytes are usable after aligning the start */
+    buffer = malloc(size + WORKSPACE_ALIGNMENT);
+    if (buffer == NULL) {
+        free(ws);
+        return NULL;
+    }
+
+    workspace_init(ws, buffer, size + WORKSPACE_ALIGNMENT);
+    ws->allocation = buffer;
+
+    return ws;
+}
+
+/**
+ *  Libera um workspace criado por workspace_new.
+ */
+static void workspace_free(workspace_t *ws)
+{
+    free(ws->allocation);
+    free(ws);
+}
+
+/**
+ *  Marca a posição atual do workspace, para ser devolvida com workspace_release.
+ */
+static size_t workspace_mark(const workspace_t *ws)
+{
+    return ws != NULL ? ws->used : 0;
+}
+
+/**
+ *  Devolve ao workspace tudo o que foi alocado desde mark.
+ */
+static void workspace_release(workspace_t *ws, size_t mark)
+{
+    if (ws != NULL) {
+        assert(mark <= ws->used);
+        ws->used = mark;
+    }
+}
+
+/**
+ *  Aloca bytes do heap alinhados a WORKSPACE_ALIGNMENT, com malloc e uma unidade de alinhamento a mais. <br>
+ *  O ponteiro devolvido por malloc fica guardado logo antes do bloco, para workspace_heap_free.
+ */
+static void *workspace_heap_alloc(size_t bytes)
+{
+    unsigned char *raw;
+    uintptr_t start;
+
+    if (bytes > SIZE_MAX - WORKSPACE_ALIGNMENT - sizeof(void *)) {
+        return NULL;
+    }
+
+    raw = (unsigned char *) malloc(bytes + WORKSPACE_ALIGNMENT + sizeof(void *));
+    if (raw == NULL) {
+        return NULL;
+    }
+
+    start = (uintptr_t) (raw + sizeof(void *));
+    start = (start + WORKSPACE_ALIGNMENT - 1) / WORKSPACE_ALIGNMENT * WORKSPACE_ALIGNMENT;
+    memcpy((unsigned char *) start - sizeof(void *), &raw, sizeof(void *));
+
+    return (void *) start;
+}
+
+/**
+ *  Libera um bloco de workspace_heap_alloc.
+ */
+static void workspace_heap_free(void *block)
+{
+    void *raw;
+
+    if (block == NULL) {
+        return;
+    }
+
+    memcpy(&raw, (unsigned char *) block - sizeof(void *), sizeof(void *));
+    free(raw);
+}
+
+/**
+ *  Aloca bytes do workspace, ou do heap caso ws seja NULL ou não tenha espaço.
+ *  @return O bloco, que deve ser devolvido com workspace_dealloc, ou NULL caso falte memória.
+ */
+static void *workspace_alloc(workspace_t *ws, size_t bytes)
+{
+    size_t rounded = workspace_bytes(bytes ? bytes : 1);
+    void *block;
+
+    if (ws == NULL || rounded > ws->size - ws->used) {
+        return workspace_heap_alloc(rounded);
+    }
+
+    block = ws->base + ws->used;
+    ws->used += rounded;
+    if (ws->used > ws->peak) {
+        ws->peak = ws->used;
+    }
+
+    return block;
+}
+
+/**
+ *  Devolve um bloco de workspace_alloc. Blocos do workspace só voltam com workspace_release,
+ *  então esta função só libera os que vieram do heap.
+ */
+static void workspace_dealloc(workspace_t *ws, void *block)
+{
+    if (ws == NULL || (unsigned char *) block < ws->base || (unsigned char *) block >= ws->base + ws->size) {
+        workspace_heap_free(block);
+    }
+}
+
+/**
+ *  Cria uma matriz temporária no workspace, com cabeçalho e elementos em um único bloco.
+ *  \warning Libere com workspace_matrix_free, nunca com matrix_free.
+ */
+static matrix_t *workspace_matrix(workspace_t *ws, size_t rows, size_t columns)
+{
+    matrix_t *mat = (matrix_t *) workspace_alloc(ws, workspace_matrix_bytes(rows, columns));
+
+    if (mat == NULL) {
+        return NULL;
+    }
+
+    memset(mat, 0, sizeof(matrix_t));
+    mat->elements = (double *) ((unsigned char *) mat + workspace_bytes(sizeof(matrix_t)));
+    mat->rows = rows;
+    mat->columns = columns;
+
+    return mat;
+}
+
+/**
+ *  Devolve uma matriz de workspace_matrix.
+ */
+static void workspace_matrix_free(workspace_t *ws, matrix_t *mat)
+{
+    workspace_dealloc(ws, mat);
+}
+
+#endif